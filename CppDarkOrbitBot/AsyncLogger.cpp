@@ -0,0 +1,298 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+
+#include "AsyncLogger.h"
+#include "BotUtils.h"
+#include "Constants.h"
+
+using namespace std;
+
+struct LogFormatDescriptor {
+    const char *text;
+    int style;
+};
+
+// indexed by LogFormat
+static const LogFormatDescriptor LOG_FORMATS[LOG_FORMAT_COUNT] = {
+    { "{}", LOG_NO_STYLE },
+    { "Clicked at [{}, {}]", LOG_NO_STYLE },
+    { "BOT_STATUS: {}", LOG_NO_STYLE },
+    { "Bot turned {}", LOG_NO_STYLE },
+    { "Found collecting match with score: {}", LOG_NO_STYLE },
+    { "Collected resource", LOG_NO_STYLE },
+    { "Fallback to scanning after 4s passed", YELLOW_TEXT_BLACK_BACKGROUND },
+    { "Cannot find any resources, changing location", LOG_NO_STYLE },
+    { "Travelling for too long...", YELLOW_TEXT_BLACK_BACKGROUND },
+    { "Click released {}us after its frame was captured, {}us after it was queued", LOG_NO_STYLE },
+    { "Capture to decision p50 {}us p95 {}us, capture to click p50 {}us p95 {}us", LOG_NO_STYLE },
+    { "Thread pool ran {} tasks, queue wait p95 under {}us, run time p95 under {}us, worker utilization {}", LOG_NO_STYLE },
+    { "Thread pool queue depth average {} max so far {}, {} contended locks, {} parallel chunks run by the caller", LOG_NO_STYLE },
+    { "Frame budget ran out {} times, {} optional matching jobs skipped", YELLOW_TEXT_BLACK_BACKGROUND },
+};
+
+AsyncLogger asyncLogger;
+
+static void appendArgument(string &output, const LogArgument &argument)
+{
+    switch (argument.type)
+    {
+    case LOG_ARGUMENT_INTEGER:
+        output += to_string(argument.integer);
+        break;
+    case LOG_ARGUMENT_REAL:
+        output += to_string(argument.real);
+        break;
+    case LOG_ARGUMENT_STATUS:
+        output += botStatusEnumToString(BotStatus(argument.integer));
+        break;
+    case LOG_ARGUMENT_BOOL:
+        output += argument.integer ? "ON" : "OFF";
+        break;
+    case LOG_ARGUMENT_TEXT:
+        if (argument.text) output += *argument.text;
+        break;
+    }
+}
+
+string formatLogEntry(const LogEntry &entry)
+{
+    string output;
+    const char *text = LOG_FORMATS[entry.format].text;
+    int argument = 0;
+
+    for (const char *c = text; *c != '\0'; c++)
+    {
+        if (c[0] == '{' && c[1] == '}')
+        {
+            if (argument < entry.argumentCount) appendArgument(output, entry.arguments[argument++]);
+            c++;
+            continue;
+        }
+        output += *c;
+    }
+
+    return output;
+}
+
+static void releaseArguments(LogEntry &entry)
+{
+    for (int i = 0; i < entry.argumentCount; i++)
+    {
+        if (entry.arguments[i].type == LOG_ARGUMENT_TEXT) delete entry.arguments[i].text;
+    }
+}
+
+AsyncLogger::AsyncLogger() : mask_(0), enqueuePosition_(0), dequeuePosition_(0), running_(false), droppedEntries_(0),
+    fileBytes_(0), cachedSecond_(-1)
+{
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+}
+
+void AsyncLogger::start(const LoggerSettings &settings)
+{
+    if (running_) return;
+
+    settings_ = settings;
+
+    size_t capacity = 1;
+    while (capacity < settings_.capacity) capacity <<= 1;
+
+    slots_ = make_unique<Slot[]>(capacity);
+    for (size_t i = 0; i < capacity; i++) slots_[i].sequence.store(i, memory_order_relaxed);
+    mask_ = capacity - 1;
+    enqueuePosition_.store(0, memory_order_relaxed);
+    dequeuePosition_ = 0;
+
+    if (!settings_.filePath.empty())
+    {
+        file_.open(settings_.filePath, ios::app);
+        fileBytes_ = file_.is_open() ? (long long)file_.tellp() : 0;
+    }
+
+    running_ = true;
+    loggingThread_ = thread(&AsyncLogger::loggingLoop, this);
+}
+
+void AsyncLogger::stop()
+{
+    if (!running_) return;
+
+    running_ = false;
+    if (loggingThread_.joinable()) loggingThread_.join();
+
+    if (file_.is_open()) file_.close();
+}
+
+bool AsyncLogger::isRunning() const
+{
+    return running_;
+}
+
+void AsyncLogger::log(LogFormat format, int style, const LogArgument *arguments, int argumentCount)
+{
+    LogEntry entry;
+    entry.timestamp = getCurrentMicros();
+    entry.format = format;
+    entry.style = style;
+    entry.argumentCount = argumentCount;
+    for (int i = 0; i < argumentCount; i++) entry.arguments[i] = arguments[i];
+
+    if (!running_)
+    {
+        write(entry);
+        releaseArguments(entry);
+        return;
+    }
+
+    if (!tryPush(entry))
+    {
+        droppedEntries_++;
+        releaseArguments(entry);
+    }
+}
+
+long long AsyncLogger::getDroppedEntries() const
+{
+    return droppedEntries_.load();
+}
+
+// every slot carries a sequence number telling whose turn it is
+// sequence == position means its free for the producer claiming that position,
+// sequence == position + 1 means its filled and waiting for the logging thread
+bool AsyncLogger::tryPush(const LogEntry &entry)
+{
+    size_t position = enqueuePosition_.load(memory_order_relaxed);
+    Slot *slot;
+
+    while (true)
+    {
+        slot = &slots_[position & mask_];
+        size_t sequence = slot->sequence.load(memory_order_acquire);
+        ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+
+        if (difference == 0)
+        {
+            if (enqueuePosition_.compare_exchange_weak(position, position + 1, memory_order_relaxed)) break;
+        }
+        // the logging thread hasnt freed this slot yet, the buffer is full
+        else if (difference < 0) return false;
+        else position = enqueuePosition_.load(memory_order_relaxed);
+    }
+
+    slot->entry = entry;
+    slot->sequence.store(position + 1, memory_order_release);
+    return true;
+}
+
+bool AsyncLogger::tryPop(LogEntry &entry)
+{
+    Slot *slot = &slots_[dequeuePosition_ & mask_];
+    if (slot->sequence.load(memory_order_acquire) != dequeuePosition_ + 1) return false;
+
+    entry = slot->entry;
+    slot->sequence.store(dequeuePosition_ + mask_ + 1, memory_order_release);
+    dequeuePosition_++;
+    return true;
+}
+
+void AsyncLogger::loggingLoop()
+{
+    long long reportedDrops = 0;
+
+    while (true)
+    {
+        // reading the flag before draining so nothing logged before stop() is left behind
+        bool stopping = !running_;
+
+        LogEntry entry;
+        bool wroteAnything = false;
+        while (tryPop(entry))
+        {
+            write(entry);
+            releaseArguments(entry);
+            wroteAnything = true;
+        }
+
+        long long drops = droppedEntries_.load();
+        if (drops != reportedDrops)
+        {
+            writeLine(getCurrentMicros(), RED_TEXT_BLACK_BACKGROUND, "Log buffer full, dropped " + to_string(drops - reportedDrops) + " messages");
+            reportedDrops = drops;
+            wroteAnything = true;
+        }
+
+        if (wroteAnything)
+        {
+            if (settings_.console) cout.flush();
+            if (file_.is_open()) file_.flush();
+        }
+
+        if (stopping) break;
+
+        // polling keeps the producers free of any syscall, a few milliseconds of delay dont matter for a log
+        if (!wroteAnything) this_thread::sleep_for(chrono::milliseconds(2));
+    }
+}
+
+void AsyncLogger::write(const LogEntry &entry)
+{
+    int style = entry.style != LOG_NO_STYLE ? entry.style : LOG_FORMATS[entry.format].style;
+    writeLine(entry.timestamp, style, formatLogEntry(entry));
+}
+
+void AsyncLogger::writeLine(long long timestamp, int style, const string &message)
+{
+    const string &currentTimestamp = formatTimestamp(timestamp);
+
+    if (settings_.console)
+    {
+        cout << "[" << currentTimestamp << "] ";
+        if (style != LOG_NO_STYLE) setConsoleStyle(style);
+        cout << message << "\n";
+        if (style != LOG_NO_STYLE) setConsoleStyle(DEFAULT);
+    }
+
+    if (file_.is_open())
+    {
+        file_ << "[" << currentTimestamp << "] " << message << "\n";
+        fileBytes_ += currentTimestamp.size() + message.size() + 4;
+        if (fileBytes_ > settings_.maxFileBytes) rotateFile();
+    }
+}
+
+// path -> path.1 -> path.2 ... the oldest one is deleted
+void AsyncLogger::rotateFile()
+{
+    file_.close();
+
+    error_code error;
+    string oldest = settings_.filePath + "." + to_string(settings_.maxFiles - 1);
+    filesystem::remove(oldest, error);
+    for (int i = settings_.maxFiles - 2; i >= 1; i--)
+    {
+        filesystem::rename(settings_.filePath + "." + to_string(i), settings_.filePath + "." + to_string(i + 1), error);
+    }
+    if (settings_.maxFiles > 1) filesystem::rename(settings_.filePath, settings_.filePath + ".1", error);
+    else filesystem::remove(settings_.filePath, error);
+
+    file_.open(settings_.filePath, ios::trunc);
+    fileBytes_ = 0;
+}
+
+// the timestamp only has second precision so it is only formatted again once the second changes
+const string &AsyncLogger::formatTimestamp(long long micros)
+{
+    long long second = micros / 1000000;
+    if (second != cachedSecond_)
+    {
+        cachedSecond_ = second;
+        cachedTimestamp_ = millisToTimestamp(second * 1000);
+    }
+    return cachedTimestamp_;
+}
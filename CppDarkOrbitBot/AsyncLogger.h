@@ -0,0 +1,140 @@
+#ifndef ASYNC_LOGGER
+#define ASYNC_LOGGER
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "BotUtils.h"
+
+using namespace std;
+
+// every message the main loop can log, the text lives in LOG_FORMATS on the logging thread
+// so logging one of these only copies the id and the arguments into the ring buffer
+enum LogFormat : unsigned short {
+    LOG_TEXT,                   // free text, allocates so it is only meant for code outside the frame loop
+    LOG_CLICKED_AT,
+    LOG_BOT_STATUS,
+    LOG_BOT_TOGGLED,
+    LOG_FOUND_COLLECTING_MATCH,
+    LOG_COLLECTED_RESOURCE,
+    LOG_MOVING_TIMEOUT,
+    LOG_NO_RESOURCES_FOUND,
+    LOG_TRAVELING_TIMEOUT,
+    LOG_CLICK_LATENCY,
+    LOG_LATENCY_SUMMARY,
+    LOG_THREAD_POOL_TIMES,
+    LOG_THREAD_POOL_QUEUE,
+    LOG_FRAME_BUDGET,
+    LOG_FORMAT_COUNT
+};
+
+enum LogArgumentType : unsigned char {
+    LOG_ARGUMENT_INTEGER,
+    LOG_ARGUMENT_REAL,
+    LOG_ARGUMENT_STATUS,
+    LOG_ARGUMENT_BOOL,
+    LOG_ARGUMENT_TEXT
+};
+
+struct LogArgument {
+    LogArgumentType type;
+    union {
+        long long integer;
+        double real;
+        string *text;           // owned by the entry, deleted by the logging thread once written
+    };
+
+    LogArgument() : type(LOG_ARGUMENT_INTEGER), integer(0) {}
+    LogArgument(int value) : type(LOG_ARGUMENT_INTEGER), integer(value) {}
+    LogArgument(long long value) : type(LOG_ARGUMENT_INTEGER), integer(value) {}
+    LogArgument(double value) : type(LOG_ARGUMENT_REAL), real(value) {}
+    LogArgument(BotStatus value) : type(LOG_ARGUMENT_STATUS), integer(value) {}
+    LogArgument(bool value) : type(LOG_ARGUMENT_BOOL), integer(value) {}
+    LogArgument(string *value) : type(LOG_ARGUMENT_TEXT), text(value) {}
+};
+
+constexpr int LOG_MAX_ARGUMENTS = 4;
+constexpr int LOG_NO_STYLE = -1;
+
+struct LogEntry {
+    long long timestamp;
+    LogFormat format;
+    int style;
+    int argumentCount;
+    LogArgument arguments[LOG_MAX_ARGUMENTS];
+};
+
+struct LoggerSettings {
+    bool console = true;
+    string filePath;                              // empty for no log file
+    long long maxFileBytes = 8 * 1024 * 1024;     // the file is rotated to <path>.1 ... once it gets bigger than this
+    int maxFiles = 3;
+    int capacity = 4096;                          // entries in the ring buffer, rounded up to a power of two
+};
+
+// bounded lock free queue in front of a single logging thread, any thread can log
+// when the buffer is full the entry is dropped and counted instead of making the caller wait
+// while the logging thread isnt running entries are written straight away on the calling thread
+class AsyncLogger {
+public:
+    AsyncLogger();
+    ~AsyncLogger();
+
+    void start(const LoggerSettings &settings);
+    void stop();
+    bool isRunning() const;
+
+    // style overrides the color from LOG_FORMATS, LOG_NO_STYLE keeps it
+    void log(LogFormat format, int style, const LogArgument *arguments, int argumentCount);
+
+    long long getDroppedEntries() const;
+
+private:
+    struct Slot {
+        atomic<size_t> sequence;
+        LogEntry entry;
+    };
+
+    LoggerSettings settings_;
+
+    unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    atomic<size_t> enqueuePosition_;
+    size_t dequeuePosition_;
+
+    atomic<bool> running_;
+    atomic<long long> droppedEntries_;
+    thread loggingThread_;
+
+    // only touched by the logging thread
+    ofstream file_;
+    long long fileBytes_;
+    long long cachedSecond_;
+    string cachedTimestamp_;
+
+    bool tryPush(const LogEntry &entry);
+    bool tryPop(LogEntry &entry);
+    void loggingLoop();
+    void write(const LogEntry &entry);
+    void writeLine(long long timestamp, int style, const string &message);
+    void rotateFile();
+    const string &formatTimestamp(long long micros);
+};
+
+extern AsyncLogger asyncLogger;
+
+string formatLogEntry(const LogEntry &entry);
+
+// logs one of the predefined formats, the arguments fill the {} placeholders in order
+template<typename... Arguments>
+void logEvent(LogFormat format, Arguments... arguments)
+{
+    static_assert(sizeof...(Arguments) <= LOG_MAX_ARGUMENTS, "too many log arguments");
+    LogArgument packed[LOG_MAX_ARGUMENTS] = { LogArgument(arguments)... };
+    asyncLogger.log(format, LOG_NO_STYLE, packed, sizeof...(Arguments));
+}
+
+#endif
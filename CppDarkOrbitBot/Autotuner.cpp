@@ -0,0 +1,342 @@
+#include <opencv2/core/types.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "Autotuner.h"
+#include "BotCV.h"
+#include "BotUtils.h"
+#include "Constants.h"
+#include "SyntheticWorld.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+// the processor brand string, the same model behaves the same no matter which box it is in
+static string cpuName()
+{
+    char brand[49] = {};
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if (unsigned(info[0]) >= 0x80000004)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            __cpuid(info, 0x80000002 + i);
+            memcpy(brand + 16 * i, info, 16);
+        }
+    }
+#elif defined(__x86_64__) || defined(__i386__)
+    unsigned int info[4];
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            __get_cpuid(0x80000002 + i, &info[0], &info[1], &info[2], &info[3]);
+            memcpy(brand + 16 * i, info, 16);
+        }
+    }
+#endif
+
+    // the brand string is padded with spaces, the key has to stay one word
+    string name;
+    for (char c : string(brand))
+    {
+        if (c == ' ' || c == '\t')
+        {
+            if (!name.empty() && name.back() != '_') name += '_';
+        }
+        else name += c;
+    }
+    while (!name.empty() && name.back() == '_') name.pop_back();
+    return name.empty() ? "unknown_cpu" : name;
+}
+
+// fnv-1a, only has to tell template sets apart between launches
+static unsigned long long hashText(const string &text)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+string autotuneCacheKey(Size frameSize, const vector<Template> &templates)
+{
+    ostringstream templateSet;
+    templateSet << setprecision(4);
+    for (const Template &t : templates)
+    {
+        templateSet << t.name << ":" << t.grayscale.cols << "x" << t.grayscale.rows << ":" << t.matchingMode << ":"
+            << t.confidenceThreshold << ":" << t.useDividedScreenshot << ";";
+    }
+
+    ostringstream key;
+    key << cpuName() << "|" << thread::hardware_concurrency() << "|" << frameSize.width << "x" << frameSize.height
+        << "|" << hex << hashText(templateSet.str());
+    return key.str();
+}
+
+// one line per machine: <key> <columns> <rows> <overlap> <threads> <frame millis>, the last line with the key wins
+bool loadAutotuneResult(const string &path, const string &key, AutotuneResult &result)
+{
+    ifstream input(path);
+    if (!input.is_open()) return false;
+
+    bool found = false;
+    string line;
+    while (getline(input, line))
+    {
+        istringstream fields(line);
+        string lineKey;
+        AutotuneConfiguration configuration;
+        double frameMillis;
+        if (!(fields >> lineKey >> configuration.gridColumns >> configuration.gridRows >> configuration.overlap >> configuration.threadCount >> frameMillis)) continue;
+        if (lineKey != key || configuration.gridColumns < 1 || configuration.gridRows < 1 || configuration.overlap < 0 || configuration.threadCount < 1) continue;
+
+        result.configuration = configuration;
+        result.frameMillis = frameMillis;
+        result.fromCache = true;
+        result.testedConfigurations = 0;
+        result.rejectedConfigurations = 0;
+        found = true;
+    }
+    return found;
+}
+
+bool saveAutotuneResult(const string &path, const string &key, const AutotuneResult &result)
+{
+    ofstream output(path, ios::app);
+    if (!output.is_open()) return false;
+
+    const AutotuneConfiguration &c = result.configuration;
+    output << fixed << setprecision(3) << key << " " << c.gridColumns << " " << c.gridRows << " " << c.overlap << " " << c.threadCount
+        << " " << result.frameMillis << "\n";
+    return bool(output);
+}
+
+// the detections of every frame, frames - templates - matches
+typedef vector<vector<vector<TemplateMatch>>> FrameDetections;
+
+// same detections means every reference one is found again at the same place and nothing else is
+static bool sameDetections(const FrameDetections &reference, const FrameDetections &candidate, double iouThreshold)
+{
+    for (int f = 0; f < reference.size(); f++)
+    {
+        for (int i = 0; i < reference[f].size(); i++)
+        {
+            const vector<TemplateMatch> &expected = reference[f][i];
+            const vector<TemplateMatch> &found = candidate[f][i];
+            if (expected.size() != found.size()) return false;
+
+            vector<bool> matched(found.size(), false);
+            for (const TemplateMatch &e : expected)
+            {
+                int best = -1;
+                double bestIoU = iouThreshold;
+                for (int j = 0; j < found.size(); j++)
+                {
+                    if (matched[j]) continue;
+                    double iou = calculateIoU(e.rect, found[j].rect);
+                    if (iou >= bestIoU)
+                    {
+                        bestIoU = iou;
+                        best = j;
+                    }
+                }
+                if (best < 0) return false;
+                matched[best] = true;
+            }
+        }
+    }
+    return true;
+}
+
+// median time of one frame, divideImage included since the main loop pays for it as well
+static double measureConfiguration(const vector<Mat> &frames, vector<Template> &templates, const AutotuneConfiguration &configuration,
+    ThreadPool &threadPool, int rounds, FrameDetections &detections)
+{
+    vector<double> frameMillis;
+    detections.assign(frames.size(), vector<vector<TemplateMatch>>(templates.size()));
+
+    for (int round = 0; round < max(1, rounds); round++)
+    {
+        for (int f = 0; f < frames.size(); f++)
+        {
+            Mat frame = frames[f];
+            vector<vector<TemplateMatch>> matches(templates.size());
+
+            long long start = getCurrentMicros();
+            vector<vector<Mat>> grid = divideImage(frame, configuration.gridColumns, configuration.gridRows, configuration.overlap);
+            matchTemplatesParallel(frame, configuration.overlap, grid, templates, threadPool, matches);
+            long long micros = computeTimePassed(start, getCurrentMicros());
+
+            // the first round warms up the caches and the pool, it only counts when there is no other one
+            if (round > 0 || rounds <= 1) frameMillis.push_back(micros / 1000.0);
+            if (round == 0) detections[f] = matches;
+        }
+    }
+
+    nth_element(frameMillis.begin(), frameMillis.begin() + frameMillis.size() / 2, frameMillis.end());
+    return frameMillis[frameMillis.size() / 2];
+}
+
+bool runAutotune(const vector<Mat> &frames, const vector<Template> &templates, const AutotuneSettings &settings, AutotuneResult &result)
+{
+    if (frames.empty() || templates.empty()) return false;
+
+    vector<Template> matched = templates;
+    Size frameSize = frames[0].size();
+
+    // a match can only be found in a cell it fits in completely, the overlap has to cover the biggest template
+    int largestTemplate = 0;
+    for (const Template &t : matched) largestTemplate = max({ largestTemplate, t.grayscale.cols, t.grayscale.rows });
+
+    int cores = max(1u, thread::hardware_concurrency());
+    result = AutotuneResult();
+
+    // matching the whole frame at once cant lose anything at a seam, every candidate has to find what it finds
+    FrameDetections reference;
+    {
+        ThreadPool threadPool(cores);
+        AutotuneConfiguration whole = { 1, 1, 0, cores };
+        measureConfiguration(frames, matched, whole, threadPool, 1, reference);
+    }
+
+    // the grid with one thread per core, every cell has to stay bigger than the overlap around it
+    ThreadPool corePool(cores);
+    double bestMillis = -1.0;
+    for (int columns : settings.gridColumns)
+    {
+        for (int rows : settings.gridRows)
+        {
+            for (int overlap : settings.overlaps)
+            {
+                // a single cell has no seams, it is measured once
+                if (columns * rows == 1 && overlap != settings.overlaps[0]) continue;
+                if (overlap < largestTemplate && columns * rows > 1) continue;
+                if (frameSize.width / columns <= overlap * 2 || frameSize.height / rows <= overlap * 2) continue;
+
+                AutotuneConfiguration configuration = { columns, rows, columns * rows > 1 ? overlap : 0, cores };
+                FrameDetections detections;
+                double millis = measureConfiguration(frames, matched, configuration, corePool, settings.rounds, detections);
+                result.testedConfigurations++;
+
+                if (!sameDetections(reference, detections, settings.iouThreshold))
+                {
+                    result.rejectedConfigurations++;
+                    continue;
+                }
+                if (bestMillis < 0 || millis < bestMillis)
+                {
+                    bestMillis = millis;
+                    result.configuration = configuration;
+                }
+            }
+        }
+    }
+
+    if (bestMillis < 0)
+    {
+        // nothing kept the detections, the whole frame at once always does
+        FrameDetections detections;
+        result.configuration = { 1, 1, 0, cores };
+        bestMillis = measureConfiguration(frames, matched, result.configuration, corePool, settings.rounds, detections);
+    }
+
+    // then the pool size for that grid, more threads than jobs only adds switching
+    vector<int> threadCounts;
+    for (double factor : settings.threadFactors) threadCounts.push_back(max(1, int(cores * factor + 0.5)));
+    sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    for (int threadCount : threadCounts)
+    {
+        if (threadCount == cores) continue;
+
+        ThreadPool threadPool(threadCount);
+        AutotuneConfiguration configuration = result.configuration;
+        configuration.threadCount = threadCount;
+
+        FrameDetections detections;
+        double millis = measureConfiguration(frames, matched, configuration, threadPool, settings.rounds, detections);
+        result.testedConfigurations++;
+
+        // fewer threads only win by a clear margin, they leave the cores to the game and the capture
+        if (millis < bestMillis * (threadCount < result.configuration.threadCount ? 1.05 : 0.95))
+        {
+            bestMillis = millis;
+            result.configuration = configuration;
+        }
+    }
+
+    result.frameMillis = bestMillis;
+    return true;
+}
+
+bool autotune(ScreenshotManager &screenshotManager, const vector<Template> &templates, const AutotuneSettings &settings, AutotuneResult &result)
+{
+    vector<Mat> frames;
+    frames.push_back(screenshotManager.capture().clone());
+    if (frames[0].empty()) return false;
+
+    string key = autotuneCacheKey(frames[0].size(), templates);
+    if (loadAutotuneResult(settings.cachePath, key, result)) return true;
+
+    printWithTimestamp("No tuned configuration for this machine yet, measuring the grid and the thread count...", YELLOW_TEXT_BLACK_BACKGROUND);
+
+    for (int i = 1; i < settings.capturedFrames; i++)
+    {
+        this_thread::sleep_for(chrono::milliseconds(settings.captureIntervalMillis));
+        frames.push_back(screenshotManager.capture().clone());
+    }
+
+    // the game might not show a single resource right now, the generated frames always have some to keep
+    if (settings.syntheticFrames > 0 && frames[0].type() == CV_8UC1)
+    {
+        vector<Template> sprites;
+        for (const Template &t : templates)
+        {
+            if (!t.grayscale.empty() && t.multipleMatches) sprites.push_back(t);
+        }
+
+        if (!sprites.empty())
+        {
+            SyntheticWorldGenerator generator(sprites, vector<Template>(), 1);
+            SyntheticWorldSettings worldSettings;
+            worldSettings.frameSize = frames[0].size();
+            worldSettings.objectCount = settings.syntheticObjects;
+            worldSettings.hudElements = 0;
+            for (int i = 0; i < settings.syntheticFrames; i++)
+            {
+                SyntheticFrame frame;
+                generator.generate(worldSettings, frame);
+                frames.push_back(frame.image);
+            }
+        }
+    }
+
+    long long start = getCurrentMillis();
+    if (!runAutotune(frames, templates, settings, result)) return false;
+
+    printWithTimestamp("Measured " + to_string(result.testedConfigurations) + " configurations in " + to_string(computeTimePassed(start, getCurrentMillis()))
+        + "ms, " + to_string(result.rejectedConfigurations) + " of them lost detections", YELLOW_TEXT_BLACK_BACKGROUND);
+    if (!saveAutotuneResult(settings.cachePath, key, result))
+    {
+        printWithTimestamp("Could not save the tuned configuration to " + settings.cachePath, RED_TEXT_BLACK_BACKGROUND);
+    }
+    return true;
+}
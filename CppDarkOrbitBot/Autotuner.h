@@ -0,0 +1,58 @@
+#ifndef AUTOTUNER
+#define AUTOTUNER
+
+#include <opencv2/core/types.hpp>
+#include <string>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+class ScreenshotManager;
+
+// startup benchmark of the screenshot grid and the thread pool size on the frames of this machine
+// the grid is picked first with one thread per core, then the pool size for that grid
+struct AutotuneSettings {
+    vector<int> gridColumns = { 1, 2, 3, 4, 6, 8 };
+    vector<int> gridRows = { 1, 2, 3, 4, 6 };
+    vector<int> overlaps = { 32, 50, 64, 96 };      // the ones smaller than the biggest template are skipped, matches would be cut at the seams
+    vector<double> threadFactors = { 0.25, 0.5, 0.75, 1.0, 1.5 };   // pool sizes tried, relative to the core count
+    int capturedFrames = 3;
+    long long captureIntervalMillis = 200;          // between the captured frames so they dont all show the same thing
+    int syntheticFrames = 2;                        // generated with the matched templates on them, so there are detections to keep
+    int syntheticObjects = 40;
+    int rounds = 2;                                 // every configuration runs over all the frames this many times, the first round is a warmup
+    double iouThreshold = 0.5;                      // overlap needed for a detection to count as the same one
+    string cachePath = "autotune_cache.txt";        // delete it to measure again
+};
+
+struct AutotuneConfiguration {
+    int gridColumns;
+    int gridRows;
+    int overlap;
+    int threadCount;
+};
+
+struct AutotuneResult {
+    AutotuneConfiguration configuration;
+    double frameMillis = 0.0;           // median time of divideImage and matchTemplatesParallel on one frame
+    bool fromCache = false;
+    int testedConfigurations = 0;
+    int rejectedConfigurations = 0;     // faster or not, these lost or changed detections
+};
+
+// identifies what the result depends on, the cpu, the frame size and the matched templates
+string autotuneCacheKey(Size frameSize, const vector<Template> &templates);
+bool loadAutotuneResult(const string &path, const string &key, AutotuneResult &result);
+bool saveAutotuneResult(const string &path, const string &key, const AutotuneResult &result);
+
+// measures every candidate on the frames and picks the fastest one that finds the same detections as matching the whole frame at once
+// false when there were no frames or templates to measure with
+bool runAutotune(const vector<Mat> &frames, const vector<Template> &templates, const AutotuneSettings &settings, AutotuneResult &result);
+
+// the cached result for this machine, or captures frames from the game and measures when there is none
+bool autotune(ScreenshotManager &screenshotManager, const vector<Template> &templates, const AutotuneSettings &settings, AutotuneResult &result);
+
+#endif
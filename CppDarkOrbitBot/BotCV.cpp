@@ -5,13 +5,23 @@
 
 #include "ThreadPool.h"
 #include "BotUtils.h"
+#include "Constants.h"
 #include "BotCV.h"
+#include "BoundedSearch.h"
+#include "NccEngine.h"
 
 using namespace std;
 using namespace cv;
 
-ScreenshotManager::ScreenshotManager(HWND hwnd) : hwnd_(hwnd), width_(0), height_(0), hwindowDC_(nullptr), hwindowCompatibleDC_(nullptr), hbwindow_(nullptr) 
+ScreenshotManager::ScreenshotManager(HWND hwnd, const CaptureSettings &settings) : hwnd_(hwnd), settings_(settings), width_(0), height_(0), lastCaptureMicros_(0),
+    hwindowDC_(nullptr), hwindowCompatibleDC_(nullptr), hbwindow_(nullptr) 
 {
+    if (settings_.decimation != 1 && settings_.decimation != 2)
+    {
+        printWithTimestamp("Capture decimation can only be 1 or 2, capturing at full resolution", RED_TEXT_BLACK_BACKGROUND);
+        settings_.decimation = 1;
+    }
+
     initialize();
 }
 
@@ -38,7 +48,9 @@ void ScreenshotManager::initialize()
     bi_.biWidth = width_;
     bi_.biHeight = -height_;  // Negative for correct orientation
     bi_.biPlanes = 1;
-    bi_.biBitCount = 24;  // RGB format
+    // full resolution BGR is copied straight into the frame, everything else is converted from 32 bit BGRA
+    // whose pixels line up with the simd registers
+    bi_.biBitCount = (settings_.format == CAPTURE_BGR && settings_.decimation == 1) ? 24 : 32;
     bi_.biCompression = BI_RGB;
 }
 
@@ -50,6 +62,28 @@ void ScreenshotManager::cleanup()
 }
 
 Mat ScreenshotManager::capture() 
+{
+    Mat color;
+    return capture(color);
+}
+
+long long ScreenshotManager::getLastCaptureMicros() const
+{
+    return lastCaptureMicros_;
+}
+
+void ScreenshotManager::setColorRegion(Rect region)
+{
+    colorRegion_ = region;
+    colorRegionImage_.release();
+}
+
+const Mat &ScreenshotManager::getColorRegion() const
+{
+    return colorRegionImage_;
+}
+
+Mat ScreenshotManager::capture(Mat &color) 
 {
     if (!hwindowDC_ || !hwindowCompatibleDC_ || !hbwindow_) {
         std::cerr << "Resources not initialized properly!" << std::endl;
@@ -61,15 +95,35 @@ Mat ScreenshotManager::capture()
         std::cerr << "Failed to capture the window!" << std::endl;
         return cv::Mat();
     }
+    lastCaptureMicros_ = getCurrentMicros();
 
     // Retrieve bitmap data into OpenCV matrix
-    cv::Mat image(height_, width_, CV_8UC3);
-    if (GetDIBits(hwindowCompatibleDC_, hbwindow_, 0, height_, image.data, (BITMAPINFO*)&bi_, DIB_RGB_COLORS) == 0) {
+    if (bi_.biBitCount == 24) {
+        cv::Mat image(height_, width_, CV_8UC3);
+        if (GetDIBits(hwindowCompatibleDC_, hbwindow_, 0, height_, image.data, (BITMAPINFO*)&bi_, DIB_RGB_COLORS) == 0) {
+            std::cerr << "Failed to retrieve bitmap data!" << std::endl;
+            return cv::Mat();
+        }
+
+        if (settings_.keepColor) color = image;
+        if (colorRegion_.area() > 0) colorRegionImage_ = image(colorRegion_ & Rect(0, 0, width_, height_)).clone();
+        return image;
+    }
+
+    bgra_.create(height_, width_, CV_8UC4);
+    if (GetDIBits(hwindowCompatibleDC_, hbwindow_, 0, height_, bgra_.data, (BITMAPINFO*)&bi_, DIB_RGB_COLORS) == 0) {
         std::cerr << "Failed to retrieve bitmap data!" << std::endl;
         return cv::Mat();
     }
 
-    return image;
+    // the frame gets a fresh buffer every capture since the previous one can still be referenced by the caller
+    cv::Mat frame;
+    convertCapturedFrame(bgra_, settings_.format, settings_.decimation, frame);
+    if (settings_.keepColor) cv::cvtColor(bgra_, color, cv::COLOR_BGRA2BGR);
+
+    if (colorRegion_.area() > 0) convertCapturedRegion(bgra_, colorRegion_, settings_.decimation, colorRegionImage_);
+
+    return frame;
 }
 
 void drawMultipleTargets(Mat &screenshot, vector<TemplateMatch> &matches,  string templateName)
@@ -152,19 +206,64 @@ void drawSingleTarget(Mat &screenshot, Rect target, string name, Scalar color)
     cv::putText(screenshot, label, labelPos, FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 0, 0), 1);
 }
 
-void matchSingleTemplate(Mat screenshot, Mat templateGrayscale, Mat templateAlpha, string templateName, TemplateMatchModes matchMode, double confidenceThreshold,
-    vector<double> &matchScores, vector<Rect> &matchRectangles, vector<int> &deduplicatedMatchIndexes)
+// frames captured as grayscale or a single channel are used as they are
+static Mat toGrayscale(const Mat &screenshot)
 {
+    if (screenshot.channels() == 1) return screenshot;
+
     Mat grayscaleScreenshot;
     cv::cvtColor(screenshot, grayscaleScreenshot, cv::COLOR_BGR2GRAY);
+    return grayscaleScreenshot;
+}
+
+void computeMatchResult(const Mat &grayscaleScreenshot, const Mat &templateGrayscale, const Mat &templateAlpha, const SparseTemplate &templateSparse,
+    FixedSizeKernel fixedSizeKernel, TemplateMatchModes matchMode, Mat &result)
+{
+    // small searches go through the kernel built for this template size and mode, if the registry declared one
+    int searchArea = max(0, grayscaleScreenshot.cols - templateGrayscale.cols + 1) * max(0, grayscaleScreenshot.rows - templateGrayscale.rows + 1);
+    if (fixedSizeKernel != nullptr && !templateSparse.empty() && searchArea <= FIXED_SIZE_MAX_SEARCH_AREA)
+    {
+        fixedSizeKernel(grayscaleScreenshot, templateSparse, result);
+        return;
+    }
+
+    // masked templates go through the sparse kernel which only visits their opaque pixels
+    // opencv computes several dense correlations for a masked match so its only used for the unmasked ones
+    if (!templateSparse.empty() && isSparseMatchModeSupported(matchMode))
+    {
+        matchSparseTemplate(grayscaleScreenshot, templateSparse, matchMode, result);
+        return;
+    }
 
     int result_cols = grayscaleScreenshot.cols - templateGrayscale.cols + 1;
     int result_rows = grayscaleScreenshot.rows - templateGrayscale.rows + 1;
 
-    Mat result;
     result.create(result_rows, result_cols, CV_32FC1);
 
     cv::matchTemplate(grayscaleScreenshot, templateGrayscale, result, matchMode, templateAlpha);
+}
+
+void matchSingleTemplate(const Mat &screenshot, const Mat &templateGrayscale, const Mat &templateAlpha, const SparseTemplate &templateSparse,
+    FixedSizeKernel fixedSizeKernel, const string &templateName, TemplateMatchModes matchMode, double confidenceThreshold, vector<double> &matchScores, vector<Rect> &matchRectangles, vector<int> &deduplicatedMatchIndexes)
+{
+    Mat grayscaleScreenshot = toGrayscale(screenshot);
+
+    // the squared difference modes only keep the best match, so unmasked templates skip the result map entirely
+    if (isBoundedSearchSupported(matchMode, templateAlpha))
+    {
+        double score;
+        Point location;
+        if (findBestSquaredDifference(grayscaleScreenshot, templateGrayscale, matchMode, confidenceThreshold, score, location))
+        {
+            matchRectangles.emplace_back(location, templateGrayscale.size());
+            matchScores.emplace_back(score);
+            deduplicatedMatchIndexes.emplace_back(0);
+        }
+        return;
+    }
+
+    Mat result;
+    computeMatchResult(grayscaleScreenshot, templateGrayscale, templateAlpha, templateSparse, fixedSizeKernel, matchMode, result);
 
     // if were using one of these 2 methods, lower scores indicate better matches because they compute the squared difference
     // so we find matches below threshold
@@ -186,134 +285,302 @@ void matchSingleTemplate(Mat screenshot, Mat templateGrayscale, Mat templateAlph
     // else find matches above threshold
     else
     {
-        for (int y = 0; y < result.rows; y++) 
-        {
-            for (int x = 0; x < result.cols; x++) 
-            {
-                double score = result.at<float>(y, x);
-                if (score >= confidenceThreshold && !isinf(score)) 
-                {
-                    matchRectangles.emplace_back(Point(x, y), templateGrayscale.size());
-                    matchScores.emplace_back(score);
-                }
-            }
-        }
+        collectCandidates(result, confidenceThreshold, templateGrayscale.size(), matchRectangles, matchScores);
 
         // applying Non-Maximum Suppression to remove duplicate matches
         double nmsThreshold = 0.3;  // overlap threshold for NMS
-        applyNMS(matchRectangles, matchScores, nmsThreshold, deduplicatedMatchIndexes);
+        applyBucketedNMS(matchRectangles, sortByScore(matchScores), templateGrayscale.size(), nmsThreshold, deduplicatedMatchIndexes);
     }
 }
 
-void matchTemplatesParallel(Mat &screenshot, int screenshotOffset, vector<vector<Mat>> &screenshotGrid, vector<Template> &templates,
-    ThreadPool &threadPool, vector<vector<TemplateMatch>> &resultMatches)
+void collectCandidates(const Mat &result, double confidenceThreshold, Size templateSize, vector<Rect> &boxes, vector<double> &scores)
 {
-    // templates - rows - columns - matches
-    vector<vector<vector<vector<double>>>> matchedConfidences(templates.size(), vector<vector<vector<double>>>(screenshotGrid.size(), vector<vector<double>>(screenshotGrid[0].size())));
-    vector<vector<vector<vector<Rect>>>> matchedRectangles(templates.size(), vector<vector<vector<Rect>>>(screenshotGrid.size(), vector<vector<Rect>>(screenshotGrid[0].size())));
-    vector<vector<vector<vector<int>>>> firstNMSPassDeduplicatedIndexes(templates.size(), vector<vector<vector<int>>>(screenshotGrid.size(), vector<vector<int>>(screenshotGrid[0].size())));
-    
-    // for each template
-    for (int i = 0; i < templates.size(); i++)
+    for (int y = 0; y < result.rows; y++)
     {
-        // if the template requires using the divided screenshot
-        if (templates[i].useDividedScreenshot == true)
+        const float *row = result.ptr<float>(y);
+        for (int x = 0; x < result.cols; x++)
         {
-            // for each row of the grid
-            for (int gridRow = 0; gridRow < screenshotGrid.size(); gridRow++)
+            double score = row[x];
+            if (score >= confidenceThreshold && !isinf(score))
             {
-                // for each column of the grid
-                for (int gridColumn = 0; gridColumn < screenshotGrid[gridRow].size(); gridColumn++)
-                {
-                    threadPool.enqueue(std::bind(matchSingleTemplate, 
-                        screenshotGrid[gridRow][gridColumn], 
-                        templates[i].grayscale, 
-                        templates[i].alpha, 
-                        templates[i].name, 
-                        templates[i].matchingMode,
-                        templates[i].confidenceThreshold,
-                        ref(matchedConfidences[i][gridRow][gridColumn]),
-                        ref(matchedRectangles[i][gridRow][gridColumn]),
-                        ref(firstNMSPassDeduplicatedIndexes[i][gridRow][gridColumn])));
-                }
+                boxes.emplace_back(Point(x, y), templateSize);
+                scores.emplace_back(score);
             }
         }
-        // else use the full screenshot
-        else
+    }
+}
+
+// masked templates that keep every match above their threshold, the ones the sparse kernel would otherwise handle one by one
+static bool useNccEngine(const Template &t)
+{
+    return !t.ncc.empty() && !t.sparse.empty() && isNccMatchModeSupported(t.matchingMode)
+        && t.matchingMode != TM_SQDIFF && t.matchingMode != TM_SQDIFF_NORMED;
+}
+
+// groups the ncc templates that can be matched in the same pass, same size, matching mode and screenshot layout
+// the live bot only matches palladium for now (see the RESOURCE_TEMPLATES static_assert), so its groups have a single member
+// and the sharing only kicks in once the main loop reads more than one resource template
+static void buildNccGroups(const vector<Template> &templates, vector<NccGroup> &groups, vector<vector<int>> &groupTemplates)
+{
+    vector<bool> grouped(templates.size(), false);
+    for (int i = 0; i < templates.size(); i++)
+    {
+        if (grouped[i] || !useNccEngine(templates[i])) continue;
+
+        vector<int> members;
+        for (int j = i; j < templates.size() && members.size() < NCC_MAX_GROUP_SIZE; j++)
         {
-            threadPool.enqueue(std::bind(matchSingleTemplate, 
-                screenshot,
-                templates[i].grayscale, 
-                templates[i].alpha, 
-                templates[i].name, 
-                templates[i].matchingMode,
-                templates[i].confidenceThreshold,
-                ref(matchedConfidences[i][0][0]),
-                ref(matchedRectangles[i][0][0]),
-                ref(firstNMSPassDeduplicatedIndexes[i][0][0])));
+            if (grouped[j] || !useNccEngine(templates[j])) continue;
+            if (templates[j].ncc.width != templates[i].ncc.width || templates[j].ncc.height != templates[i].ncc.height) continue;
+            if (templates[j].matchingMode != templates[i].matchingMode || templates[j].useDividedScreenshot != templates[i].useDividedScreenshot) continue;
+
+            members.push_back(j);
+            grouped[j] = true;
         }
+
+        vector<const NccTemplate *> nccMembers;
+        for (int member : members) nccMembers.push_back(&templates[member].ncc);
+
+        groups.emplace_back();
+        buildNccGroup(nccMembers, groups.back());
+        groupTemplates.push_back(members);
     }
-    threadPool.waitForCompletion();
+}
 
-    // grabbing the size of the grid
-    int gridSizeX = screenshotGrid[0][0].cols - screenshotOffset;
-    int gridSizeY = screenshotGrid[0][0].rows - screenshotOffset;
+// where a view created with Mat::operator() sits inside the frame it was cut from
+static Rect locateInFrame(const Mat &view, const Mat &frame)
+{
+    Size wholeSize;
+    Point viewOffset, frameOffset;
+    view.locateROI(wholeSize, viewOffset);
+    frame.locateROI(wholeSize, frameOffset);
+    return Rect(viewOffset - frameOffset, view.size());
+}
 
-    // templates - matches
-    vector<vector<Rect>> firstNMSPassMatchedRectangles(templates.size());
-    vector<vector<double>> firstNMSPassMatchedConfidences(templates.size());
+// one unit of work of matchTemplatesParallel, a single template or a whole ncc group on one region of the frame
+// plain data so the jobs of a frame are one contiguous array that the workers index into
+struct MatchJob {
+    int templateIndex;      // first member for ncc group jobs
+    int nccGroup;           // -1 for single template jobs
+    int cell;               // grid cell the results go to, gridRow * gridColumns + gridColumn
+    Rect region;            // in frame coordinates
+};
+
+// matches of one template on one grid cell, before the second nms pass
+struct MatchCell {
+    vector<double> confidences;
+    vector<Rect> rectangles;
+    vector<int> deduplicatedIndexes;
+};
+
+// distance from a point to the closest point of a rectangle, 0 inside of it
+static double distanceToRect(Point point, const Rect &rect)
+{
+    int dx = max({ rect.x - point.x, 0, point.x - (rect.x + rect.width) });
+    int dy = max({ rect.y - point.y, 0, point.y - (rect.y + rect.height) });
+    return sqrt(double(dx) * dx + double(dy) * dy);
+}
+
+void matchTemplatesParallel(Mat &screenshot, int screenshotOffset, vector<vector<Mat>> &screenshotGrid, vector<Template> &templates,
+    ThreadPool &threadPool, vector<vector<TemplateMatch>> &resultMatches, MatchBudget *budget)
+{
+    int gridRows = screenshotGrid.size();
+    int gridColumns = screenshotGrid[0].size();
+    int cellCount = gridRows * gridColumns;
+
+    // templates - grid cells, the cells of template i start at i * cellCount
+    // templates that use the full screenshot only fill their first cell
+    vector<MatchCell> cells(templates.size() * cellCount);
+
+    // where every grid cell sits in the screenshot, the matches are moved by this to get their full screenshot coordinates
+    vector<Rect> cellRegions(cellCount);
+    for (int gridRow = 0; gridRow < gridRows; gridRow++)
+    {
+        for (int gridColumn = 0; gridColumn < gridColumns; gridColumn++)
+        {
+            cellRegions[gridRow * gridColumns + gridColumn] = locateInFrame(screenshotGrid[gridRow][gridColumn], screenshot);
+        }
+    }
+    Rect fullRegion(0, 0, screenshot.cols, screenshot.rows);
 
-    // going through all the matches from each thread and aggregating the deduplicated ones on the first pass of NMS into one structure
-    // also adjusting the location of the matched points and rects to match real the coordinates on the full screenshot
- 
-    // for each template
+    // the masked templates go through the ncc engine, the row integrals are built once for the whole frame
+    // and every group of same size templates is matched in one pass per grid cell
+    vector<NccGroup> nccGroups;
+    vector<vector<int>> nccGroupTemplates;
+    buildNccGroups(templates, nccGroups, nccGroupTemplates);
+
+    NccFrame nccFrame;
+    if (!nccGroups.empty()) nccFrame.build(screenshot, threadPool);
+
+    // describing every job of the frame up front
+    vector<MatchJob> jobs;
+    jobs.reserve(templates.size() * cellCount);
+
+    auto addJobs = [&](int templateIndex, int nccGroup) {
+        if (templates[templateIndex].useDividedScreenshot)
+        {
+            for (int cell = 0; cell < cellCount; cell++) jobs.push_back({ templateIndex, nccGroup, cell, cellRegions[cell] });
+        }
+        else
+        {
+            jobs.push_back({ templateIndex, nccGroup, 0, fullRegion });
+        }
+    };
+
+    for (int g = 0; g < nccGroups.size(); g++) addJobs(nccGroupTemplates[g][0], g);
     for (int i = 0; i < templates.size(); i++)
     {
-        // for each row of the grid
-        for (int gridRow = 0; gridRow < screenshotGrid.size(); gridRow++)
+        if (!useNccEngine(templates[i])) addJobs(i, -1);
+    }
+
+    // with a budget the critical jobs go first, then the optional ones from the cell that waited the longest
+    // and the pool stops starting optional jobs once the deadline passed
+    TaskDeadline deadline;
+    deadline.requiredCount = int(jobs.size());
+    if (budget != nullptr)
+    {
+        budget->framesSinceMatched.resize(cellCount, 0);
+
+        auto isCritical = [&](const MatchJob &job) { return distanceToRect(budget->ship, job.region) <= budget->criticalDistance; };
+        stable_sort(jobs.begin(), jobs.end(), [&](const MatchJob &a, const MatchJob &b) {
+            bool aCritical = isCritical(a);
+            bool bCritical = isCritical(b);
+            if (aCritical != bCritical) return aCritical;
+            if (aCritical) return false;
+            return budget->framesSinceMatched[a.cell] > budget->framesSinceMatched[b.cell];
+        });
+
+        deadline.deadline = budget->deadline;
+        deadline.requiredCount = int(count_if(jobs.begin(), jobs.end(), isCritical));
+    }
+
+    // set by the job itself, so the budget knows which cells were matched this frame
+    vector<char> jobRan(jobs.size(), 0);
+
+    // the workers pull jobs off the array by index, nothing gets allocated or locked per job
+    threadPool.parallelFor(int(jobs.size()), 1, [&](int jobIndex) {
+        const MatchJob &job = jobs[jobIndex];
+        jobRan[jobIndex] = 1;
+
+        if (job.nccGroup >= 0)
         {
-            // for each grid cell in the row
-            for (int gridColumn = 0; gridColumn < screenshotGrid[gridRow].size(); gridColumn++)
-            {
-                // only for the deduplicated matches
-                for (int j = 0; j < firstNMSPassDeduplicatedIndexes[i][gridRow][gridColumn].size(); j++)
-                {
-                    int overlapOffsetX = gridColumn == 0 ? 0 : -screenshotOffset;
-                    int overlapOffsetY = gridRow == 0 ? 0 : -screenshotOffset;
+            vector<Mat> results;
+            matchNccGroup(nccFrame, job.region, nccGroups[job.nccGroup], templates[job.templateIndex].matchingMode, results);
 
-                    int xOffset = gridColumn * gridSizeX + overlapOffsetX;
-                    int yOffset = gridRow * gridSizeY + overlapOffsetY;
+            for (int k = 0; k < results.size(); k++)
+            {
+                int i = nccGroupTemplates[job.nccGroup][k];
+                MatchCell &cell = cells[i * cellCount + job.cell];
+                collectCandidates(results[k], templates[i].confidenceThreshold, templates[i].grayscale.size(), cell.rectangles, cell.confidences);
+                applyBucketedNMS(cell.rectangles, sortByScore(cell.confidences), templates[i].grayscale.size(), 0.3, cell.deduplicatedIndexes);
+            }
+            return;
+        }
 
-                    int deduplicatedMatchIndex = firstNMSPassDeduplicatedIndexes[i][gridRow][gridColumn][j];
+        const Template &t = templates[job.templateIndex];
+        MatchCell &cell = cells[job.templateIndex * cellCount + job.cell];
+        matchSingleTemplate(screenshot(job.region), t.grayscale, t.alpha, t.sparse, t.fixedSizeKernel, t.name, t.matchingMode, t.confidenceThreshold,
+            cell.confidences, cell.rectangles, cell.deduplicatedIndexes);
+    }, deadline);
 
-                    Rect adjustedRect = Rect(
-                        matchedRectangles[i][gridRow][gridColumn][deduplicatedMatchIndex].x + xOffset, 
-                        matchedRectangles[i][gridRow][gridColumn][deduplicatedMatchIndex].y + yOffset,
-                        matchedRectangles[i][gridRow][gridColumn][deduplicatedMatchIndex].width, 
-                        matchedRectangles[i][gridRow][gridColumn][deduplicatedMatchIndex].height);
+    if (budget != nullptr)
+    {
+        // a group job covers every template of its group
+        budget->skippedRegions.assign(templates.size(), vector<Rect>());
+        vector<bool> cellMatched(cellCount, false);
+        for (int j = 0; j < jobs.size(); j++)
+        {
+            if (jobRan[j] && templates[jobs[j].templateIndex].useDividedScreenshot) cellMatched[jobs[j].cell] = true;
+            if (jobRan[j]) continue;
 
-                    firstNMSPassMatchedRectangles[i].emplace_back(adjustedRect);
-                    firstNMSPassMatchedConfidences[i].emplace_back(matchedConfidences[i][gridRow][gridColumn][deduplicatedMatchIndex]);
-                }
+            if (jobs[j].nccGroup < 0)
+            {
+                budget->skippedRegions[jobs[j].templateIndex].push_back(jobs[j].region);
+            }
+            else
+            {
+                for (int i : nccGroupTemplates[jobs[j].nccGroup]) budget->skippedRegions[i].push_back(jobs[j].region);
             }
         }
+        for (int c = 0; c < cellCount; c++)
+        {
+            budget->framesSinceMatched[c] = cellMatched[c] ? 0 : budget->framesSinceMatched[c] + 1;
+        }
     }
 
-    // applying a second pass of NMS for each template because there might still be duplicates caused by the overlapping screenshot grid cells
-    vector<vector<int>> secondNMSPassDeduplicatedIndexes(templates.size());
-    // for each template
-    for (int i = 0; i < firstNMSPassMatchedRectangles.size(); i++)
+    // going through the deduplicated matches of every cell, moving them to their full screenshot coordinates
+    // and applying a second pass of NMS because there might still be duplicates caused by the overlapping screenshot grid cells
+    for (int i = 0; i < templates.size(); i++)
     {
-        applyNMS(firstNMSPassMatchedRectangles[i], firstNMSPassMatchedConfidences[i], 0.3, secondNMSPassDeduplicatedIndexes[i]);
+        vector<Rect> firstNMSPassMatchedRectangles;
+        vector<double> firstNMSPassMatchedConfidences;
+
+        int usedCells = templates[i].useDividedScreenshot ? cellCount : 1;
+        for (int c = 0; c < usedCells; c++)
+        {
+            const MatchCell &cell = cells[i * cellCount + c];
+            Point cellOffset = templates[i].useDividedScreenshot ? cellRegions[c].tl() : Point(0, 0);
+
+            for (int deduplicatedMatchIndex : cell.deduplicatedIndexes)
+            {
+                firstNMSPassMatchedRectangles.emplace_back(cell.rectangles[deduplicatedMatchIndex] + cellOffset);
+                firstNMSPassMatchedConfidences.emplace_back(cell.confidences[deduplicatedMatchIndex]);
+            }
+        }
+
+        vector<int> secondNMSPassDeduplicatedIndexes;
+        applyBucketedNMS(firstNMSPassMatchedRectangles, sortByScore(firstNMSPassMatchedConfidences), templates[i].grayscale.size(), 0.3,
+            secondNMSPassDeduplicatedIndexes);
+
         // placing the deduplicated matches into the final result vectors
-        for (int j = 0; j < secondNMSPassDeduplicatedIndexes[i].size(); j++)
+        for (int index : secondNMSPassDeduplicatedIndexes)
         {
-            TemplateMatch match = TemplateMatch(
-                firstNMSPassMatchedRectangles[i][secondNMSPassDeduplicatedIndexes[i][j]],
-                firstNMSPassMatchedConfidences[i][secondNMSPassDeduplicatedIndexes[i][j]],
-                templates[i].identifier);
+            resultMatches[i].emplace_back(firstNMSPassMatchedRectangles[index], firstNMSPassMatchedConfidences[index], templates[i].identifier);
+        }
+    }
+}
 
-            resultMatches[i].emplace_back(match);
+// thresholds and modes stay the same, a shrunk pixel stays opaque when most of the pixels it covers were
+void decimateTemplates(const vector<Template> &templates, int decimation, vector<Template> &decimated)
+{
+    decimated = templates;
+    if (decimation <= 1) return;
+
+    for (Template &t : decimated)
+    {
+        if (t.grayscale.empty()) continue;
+
+        Size size(max(1, t.grayscale.cols / decimation), max(1, t.grayscale.rows / decimation));
+        Mat grayscale;
+        resize(t.grayscale, grayscale, size, 0, 0, INTER_AREA);
+        t.grayscale = grayscale;
+
+        t.sparse = SparseTemplate();
+        t.fixedSizeKernel = nullptr;
+        if (!t.alpha.empty())
+        {
+            Mat alpha;
+            resize(t.alpha, alpha, size, 0, 0, INTER_AREA);
+            threshold(alpha, alpha, 127, 255, THRESH_BINARY);
+            t.alpha = alpha;
+            buildSparseTemplate(t.grayscale, t.alpha, t.sparse);
+        }
+        buildNccTemplate(t.grayscale, t.alpha, t.ncc);
+    }
+}
+
+void upscaleMatches(vector<vector<TemplateMatch>> &matches, const vector<Template> &templates, int decimation)
+{
+    if (decimation <= 1) return;
+
+    for (int i = 0; i < matches.size() && i < templates.size(); i++)
+    {
+        Size size = templates[i].grayscale.size();
+        for (TemplateMatch &match : matches[i])
+        {
+            // the centers line up, the corners dont once a template size was rounded down
+            Point center((match.rect.x + match.rect.width / 2) * decimation, (match.rect.y + match.rect.height / 2) * decimation);
+            match.rect = Rect(center.x - size.width / 2, center.y - size.height / 2, size.width, size.height);
         }
     }
 }
@@ -448,19 +715,77 @@ void applyNMS(const vector<Rect> &boxes, const vector<double> &scores, double nm
     }
 }
 
-bool matchTemplateWithHighestScore(Mat screenshot, Mat templateGrayscale, Mat templateAlpha, string templateName, TemplateMatchModes matchMode, double confidenceThreshold,
-    double &matchScore, Rect &matchRectangle)
+vector<int> sortByScore(const vector<double> &scores)
 {
-    Mat grayscaleScreenshot;
-    cv::cvtColor(screenshot, grayscaleScreenshot, cv::COLOR_BGR2GRAY);
+    vector<int> order(scores.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](int i1, int i2) {
+        return scores[i1] > scores[i2];
+        });
+    return order;
+}
 
-    int result_cols = grayscaleScreenshot.cols - templateGrayscale.cols + 1;
-    int result_rows = grayscaleScreenshot.rows - templateGrayscale.rows + 1;
+// a box is kept unless a better kept box overlaps it by more than the threshold
+// applyNMS compares every kept box with every remaining candidate, which grows with the square of the candidates around each peak,
+// here the kept boxes are bucketed by position and a candidate is only compared with the ones in the 3x3 buckets around it
+void applyBucketedNMS(const vector<Rect> &boxes, const vector<int> &order, Size boxSize, double nmsThreshold, vector<int> &indices)
+{
+    if (boxes.empty()) return;
 
-    Mat result;
-    result.create(result_rows, result_cols, CV_32FC1);
+    int bucketColumns = 1;
+    int bucketRows = 1;
+    for (const Rect &box : boxes)
+    {
+        bucketColumns = max(bucketColumns, box.x / boxSize.width + 1);
+        bucketRows = max(bucketRows, box.y / boxSize.height + 1);
+    }
+    vector<vector<int>> buckets(bucketColumns * bucketRows);
 
-    cv::matchTemplate(grayscaleScreenshot, templateGrayscale, result, matchMode, templateAlpha);
+    for (int index : order)
+    {
+        const Rect &box = boxes[index];
+        int column = box.x / boxSize.width;
+        int row = box.y / boxSize.height;
+
+        // boxes of the same size only overlap when they are less than one box apart, so in this or a neighbouring bucket
+        bool suppressed = false;
+        for (int r = max(0, row - 1); r <= min(bucketRows - 1, row + 1) && !suppressed; r++)
+        {
+            for (int c = max(0, column - 1); c <= min(bucketColumns - 1, column + 1) && !suppressed; c++)
+            {
+                for (int kept : buckets[r * bucketColumns + c])
+                {
+                    if (calculateIoU(boxes[kept], box) > nmsThreshold)
+                    {
+                        suppressed = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (suppressed) continue;
+        indices.push_back(index);
+        buckets[row * bucketColumns + column].push_back(index);
+    }
+}
+
+bool matchTemplateWithHighestScore(Mat screenshot, Mat templateGrayscale, Mat templateAlpha, const SparseTemplate &templateSparse,
+    FixedSizeKernel fixedSizeKernel, string templateName, TemplateMatchModes matchMode, double confidenceThreshold, double &matchScore, Rect &matchRectangle)
+{
+    Mat grayscaleScreenshot = toGrayscale(screenshot);
+
+    if (isBoundedSearchSupported(matchMode, templateAlpha))
+    {
+        Point location;
+        if (!findBestSquaredDifference(grayscaleScreenshot, templateGrayscale, matchMode, confidenceThreshold, matchScore, location)) return false;
+
+        matchRectangle = Rect(location, templateGrayscale.size());
+        return true;
+    }
+
+    Mat result;
+    computeMatchResult(grayscaleScreenshot, templateGrayscale, templateAlpha, templateSparse, fixedSizeKernel, matchMode, result);
 
     double minScore, maxScore;
     Point minPoint, maxPoint;
@@ -492,4 +817,34 @@ bool matchTemplateWithHighestScore(Mat screenshot, Mat templateGrayscale, Mat te
     }
 
     return false;
+}
+
+// moves the previous frame's matches by the camera shift and only looks for them again in a small window around where they should be now
+// the windows are tiny compared to the full scan so they are matched one after another on the calling thread
+void trackDetections(Mat &screenshot, const vector<vector<TemplateMatch>> &previousMatches, Point2d shift, vector<Template> &templates,
+    int searchMargin, vector<vector<TemplateMatch>> &resultMatches)
+{
+    Point offset(cvRound(shift.x), cvRound(shift.y));
+    Rect screenshotRect(0, 0, screenshot.cols, screenshot.rows);
+
+    for (int i = 0; i < templates.size(); i++)
+    {
+        for (const TemplateMatch &previous : previousMatches[i])
+        {
+            Rect predicted = previous.rect + offset;
+            Rect searchWindow = Rect(predicted.x - searchMargin, predicted.y - searchMargin,
+                predicted.width + 2 * searchMargin, predicted.height + 2 * searchMargin) & screenshotRect;
+
+            // scrolled off screen, or too close to the edge for the template to fit
+            if (searchWindow.width < templates[i].grayscale.cols || searchWindow.height < templates[i].grayscale.rows) continue;
+
+            double score;
+            Rect match;
+            if (matchTemplateWithHighestScore(screenshot(searchWindow), templates[i].grayscale, templates[i].alpha, templates[i].sparse,
+                templates[i].fixedSizeKernel, templates[i].name, templates[i].matchingMode, templates[i].confidenceThreshold, score, match))
+            {
+                resultMatches[i].emplace_back(match + searchWindow.tl(), score, templates[i].identifier);
+            }
+        }
+    }
 }
\ No newline at end of file
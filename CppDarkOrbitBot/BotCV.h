@@ -2,6 +2,7 @@
 #define BOT_CV
 
 #include "ThreadPool.h"
+#include "FrameConversion.h"
 #include <opencv2/core/types.hpp>
 #include <opencv2/imgproc.hpp>
 #include <Windows.h>
@@ -11,16 +12,35 @@ using namespace cv;
 
 class ScreenshotManager {
 public:
-    explicit ScreenshotManager(HWND hwnd);
+    explicit ScreenshotManager(HWND hwnd, const CaptureSettings &settings = CaptureSettings());
 
     ~ScreenshotManager();
 
+    // the frame in the configured format and size
     cv::Mat capture();
+    // same, color is filled with the full resolution BGR frame when keepColor is set
+    cv::Mat capture(cv::Mat &color);
+
+    // when the window contents of the last frame were grabbed, the frame shows the game as it was at this moment
+    long long getLastCaptureMicros() const;
+
+    // a small part of the frame that is also handed out in BGR when the frame itself is grayscale, in frame coordinates
+    // filled on every capture, empty region to turn it off
+    void setColorRegion(Rect region);
+    const cv::Mat &getColorRegion() const;
 
 private:
     HWND hwnd_;
+    CaptureSettings settings_;
 
     int width_, height_;
+    long long lastCaptureMicros_;
+
+    Rect colorRegion_;
+    cv::Mat colorRegionImage_;
+
+    // BGRA target of GetDIBits when the frame gets converted, reused between captures
+    cv::Mat bgra_;
 
     HDC hwindowDC_;
     HDC hwindowCompatibleDC_;
@@ -33,18 +53,41 @@ private:
     void cleanup();
 };
 
+// how much of the frame the resource matching may take, the grid cells near the ship are always matched
+// and the others only while time is left, the cells skipped on one frame go first among the optional ones on the next
+struct MatchBudget {
+    chrono::steady_clock::time_point deadline;
+    Point ship;                         // in frame coordinates
+    double criticalDistance = 250.0;    // cells whose region comes this close to the ship are critical
+    vector<int> framesSinceMatched;     // per grid cell, kept by the caller between frames
+    vector<vector<Rect>> skippedRegions;    // set by the matching, per template the regions it wasnt matched on in the last frame
+};
+
 void drawMultipleTargets(Mat &screenshot, vector<TemplateMatch> &matches, string templateName);
 void drawSingleTarget(Mat &screenshot, TemplateMatch target, string name, Scalar color);
 void drawSingleTarget(Mat &screenshot, Rect target, string name, Scalar color);
-void matchSingleTemplate(Mat screenshot, Mat templateGrayscale, Mat templateAlpha, string templateName, TemplateMatchModes matchMode, double confidenceThreshold,
-    vector<double> &matchScores, vector<Rect> &matchRectangles, vector<int> &deduplicatedMatchIndexes);
+void matchSingleTemplate(const Mat &screenshot, const Mat &templateGrayscale, const Mat &templateAlpha, const SparseTemplate &templateSparse,
+    FixedSizeKernel fixedSizeKernel, const string &templateName, TemplateMatchModes matchMode, double confidenceThreshold, vector<double> &matchScores, vector<Rect> &matchRectangles, vector<int> &deduplicatedMatchIndexes);
 void matchTemplatesParallel(Mat &screenshot, int screenshotOffset, vector<vector<Mat>> &screenshotGrid, vector<Template> &templates,
-    ThreadPool &threadPool, vector<vector<TemplateMatch>> &resultMatches);
+    ThreadPool &threadPool, vector<vector<TemplateMatch>> &resultMatches, MatchBudget *budget = nullptr);
+// the templates shrunk by decimation, for matching on a frame shrunk by the same factor
+void decimateTemplates(const vector<Template> &templates, int decimation, vector<Template> &decimated);
+// moves matches found on a decimated frame back to full frame coordinates, sized like the full templates
+void upscaleMatches(vector<vector<TemplateMatch>> &matches, const vector<Template> &templates, int decimation);
 vector<vector<Mat>> divideImage(Mat image, int gridWidth, int gridHeight, int overlapAmount);
 Mat screenshotWindow(HWND hwnd);
 double calculateIoU(const cv::Rect& a, const cv::Rect& b);
+void collectCandidates(const Mat &result, double confidenceThreshold, Size templateSize, vector<Rect> &boxes, vector<double> &scores);
 void applyNMS(const vector<Rect>& boxes, const vector<double>& scores, double nmsThreshold, vector<int>& indices);
-bool matchTemplateWithHighestScore(Mat screenshot, Mat templateGrayscale, Mat templateAlpha, string templateName, TemplateMatchModes matchMode, double confidenceThreshold,
-    double &matchScore, Rect &matchRectangle);
+// candidate indexes best first, in the same order applyNMS visits them
+vector<int> sortByScore(const vector<double> &scores);
+// same result as applyNMS for boxes that all have boxSize, order comes from sortByScore
+void applyBucketedNMS(const vector<Rect> &boxes, const vector<int> &order, Size boxSize, double nmsThreshold, vector<int> &indices);
+bool matchTemplateWithHighestScore(Mat screenshot, Mat templateGrayscale, Mat templateAlpha, const SparseTemplate &templateSparse,
+    FixedSizeKernel fixedSizeKernel, string templateName, TemplateMatchModes matchMode, double confidenceThreshold, double &matchScore, Rect &matchRectangle);
+void trackDetections(Mat &screenshot, const vector<vector<TemplateMatch>> &previousMatches, Point2d shift, vector<Template> &templates,
+    int searchMargin, vector<vector<TemplateMatch>> &resultMatches);
+void computeMatchResult(const Mat &grayscaleScreenshot, const Mat &templateGrayscale, const Mat &templateAlpha, const SparseTemplate &templateSparse,
+    FixedSizeKernel fixedSizeKernel, TemplateMatchModes matchMode, Mat &result);
 
 #endif
\ No newline at end of file
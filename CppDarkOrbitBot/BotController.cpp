@@ -0,0 +1,157 @@
+#include <opencv2/core/types.hpp>
+#include <random>
+
+#include "BotController.h"
+#include "BotCV.h"
+#include "AsyncLogger.h"
+
+using namespace std;
+using namespace cv;
+
+BotController::BotController(RoutePlanner &routePlanner, WorldMap &worldMap, const BotControllerSettings &settings, function<void(int, int, bool)> click) :
+    routePlanner_(routePlanner), worldMap_(worldMap), settings_(settings), click_(click), status_(SCANNING), resources_(nullptr), minimap_(nullptr)
+{
+    // runs until the first wait, from then on it is only resumed by the executor
+    mainTask_ = run();
+    mainTask_.start();
+}
+
+void BotController::onFrame(const Mat &screenshot, const vector<TemplateMatch> &resources, const MinimapReading &minimap)
+{
+    screenshot_ = screenshot;
+    resources_ = &resources;
+    minimap_ = &minimap;
+
+    executor_.onFrame(getCurrentMillis());
+
+    screenshot_.release();
+    resources_ = nullptr;
+    minimap_ = nullptr;
+}
+
+BotStatus BotController::getStatus() const
+{
+    return status_;
+}
+
+Task BotController::run()
+{
+    while (true)
+    {
+        co_await executor_.nextFrame();
+
+        if (routePlanner_.hasNext())
+        {
+            co_await approach();
+        }
+        else if (resources_->empty())
+        {
+            co_await travel();
+
+            // a resource showed up while traveling, going for it on the same frame
+            if (status_ == TRAVELING) co_await approach();
+        }
+    }
+}
+
+// moves to the next target of the route and keeps collecting along the route while the next target is still on screen
+Task BotController::approach()
+{
+    clickNextTarget();
+
+    while (true)
+    {
+        double score = 0;
+        bool arrived = co_await executor_.waitUntil([this, &score]() { return collectionVisible(score); }, settings_.movingTimeoutMillis);
+
+        if (!arrived)
+        {
+            routePlanner_.clear();
+            logEvent(LOG_MOVING_TIMEOUT);
+            setStatus(SCANNING);
+            co_return;
+        }
+
+        logEvent(LOG_FOUND_COLLECTING_MATCH, score);
+        setStatus(COLLECTING);
+
+        co_await executor_.sleepFor(settings_.collectingMillis);
+        logEvent(LOG_COLLECTED_RESOURCE);
+        worldMap_.recordCollected(getCurrentMillis());
+
+        // going straight for the next target of the route if it can still be found on screen
+        if (!routePlanner_.hasNext() || !routePlanner_.confirmNext(*resources_, settings_.routeSnapRadius))
+        {
+            setStatus(SCANNING);
+            co_return;
+        }
+
+        clickNextTarget();
+    }
+}
+
+// heads towards the closest resource dot on the minimap, or the area the world map remembers as the most promising,
+// until a resource is seen or the traveling times out
+Task BotController::travel()
+{
+    logEvent(LOG_NO_RESOURCES_FOUND);
+    setStatus(TRAVELING);
+
+    Point destination = travelDestination();
+    click_(destination.x, destination.y, false);
+
+    bool found = co_await executor_.waitUntil([this]() { return routePlanner_.hasNext(); }, settings_.travelingTimeoutMillis);
+    if (!found)
+    {
+        logEvent(LOG_TRAVELING_TIMEOUT);
+        setStatus(SCANNING);
+    }
+}
+
+Point BotController::travelDestination()
+{
+    Rect minimap = settings_.minimapRect;
+
+    if (minimap_ != nullptr && minimap_->targetFound)
+    {
+        return Point(minimap.x + cvRound(minimap_->target.x), minimap.y + cvRound(minimap_->target.y));
+    }
+
+    Point2d remembered;
+    if (worldMap_.chooseDestination(getCurrentMillis(), remembered))
+    {
+        return Point(minimap.x + cvRound(remembered.x), minimap.y + cvRound(remembered.y));
+    }
+
+    Point topLeft = Point(minimap.x + minimap.width / 3.13, minimap.y + minimap.height / 1.42);
+    Point bottomRight = Point(minimap.x + minimap.width / 1.32, minimap.y + minimap.height / 1.07);
+
+    // generating a random location inside the palladium field
+    random_device rd;
+    mt19937 gen(rd());
+    uniform_int_distribution<int> rdY(topLeft.y, bottomRight.y);
+    return Point(bottomRight.x - 12, rdY(gen));
+}
+
+void BotController::clickNextTarget()
+{
+    TemplateMatch target = routePlanner_.peekNext();
+    click_(target.rect.x + target.rect.width / 2, target.rect.y + target.rect.height / 2, true);
+    routePlanner_.popNext();
+    setStatus(MOVING);
+}
+
+bool BotController::collectionVisible(double &score)
+{
+    const Template &collection = settings_.collectionTemplate;
+    Rect rectangle;
+    return matchTemplateWithHighestScore(screenshot_(settings_.collectionRegion),
+        collection.grayscale, collection.alpha, collection.sparse, collection.fixedSizeKernel, collection.name, collection.matchingMode,
+        settings_.collectionThreshold, score, rectangle);
+}
+
+void BotController::setStatus(BotStatus status)
+{
+    status_ = status;
+    logEvent(LOG_BOT_STATUS, status_);
+}
@@ -0,0 +1,66 @@
+#ifndef BOT_CONTROLLER
+#define BOT_CONTROLLER
+
+#include <opencv2/core/types.hpp>
+#include <functional>
+#include <vector>
+
+#include "BotUtils.h"
+#include "BotExecutor.h"
+#include "RoutePlanner.h"
+#include "MinimapAnalyzer.h"
+#include "WorldMap.h"
+
+using namespace std;
+using namespace cv;
+
+struct BotControllerSettings {
+    Template collectionTemplate;                // the resource that shows up under the ship once it has been reached
+    Rect collectionRegion = Rect(935, 615, 50, 50);
+    double collectionThreshold = 0.5;
+    long long movingTimeoutMillis = 2500;       // longer than this without reaching the target and we are probably stuck
+    long long collectingMillis = 50;
+    long long travelingTimeoutMillis = 10000;
+    double routeSnapRadius = 60.0;
+    Rect minimapRect;
+};
+
+// the bot behaviour written as coroutines instead of a chain of status checks and timers in the frame loop
+// every behaviour suspends on the executor until the frame it is waiting for, the frame loop only feeds it frames
+class BotController {
+public:
+    // click gets the screen position and whether it is on something in the world that moves with the camera, not on the hud
+    BotController(RoutePlanner &routePlanner, WorldMap &worldMap, const BotControllerSettings &settings, function<void(int, int, bool)> click);
+
+    // resources are this frames detections, the route planner is expected to be planned over them already
+    // minimap is this frames minimap reading, traveling heads for its target when there is one
+    void onFrame(const Mat &screenshot, const vector<TemplateMatch> &resources, const MinimapReading &minimap);
+
+    BotStatus getStatus() const;
+
+private:
+    RoutePlanner &routePlanner_;
+    WorldMap &worldMap_;
+    BotControllerSettings settings_;
+    function<void(int, int, bool)> click_;
+
+    BotExecutor executor_;
+    Task mainTask_;
+    BotStatus status_;
+
+    // only valid while onFrame is running
+    Mat screenshot_;
+    const vector<TemplateMatch> *resources_;
+    const MinimapReading *minimap_;
+
+    Task run();
+    Task approach();
+    Task travel();
+
+    void clickNextTarget();
+    Point travelDestination();
+    bool collectionVisible(double &score);
+    void setStatus(BotStatus status);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "BotExecutor.h"
+
+using namespace std;
+
+BotExecutor::Awaiter BotExecutor::nextFrame()
+{
+    return Awaiter{ *this, []() { return true; }, LLONG_MAX };
+}
+
+BotExecutor::Awaiter BotExecutor::sleepFor(long long millis)
+{
+    return Awaiter{ *this, nullptr, now_ + millis };
+}
+
+BotExecutor::Awaiter BotExecutor::waitUntil(function<bool()> condition, long long timeoutMillis)
+{
+    long long deadline = timeoutMillis == LLONG_MAX ? LLONG_MAX : now_ + timeoutMillis;
+    return Awaiter{ *this, move(condition), deadline };
+}
+
+void BotExecutor::onFrame(long long nowMillis)
+{
+    now_ = nowMillis;
+
+    // taking the waiters out first, the resumed tasks add their next wait to the now empty list
+    vector<Waiter> waiting;
+    waiting.swap(waiters_);
+
+    for (int i = 0; i < waiting.size(); i++)
+    {
+        Waiter &waiter = waiting[i];
+
+        // the deadline is checked first, same as the old timers which gave up before looking at the frame
+        if (waiter.deadline != LLONG_MAX && now_ > waiter.deadline)
+        {
+            *waiter.result = false;
+            waiter.handle.resume();
+        }
+        else if (waiter.condition && waiter.condition())
+        {
+            *waiter.result = true;
+            waiter.handle.resume();
+        }
+        else
+        {
+            waiters_.push_back(move(waiter));
+        }
+    }
+}
+
+long long BotExecutor::now() const
+{
+    return now_;
+}
@@ -0,0 +1,110 @@
+#ifndef BOT_EXECUTOR
+#define BOT_EXECUTOR
+
+#include <climits>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+// coroutine that starts suspended and runs when it is started or awaited
+// awaiting it from another task resumes the awaiting task once this one has finished
+class Task {
+public:
+    struct promise_type {
+        coroutine_handle<> continuation;
+
+        Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            coroutine_handle<> await_suspend(coroutine_handle<promise_type> handle) noexcept
+            {
+                coroutine_handle<> continuation = handle.promise().continuation;
+                return continuation ? continuation : noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+
+    Task() = default;
+    explicit Task(coroutine_handle<promise_type> handle) : handle_(handle) {}
+    Task(Task &&other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle_) handle_.destroy();
+            handle_ = other.handle_;
+            other.handle_ = nullptr;
+        }
+        return *this;
+    }
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    void start() { if (handle_ && !handle_.done()) handle_.resume(); }
+    bool done() const { return !handle_ || handle_.done(); }
+
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept
+    {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    void await_resume() const noexcept {}
+
+private:
+    coroutine_handle<promise_type> handle_;
+};
+
+// resumes suspended tasks from the frame loop, a task waits either for a condition checked once per frame,
+// for a point in time or for whichever of the two comes first
+// everything runs on the thread calling onFrame, so the tasks never need any locking
+class BotExecutor {
+public:
+    struct Waiter {
+        coroutine_handle<> handle;
+        function<bool()> condition;     // empty to only wait for the deadline
+        long long deadline;             // millis, LLONG_MAX for no deadline
+        bool *result;                   // set to true if the condition was met, false if the deadline passed
+    };
+
+    struct Awaiter {
+        BotExecutor &executor;
+        function<bool()> condition;
+        long long deadline;
+        bool result = false;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(coroutine_handle<> handle) { executor.waiters_.push_back({ handle, move(condition), deadline, &result }); }
+        bool await_resume() const noexcept { return result; }
+    };
+
+    // the next frame, true once it arrives
+    Awaiter nextFrame();
+    // the first frame more than millis after now, always false since there is no condition to meet
+    Awaiter sleepFor(long long millis);
+    // the first frame where the condition holds, or false once more than timeoutMillis have passed
+    Awaiter waitUntil(function<bool()> condition, long long timeoutMillis = LLONG_MAX);
+
+    // called once per frame by the pipeline, resumes the tasks that are due
+    // tasks that suspend again while being resumed are only looked at on the next frame
+    void onFrame(long long nowMillis);
+
+    long long now() const;
+
+private:
+    vector<Waiter> waiters_;
+    long long now_ = 0;
+};
+
+#endif
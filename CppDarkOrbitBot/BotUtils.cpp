@@ -1,5 +1,6 @@
 ﻿#include "BotUtils.h"
 #include "Constants.h"
+#include "AsyncLogger.h"
 
 #include <opencv2/opencv.hpp>
 #include <string>
@@ -51,6 +52,21 @@ void loadImages(vector<Template> &templates)
             templates[i].grayscale = targetGrayBase;
             templates[i].alpha = targetAlpha;
 
+            // fully opaque templates dont need a mask, opencv matches much faster without one
+            // the others get compressed down to their opaque pixels for the sparse kernel
+            if (countNonZero(targetAlpha < 255) == 0)
+            {
+                templates[i].alpha = Mat();
+            }
+            else if (buildSparseTemplate(targetGrayBase, targetAlpha, templates[i].sparse))
+            {
+                printWithTimestamp("Built sparse template: " + to_string(templates[i].sparse.pixelCount) + " of "
+                    + to_string(targetAlpha.total()) + " pixels opaque", YELLOW_TEXT_BLACK_BACKGROUND);
+            }
+
+            // means and norms for the shared ncc engine, same opaque pixels as the sparse template
+            buildNccTemplate(targetGrayBase, templates[i].alpha, templates[i].ncc);
+
             printWithTimestamp("Loaded image: " + templates[i].name, YELLOW_TEXT_BLACK_BACKGROUND);
         }
     }
@@ -163,20 +179,6 @@ void extractPngNames(vector<Template> &templates)
     }
 }
 
-long long getCurrentMillis() 
-{
-    auto now = std::chrono::system_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
-    return duration.count();
-}
-
-long long getCurrentMicros()
-{
-    auto now = std::chrono::system_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
-    return duration.count();
-}
-
 string millisToTimestamp(long long millis) 
 {
     time_t seconds = millis / 1000;
@@ -192,19 +194,17 @@ string millisToTimestamp(long long millis)
     return oss.str();
 }
 
+// free text goes through the async logger too so it stays in order with the logEvent messages
 void printWithTimestamp(string message)
 {
-    string currentTimestamp = millisToTimestamp(getCurrentMillis());
-    cout << "[" << currentTimestamp << "] " << message << "\n";
+    LogArgument text(new string(move(message)));
+    asyncLogger.log(LOG_TEXT, LOG_NO_STYLE, &text, 1);
 }
 
 void printWithTimestamp(string message, int style)
 {
-    string currentTimestamp = millisToTimestamp(getCurrentMillis());
-    cout << "[" << currentTimestamp << "] ";
-    setConsoleStyle(style);
-    cout << message << "\n";
-    setConsoleStyle(DEFAULT);
+    LogArgument text(new string(move(message)));
+    asyncLogger.log(LOG_TEXT, style, &text, 1);
 }
 
 void printTimeProfiling(long long startMicros, string message)
@@ -230,11 +230,6 @@ void printTimeProfiling(long long startMicros, string message)
     }
 }
 
-long long computeTimePassed(long long start, long long finish)
-{
-    return finish - start;
-}
-
 void computeFrameRate(int loopDuration, float &totalTime, float &totalFrames, string &currentFPSString, string &averageFPSString)
 {
     float currentFPS = 1 / (float(loopDuration) / 1000);
@@ -256,15 +251,6 @@ void computeFrameRate(int loopDuration, float &totalTime, float &totalFrames, st
     averageFPSString = averageFrameRateStream.str();
 }
 
-void clickAt(int x, int y) 
-{
-    SetCursorPos(x, y);
-    mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0, 0);
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-    mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0, 0);
-    printWithTimestamp("Clicked at [" + to_string(x) + ", " + to_string(y) + "]");
-}
-
 string botStatusEnumToString(BotStatus status)
 {
     try 
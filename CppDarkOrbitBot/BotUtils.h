@@ -6,6 +6,11 @@
 #include <string>
 #include <vector>
 
+#include "SparseTemplate.h"
+#include "FixedSizeKernel.h"
+#include "NccEngine.h"
+#include "Timing.h"
+
 using namespace std;
 using namespace cv;
 
@@ -23,7 +28,9 @@ enum TemplateIdentifier {
     PROMETIUM = 2,
     ENDURIUM = 3,
     MINIMAP_ICON = 4,
-    MINIMAP_BUTTONS = 5
+    MINIMAP_BUTTONS = 5,
+    ENDURIUM_VARIANT = 6,
+    TEMPLATE_COUNT = 7
 };
 
 struct Template {
@@ -35,6 +42,9 @@ struct Template {
     bool multipleMatches;
     Mat grayscale;
     Mat alpha;
+    SparseTemplate sparse;
+    FixedSizeKernel fixedSizeKernel = nullptr;
+    NccTemplate ncc;
 };
 
 struct TemplateMatch
@@ -58,15 +68,11 @@ void testConsoleColors();
 void showImages(vector<Mat>& targetGrayImages, string name);
 void extractPngNames(vector<string> pngPaths, vector<string>& targetNames);
 void extractPngNames(vector<Template> &templates);
-long long getCurrentMillis();
-long long getCurrentMicros();
 string millisToTimestamp(long long millis);
 void printWithTimestamp(string message);
 void printWithTimestamp(string message, int style);
 void printTimeProfiling(long long startMicros, string message);
-long long computeTimePassed(long long start, long long finish);
 void computeFrameRate(int loopDuration, float &totalTime, float &totalFrames, string &currentFPSString, string &averageFPSString);
-void clickAt(int x, int y);
 string botStatusEnumToString(BotStatus status);
 double distanceBetweenPoints(Point &a, Point &b);
 double pointToScreenshotCenterDistance(int &x, int &y, int screenWidth, int screenHeight);
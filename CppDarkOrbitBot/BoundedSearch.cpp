@@ -0,0 +1,121 @@
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+
+#include "BoundedSearch.h"
+
+using namespace std;
+using namespace cv;
+
+// the bounds come from square roots of doubles so they get a little slack before a window is rejected on them
+constexpr double BOUND_TOLERANCE = 1e-6;
+
+bool isBoundedSearchSupported(TemplateMatchModes matchMode, const Mat &templateAlpha)
+{
+    return (matchMode == TM_SQDIFF || matchMode == TM_SQDIFF_NORMED) && templateAlpha.empty();
+}
+
+static inline double rectangleSum(const double *top, const double *bottom, int x, int width)
+{
+    return bottom[x + width] - bottom[x] - top[x + width] + top[x];
+}
+
+bool findBestSquaredDifference(const Mat &grayscaleScreenshot, const Mat &templateGrayscale, TemplateMatchModes matchMode,
+    double threshold, double &bestScore, Point &bestLocation)
+{
+    int templateWidth = templateGrayscale.cols;
+    int templateHeight = templateGrayscale.rows;
+    int resultCols = grayscaleScreenshot.cols - templateWidth + 1;
+    int resultRows = grayscaleScreenshot.rows - templateHeight + 1;
+    if (resultCols <= 0 || resultRows <= 0) return false;
+
+    bool normed = matchMode == TM_SQDIFF_NORMED;
+
+    Mat sums, squaredSums;
+    cv::integral(grayscaleScreenshot, sums, squaredSums, CV_32S, CV_64F);
+
+    // norms of every template row, for the per row bound
+    vector<double> templateRowNorms(templateHeight);
+    double templateSquaredSum = 0;
+    for (int r = 0; r < templateHeight; r++)
+    {
+        const uchar *row = templateGrayscale.ptr<uchar>(r);
+        double rowSquaredSum = 0;
+        for (int c = 0; c < templateWidth; c++) rowSquaredSum += double(row[c]) * row[c];
+        templateRowNorms[r] = sqrt(rowSquaredSum);
+        templateSquaredSum += rowSquaredSum;
+    }
+    double templateNorm = sqrt(templateSquaredSum);
+
+    // remainingBounds[r] is the lower bound for the squared difference of rows r and below
+    vector<double> remainingBounds(templateHeight + 1);
+    remainingBounds[templateHeight] = 0;
+
+    // only scores below the threshold count, so the threshold is the score to beat from the start
+    double scoreToBeat = threshold;
+    bool found = false;
+
+    for (int y = 0; y < resultRows; y++)
+    {
+        for (int x = 0; x < resultCols; x++)
+        {
+            double windowSquaredSum = rectangleSum(squaredSums.ptr<double>(y), squaredSums.ptr<double>(y + templateHeight), x, templateWidth);
+
+            // the normed score divides by the energy of both, windows without any energy never match like in opencv
+            double scale = normed ? sqrt(windowSquaredSum * templateSquaredSum) : 1.0;
+            if (scale <= DBL_EPSILON) continue;
+
+            double budget = scoreToBeat * scale;
+
+            // ||window - template||^2 >= (||window|| - ||template||)^2
+            double difference = sqrt(windowSquaredSum) - templateNorm;
+            if (difference * difference > budget + BOUND_TOLERANCE) continue;
+
+            // the same bound per row is tighter since it cant average out differences between rows
+            for (int r = templateHeight - 1; r >= 0; r--)
+            {
+                double rowSquaredSum = rectangleSum(squaredSums.ptr<double>(y + r), squaredSums.ptr<double>(y + r + 1), x, templateWidth);
+                double rowDifference = sqrt(rowSquaredSum) - templateRowNorms[r];
+                remainingBounds[r] = remainingBounds[r + 1] + rowDifference * rowDifference;
+            }
+            if (remainingBounds[0] > budget + BOUND_TOLERANCE) continue;
+
+            // exact sum, abandoned once the rows summed so far plus the bound of the rest are too much
+            long long squaredDifference = 0;
+            bool abandoned = false;
+            for (int r = 0; r < templateHeight; r++)
+            {
+                const uchar *imageRow = grayscaleScreenshot.ptr<uchar>(y + r) + x;
+                const uchar *templateRow = templateGrayscale.ptr<uchar>(r);
+
+                int rowDifference = 0;
+                for (int c = 0; c < templateWidth; c++)
+                {
+                    int d = int(imageRow[c]) - int(templateRow[c]);
+                    rowDifference += d * d;
+                }
+                squaredDifference += rowDifference;
+
+                if (squaredDifference + remainingBounds[r + 1] > budget + BOUND_TOLERANCE)
+                {
+                    abandoned = true;
+                    break;
+                }
+            }
+            if (abandoned) continue;
+
+            double score = squaredDifference / scale;
+            if (score < scoreToBeat)
+            {
+                scoreToBeat = score;
+                bestLocation = Point(x, y);
+                found = true;
+            }
+        }
+    }
+
+    if (found) bestScore = scoreToBeat;
+    return found;
+}
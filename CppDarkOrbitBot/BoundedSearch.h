@@ -0,0 +1,21 @@
+#ifndef BOUNDED_SEARCH
+#define BOUNDED_SEARCH
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+// the bounded search only needs the best position so it never builds a result map
+// it only works for squared difference modes on templates without a mask
+bool isBoundedSearchSupported(TemplateMatchModes matchMode, const Mat &templateAlpha);
+
+// finds the position with the lowest TM_SQDIFF or TM_SQDIFF_NORMED score below the threshold
+// windows are skipped using lower bounds from the integral image of squares (successive elimination),
+// first for the whole window, then summed over the template rows, and the exact sum is abandoned
+// as soon as it together with the bound of the rows left can no longer beat the best score so far
+bool findBestSquaredDifference(const Mat &grayscaleScreenshot, const Mat &templateGrayscale, TemplateMatchModes matchMode,
+    double threshold, double &bestScore, Point &bestLocation);
+
+#endif
@@ -0,0 +1,113 @@
+#include <opencv2/core/types.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "ClickPredictor.h"
+#include "RoutePlanner.h"
+
+using namespace std;
+using namespace cv;
+
+ClickPredictor::ClickPredictor(const ClickPredictorSettings &settings) : settings_(settings)
+{
+    reset();
+}
+
+void ClickPredictor::reset()
+{
+    lastCaptureMicros_ = 0;
+    lastSampleMicros_ = 0;
+    velocity_ = Point2d(0, 0);
+    hasVelocity_ = false;
+    previousDetections_.clear();
+}
+
+// median displacement of the detections that have a single close neighbour on the previous frame
+// the median keeps a resource that appeared or vanished next to another one from skewing the estimate
+bool ClickPredictor::estimateShiftFromDetections(const vector<Point> &current, Point2d &shift) const
+{
+    vector<double> dx, dy;
+    for (const Point &position : current)
+    {
+        int nearest = -1;
+        double nearestDistance = settings_.detectionMatchRadius;
+        for (int i = 0; i < previousDetections_.size(); i++)
+        {
+            double distance = norm(position - previousDetections_[i]);
+            if (distance <= nearestDistance)
+            {
+                nearestDistance = distance;
+                nearest = i;
+            }
+        }
+
+        if (nearest >= 0)
+        {
+            dx.push_back(position.x - previousDetections_[nearest].x);
+            dy.push_back(position.y - previousDetections_[nearest].y);
+        }
+    }
+
+    if (dx.empty()) return false;
+
+    nth_element(dx.begin(), dx.begin() + dx.size() / 2, dx.end());
+    nth_element(dy.begin(), dy.begin() + dy.size() / 2, dy.end());
+    shift = Point2d(dx[dx.size() / 2], dy[dy.size() / 2]);
+    return true;
+}
+
+void ClickPredictor::onFrame(long long captureMicros, bool shiftKnown, Point2d shift, const vector<TemplateMatch> &detections)
+{
+    vector<Point> current;
+    current.reserve(detections.size());
+    for (const TemplateMatch &detection : detections) current.push_back(rectCenter(detection.rect));
+
+    double intervalMillis = lastCaptureMicros_ > 0 ? (captureMicros - lastCaptureMicros_) / 1000.0 : 0.0;
+
+    if (intervalMillis > 0)
+    {
+        Point2d frameShift;
+        bool haveShift = shiftKnown;
+        if (haveShift) frameShift = shift;
+        else haveShift = estimateShiftFromDetections(current, frameShift);
+
+        if (haveShift)
+        {
+            Point2d sample = frameShift * (1.0 / intervalMillis);
+            velocity_ = hasVelocity_ ? velocity_ * (1.0 - settings_.smoothing) + sample * settings_.smoothing : sample;
+            hasVelocity_ = true;
+            lastSampleMicros_ = captureMicros;
+        }
+    }
+
+    // an old velocity would keep pushing the clicks after the ship stopped
+    if (hasVelocity_ && (captureMicros - lastSampleMicros_) / 1000.0 > settings_.maxVelocityAgeMillis)
+    {
+        velocity_ = Point2d(0, 0);
+        hasVelocity_ = false;
+    }
+
+    lastCaptureMicros_ = captureMicros;
+    previousDetections_ = move(current);
+}
+
+Point ClickPredictor::predict(Point position, long long nowMicros) const
+{
+    if (!hasVelocity_ || lastCaptureMicros_ == 0) return position;
+
+    double horizonMillis = (nowMicros - lastCaptureMicros_) / 1000.0 + settings_.actuationDelayMillis;
+    horizonMillis = min(max(horizonMillis, 0.0), settings_.maxExtrapolationMillis);
+
+    Point predicted(cvRound(position.x + velocity_.x * horizonMillis), cvRound(position.y + velocity_.y * horizonMillis));
+    if (settings_.frameSize.area() > 0)
+    {
+        predicted.x = min(max(predicted.x, 0), settings_.frameSize.width - 1);
+        predicted.y = min(max(predicted.y, 0), settings_.frameSize.height - 1);
+    }
+    return predicted;
+}
+
+Point2d ClickPredictor::getVelocity() const
+{
+    return velocity_;
+}
@@ -0,0 +1,49 @@
+#ifndef CLICK_PREDICTOR
+#define CLICK_PREDICTOR
+
+#include <opencv2/core/types.hpp>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+struct ClickPredictorSettings {
+    double actuationDelayMillis = 5.0;        // the input dispatcher holds the button this long, the game reacts on release
+    double maxExtrapolationMillis = 150.0;    // frames older than this are not extrapolated any further
+    double smoothing = 0.5;                   // weight of the newest velocity sample
+    double maxVelocityAgeMillis = 250.0;      // without a new sample for this long the screen is assumed to be still
+    double detectionMatchRadius = 40.0;       // detections further apart than this between two frames arent the same object
+    Size frameSize;                           // predicted clicks are kept inside the frame, empty to not clamp
+};
+
+// moves click targets to where they will be when the click lands instead of where they were when the frame was captured
+// the screen velocity comes from the global motion estimate, or from the detections moving between frames when that is unknown
+class ClickPredictor {
+public:
+    explicit ClickPredictor(const ClickPredictorSettings &settings);
+
+    // once per frame, after matching, with the capture time of the frame the detections were found on
+    void onFrame(long long captureMicros, bool shiftKnown, Point2d shift, const vector<TemplateMatch> &detections);
+
+    // where a target seen at position on the last frame is expected to be once a click started at nowMicros lands
+    Point predict(Point position, long long nowMicros) const;
+
+    Point2d getVelocity() const;    // pixels per millisecond
+    void reset();
+
+private:
+    ClickPredictorSettings settings_;
+
+    long long lastCaptureMicros_;
+    long long lastSampleMicros_;
+    Point2d velocity_;
+    bool hasVelocity_;
+
+    vector<Point> previousDetections_;
+
+    bool estimateShiftFromDetections(const vector<Point> &current, Point2d &shift) const;
+};
+
+#endif
@@ -11,12 +11,29 @@
 #include <sstream>
 #include <algorithm>
 #include <numeric>
-#include <random>
 
 #include "Constants.h"
 #include "BotUtils.h"
 #include "BotCV.h"
 #include "ThreadPool.h"
+#include "RoutePlanner.h"
+#include "TemplateRegistry.h"
+#include "Metrics.h"
+#include "SessionRecorder.h"
+#include "AsyncLogger.h"
+#include "ThresholdSweep.h"
+#include "LoadTest.h"
+#include "MotionEstimator.h"
+#include "BotController.h"
+#include "ClickPredictor.h"
+#include "MinimapAnalyzer.h"
+#include "WorldMap.h"
+#include "InputDispatcher.h"
+#include "Win32InputBackend.h"
+#include "FramePublisher.h"
+#include "FrameViewer.h"
+#include "DetectionFusion.h"
+#include "Autotuner.h"
 
 using namespace std;
 using namespace cv;
@@ -24,12 +41,53 @@ using namespace chrono;
 
 HWND darkOrbitHandle;
 
-int main() 
+int main(int argc, char *argv[]) 
 {
     long long initialisationStart = getCurrentMillis();
 
     initializeConsoleHandle();
 
+    // console output is written by a background thread so a slow terminal doesnt stall the frame loop
+    LoggerSettings loggerSettings;
+    loggerSettings.filePath = "";
+    asyncLogger.start(loggerSettings);
+
+    // offline mode, tunes the template thresholds on saved screenshots instead of running the bot
+    // usage: CppDarkOrbitBot.exe --sweep <screenshot directory> [output csv]
+    if (argc >= 3 && string(argv[1]) == "--sweep")
+    {
+        ThresholdSweepSettings sweepSettings;
+        sweepSettings.screenshotDirectory = argv[2];
+        if (argc >= 4) sweepSettings.outputPath = argv[3];
+
+        int sweepResult = runThresholdSweep(sweepSettings);
+        asyncLogger.stop();
+        return sweepResult;
+    }
+
+    // offline mode, times the resource matching on synthetic frames with more and more objects
+    // usage: CppDarkOrbitBot.exe --loadtest [output csv] [directory to save one labeled frame per density]
+    if (argc >= 2 && string(argv[1]) == "--loadtest")
+    {
+        LoadTestSettings loadTestSettings;
+        if (argc >= 3) loadTestSettings.outputPath = argv[2];
+        if (argc >= 4) loadTestSettings.exportDirectory = argv[3];
+
+        int loadTestResult = runLoadTest(loadTestSettings);
+        asyncLogger.stop();
+        return loadTestResult;
+    }
+
+    // viewer mode, shows the frames and detections a running bot publishes without the bot having to draw them
+    // usage: CppDarkOrbitBot.exe --view, any number of viewers can run next to the bot
+    if (argc >= 2 && string(argv[1]) == "--view")
+    {
+        FrameViewerSettings viewerSettings;
+        int viewerResult = runFrameViewer(viewerSettings);
+        asyncLogger.stop();
+        return viewerResult;
+    }
+
     darkOrbitHandle = FindWindow(NULL, L"DarkOrbit");
 
     if (darkOrbitHandle)
@@ -42,14 +100,8 @@ int main()
         return -1;
     }
 
-    vector<Template> templates = {
-        {"C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\palladium1.png", PALLADIUM, TM_CCOEFF_NORMED, 0.75, true, true, Mat(), Mat()},
-        {"C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\cargo_icon.png", CARGO_ICON, TM_SQDIFF_NORMED, 0.1, false, false, Mat(), Mat()},
-        {"C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\prometium1.png", PROMETIUM, TM_CCOEFF_NORMED, 0.75, true, true, Mat(), Mat()},
-        {"C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\endurium2.png", ENDURIUM, TM_CCOEFF_NORMED, 0.7, true, true, Mat(), Mat()},
-        {"C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\minimap_icon.png", MINIMAP_ICON, TM_SQDIFF_NORMED, 0.1, false, false, Mat(), Mat()},
-        {"C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\minimap_buttons.png", MINIMAP_BUTTONS, TM_SQDIFF_NORMED, 0.1, false, false, Mat(), Mat()}
-    };
+    // the templates are declared in TEMPLATE_REGISTRY, templates[identifier] is checked against the enum at compile time
+    vector<Template> templates = createTemplatesFromRegistry();
 
     int screenshotGridColumns = 4;
     int screenshotGridRows = 3;
@@ -57,42 +109,107 @@ int main()
 
     int threadCount = 15;
 
+    // the grid and the thread count above are only the fallback, the measured ones for this cpu, resolution and templates replace them
+    bool autotuneEnabled = true;
+    AutotuneSettings autotuneSettings;
+
+    // prometheus metrics served on 127.0.0.1
+    bool metricsEnabled = true;
+    int metricsPort = 9464;
+    long long summaryLogIntervalMillis = 10000;     // latency and thread pool summaries
+
+    // matching runs on a grayscale frame converted during the capture, the color frame is only kept for the overlay window
+    // the overlay is drawn and shown by the bot itself, the viewer (--view) shows the published frames at no cost to the bot
+    bool overlayEnabled = false;
+    bool framePublishingEnabled = true;
+    CaptureSettings captureSettings;
+    captureSettings.format = CAPTURE_GRAYSCALE;
+    captureSettings.keepColor = overlayEnabled;
+
+    // session recording for replaying what the bot saw and did, off by default since it writes to disk continuously
+    bool recordingEnabled = false;
+    SessionRecorderSettings recordingSettings;
+    recordingSettings.path = "session_" + to_string(getCurrentMillis()) + ".dobrec";
+
     float totalTime = 0.0f;
     float totalFrames = 0.0f;
     float averageMillis = 0.0f;
     float averageFPS = 0.0f;
 
-    long long collectingTimer;
-    long long movingTimer;
-    long long travellingTimer;
-
     float minimumResourceDistance = 100.0;
+    int routeMaxTargets = 8;
+    double routeSnapRadius = 60.0;
+
+    // while MOVING the previous matches are moved by the estimated camera motion and only checked again around their new position
+    bool motionTrackingEnabled = true;
+    int trackingSearchMargin = 24;
+    int trackingMaxFrames = 10;     // a full scan is forced after this many tracked frames
+
+    // the resource matching has to be done this long after the frame started, the grid cells around the ship are always matched
+    // and the far ones are left for the next frame when there is no time left for them
+    bool frameBudgetEnabled = true;
+    long long frameBudgetMillis = 50;
+    MatchBudget matchBudget;
+    matchBudget.criticalDistance = 250.0;
 
     BotStatus status = BotStatus::SCANNING;
 
     loadImages(templates);
     extractPngNames(templates);
+    if (!verifyTemplateSizes(templates)) return -1;
+
+    vector<Template> resourceTemplates = selectTemplates(templates, RESOURCE_TEMPLATES);
+
+    // matching keeps weaker candidates and the fusion only lets through the ones that keep showing up
+    bool detectionFusionEnabled = true;
+    DetectionFusionSettings fusionSettings;
+    DetectionFusion detectionFusion(resourceTemplates, fusionSettings);
+    if (detectionFusionEnabled) detectionFusion.relaxThresholds(resourceTemplates);
 
-    vector<Template> resourceTemplates;
-    resourceTemplates.emplace_back(templates[PALLADIUM]);
+    // the full scans match on a frame shrunk by this with templates shrunk to fit, the tracking frames stay at full resolution
+    // 2 matches a quarter of the pixels but stays off until it is checked against recorded frames,
+    // the thresholds above are tuned and swept at full resolution only
+    int resourceDecimation = 1;
+    vector<Template> decimatedResourceTemplates;
+    decimateTemplates(resourceTemplates, resourceDecimation, decimatedResourceTemplates);
+    matchBudget.criticalDistance /= resourceDecimation;     // the budget works in the coordinates of the matched frame
 
     // templates - matches
     vector<vector<TemplateMatch>> matchedTemplates(templates.size());
 
+    ScreenshotManager screenshotManager(darkOrbitHandle, captureSettings);
+
+    AutotuneResult autotuneResult;
+    if (autotuneEnabled && autotune(screenshotManager, resourceTemplates, autotuneSettings, autotuneResult))
+    {
+        screenshotGridColumns = autotuneResult.configuration.gridColumns;
+        screenshotGridRows = autotuneResult.configuration.gridRows;
+        screenshotOffset = autotuneResult.configuration.overlap;
+        threadCount = autotuneResult.configuration.threadCount;
+        printWithTimestamp(string(autotuneResult.fromCache ? "Using the tuned configuration from " + autotuneSettings.cachePath : "Tuned the configuration")
+            + ", " + to_string(autotuneResult.frameMillis) + "ms per frame", GREEN_TEXT_BLACK_BACKGROUND);
+    }
+
     printWithTimestamp("Screenshot grid size: " + to_string(screenshotGridColumns) + " columns x " + to_string(screenshotGridRows) + " rows", YELLOW_TEXT_BLACK_BACKGROUND);
     printWithTimestamp("Screenshot offset: " + to_string(screenshotOffset), YELLOW_TEXT_BLACK_BACKGROUND);
 
     ThreadPool threadPool(threadCount);
     printWithTimestamp("Started " + to_string(threadCount) + " worker threads", YELLOW_TEXT_BLACK_BACKGROUND);
 
-    ScreenshotManager screenshotManager(darkOrbitHandle);
+    BotMetrics metrics;
+    MetricsServer metricsServer(metrics, metricsPort);
+    if (metricsEnabled) metricsServer.start();
+
+    SessionRecorder sessionRecorder(recordingSettings);
+    if (recordingEnabled) sessionRecorder.start();
+
+    FramePublisher framePublisher;
+    if (framePublishingEnabled) framePublisher.open();
 
     // finding the location and size of the minimap
 
     // grabbing the templates for the minimap
-    vector<Template> minimapTemplates;
-    minimapTemplates.emplace_back(templates[MINIMAP_ICON]);
-    minimapTemplates.emplace_back(templates[MINIMAP_BUTTONS]);
+    vector<Template> minimapTemplates = selectTemplates(templates, MINIMAP_TEMPLATES);
     // taking screenshot
     Mat screenshotForMinimap = screenshotManager.capture();
     vector<vector<Mat>> dividedScreenshotForMinimap = divideImage(screenshotForMinimap, screenshotGridColumns, screenshotGridRows, screenshotOffset);
@@ -112,18 +229,88 @@ int main()
         + "] with size " + to_string(minimapRect.width) + "x" + to_string(minimapRect.height),
         YELLOW_TEXT_BLACK_BACKGROUND);
 
+    RoutePlanner routePlanner(screenshotForMinimap.cols, screenshotForMinimap.rows, routeMaxTargets, minimumResourceDistance);
+
+    // the minimap and the ship stay in place while the background scrolls
+    MotionEstimatorSettings motionSettings;
+    motionSettings.staticRegions = { minimapRect, Rect(screenshotForMinimap.cols / 2 - 100, screenshotForMinimap.rows / 2 - 100, 200, 200) };
+    MotionEstimator motionEstimator(motionSettings);
+    vector<vector<TemplateMatch>> previousMatchedTemplates(templates.size());
+    int trackedFrames = 0;
+
+    // the minimap is also captured in color, its dots show resources that are not on screen yet
+    screenshotManager.setColorRegion(minimapRect);
+
+    WorldMapSettings worldMapSettings;
+
+    // the map name and the buttons sit in the header rows, down to the bottom of the lower of the two templates
+    MinimapAnalyzerSettings minimapSettings;
+    minimapSettings.headerHeight = max(minimapMatchedTemplates[0][0].rect.br().y, minimapMatchedTemplates[1][0].rect.br().y) - minimapRect.y;
+    minimapSettings.viewportSize = Size2d(screenshotForMinimap.cols / worldMapSettings.screenPixelsPerMinimapPixel,
+        screenshotForMinimap.rows / worldMapSettings.screenPixelsPerMinimapPixel);
+    MinimapAnalyzer minimapAnalyzer(minimapSettings);
+
+    // what was seen where, kept after it scrolls off screen so traveling goes to areas that werent cleared yet
+    // only the part of the minimap below the header is mapped, traveling to a header cell would click its buttons
+    WorldMap worldMap(minimapAnalyzer.innerRect(minimapRect.size()), worldMapSettings);
+
+    BotControllerSettings controllerSettings;
+    controllerSettings.collectionTemplate = templates[PALLADIUM];
+    controllerSettings.routeSnapRadius = routeSnapRadius;
+    controllerSettings.minimapRect = minimapRect;
+    // the ship keeps flying between the capture and the click, clicks on world objects are moved to where they will be
+    ClickPredictorSettings clickPredictorSettings;
+    clickPredictorSettings.frameSize = screenshotForMinimap.size();
+    ClickPredictor clickPredictor(clickPredictorSettings);
+
+    // capture time of the frame being worked on, every decision and click of the frame is measured from it
+    long long frameCaptureMicros = 0;
+    long long lastSummaryLogMillis = getCurrentMillis();
+    ThreadPoolStats lastSummaryPoolStats = threadPool.getStats();
+
+    // clicks are sent on their own thread, the main loop goes on with the next frame while the button is held
+    Win32InputBackend inputBackend;
+    InputDispatcherSettings inputSettings;
+    InputDispatcher inputDispatcher(inputBackend, inputSettings);
+    inputDispatcher.setDeliveredCallback([&metrics, &sessionRecorder](const InputCommand &command, long long deliveredMicros)
+        {
+            if (command.type != INPUT_CLICK) return;
+
+            // delivered once the button is released, which is when the game acts on the click
+            // a click dropped from a full queue never gets here, so the recording only has the clicks the game got
+            logEvent(LOG_CLICKED_AT, command.x, command.y);
+            sessionRecorder.recordClick(command.x, command.y);
+            if (command.captureMicros == 0) return;
+            long long clickLatency = computeTimePassed(command.captureMicros, deliveredMicros);
+            metrics.recordCaptureToClick(clickLatency);
+            logEvent(LOG_CLICK_LATENCY, clickLatency, computeTimePassed(command.enqueuedMicros, deliveredMicros));
+        });
+    inputDispatcher.start();
+
+    BotController botController(routePlanner, worldMap, controllerSettings,
+        [&clickPredictor, &inputDispatcher, &frameCaptureMicros](int x, int y, bool worldTarget)
+        {
+            Point target(x, y);
+            if (worldTarget) target = clickPredictor.predict(target, getCurrentMicros());
+            inputDispatcher.click(target.x, target.y, frameCaptureMicros);
+        });
+
     vector<string> timeProfilerSteps = {
         "Clearing previous frames",
         "Taking screenshot",
+        "Motion estimation",
+        "Minimap analysis",
         "Dividing screenshot",
         "Template matching",
-        "Closest resource loop",
+        "Route planning",
         "Closest match drawing",
         "Drawing matches",
         "Bot decision logic"
     };
     vector<long long> timeProfilerTotalTimes(timeProfilerSteps.size(), 0);
     vector<float> timeProfilerAverageTimes(timeProfilerSteps.size(), 0);
+    vector<long long> timeProfilerFrameStartTotals(timeProfilerSteps.size(), 0);
+    vector<long long> timeProfilerFrameTimes(timeProfilerSteps.size(), 0);
 
     long long initialisationDuration = computeTimePassed(initialisationStart, getCurrentMillis());
     printWithTimestamp("Bot initialisation took " + to_string(initialisationDuration) + "ms", GREEN_TEXT_BLACK_BACKGROUND);
@@ -136,8 +323,10 @@ int main()
     {
         // keep track of when the loop starts
         long long frameStart = getCurrentMillis();
+        steady_clock::time_point frameDeadline = steady_clock::now() + milliseconds(frameBudgetMillis);
         long long timeProfilerAux;
         int profilingStep = 0;
+        timeProfilerFrameStartTotals = timeProfilerTotalTimes;
 
 
         // clearing previous frame's matches
@@ -149,51 +338,103 @@ int main()
 
         // capturing screenshot
         timeProfilerAux = getCurrentMicros();
-        Mat screenshot = screenshotManager.capture();
+        Mat overlay;
+        Mat screenshot = screenshotManager.capture(overlay);
+        frameCaptureMicros = screenshotManager.getLastCaptureMicros();
+        sessionRecorder.recordFrame(overlayEnabled ? overlay : screenshot);
         timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
         profilingStep++;
 
 
-        // dividing screenshot
+        // estimating how far the background scrolled since the previous frame
         timeProfilerAux = getCurrentMicros();
-        vector<vector<Mat>> dividedScreenshot = divideImage(screenshot, screenshotGridColumns, screenshotGridRows, screenshotOffset);
+        Point2d cameraShift;
+        bool cameraShiftKnown = motionTrackingEnabled && motionEstimator.update(screenshot, cameraShift);
+        bool trackingFrame = status == MOVING && cameraShiftKnown && trackedFrames < trackingMaxFrames;
         timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
         profilingStep++;
 
 
-        // resource template matching
+        // reading the ship and the resource dots from the minimap
         timeProfilerAux = getCurrentMicros();
-        matchTemplatesParallel(screenshot, screenshotOffset, dividedScreenshot, resourceTemplates, threadPool, matchedTemplates);
+        MinimapReading minimapReading;
+        minimapAnalyzer.analyze(screenshotManager.getColorRegion(), minimapReading);
         timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
         profilingStep++;
 
 
-        // figuring out which match is closest
+        // dividing screenshot, the decimated copy of it when the resources are matched on one
         timeProfilerAux = getCurrentMicros();
-        TemplateMatch closestResource = TemplateMatch(Rect(), -1, NO_TEMPLATE);
-        double closestResourceDistance = screenshot.cols;
-        int closestResourceIndex = -1;
-        for (int i = 0; i < matchedTemplates[0].size(); i++)
+        Mat resourceFrame = screenshot;
+        vector<vector<Mat>> dividedScreenshot;
+        if (!trackingFrame)
         {
-            // this returns distance between the point and the center of the screenshot where the ship is
-            double distance = pointToScreenshotCenterDistance(matchedTemplates[0][i].rect.x, matchedTemplates[0][i].rect.y, screenshot.cols, screenshot.rows);
-            if (distance < closestResourceDistance && distance > minimumResourceDistance)
+            if (resourceDecimation > 1)
             {
-                closestResource.rect = matchedTemplates[0][i].rect;
-                closestResource.confidence = matchedTemplates[0][i].confidence;
-                closestResourceDistance = distance;
-                closestResourceIndex = i;
+                resourceFrame = Mat();
+                resize(screenshot, resourceFrame, Size(screenshot.cols / resourceDecimation, screenshot.rows / resourceDecimation), 0, 0, INTER_AREA);
             }
+            dividedScreenshot = divideImage(resourceFrame, screenshotGridColumns, screenshotGridRows, screenshotOffset / resourceDecimation);
         }
         timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
         profilingStep++;
 
-        if (closestResourceIndex == -1 && matchedTemplates[0].size() == 1)
+
+        // resource template matching, or only following the previous matches while moving
+        timeProfilerAux = getCurrentMicros();
+        vector<vector<Rect>> unmatchedRegions;
+        if (trackingFrame)
         {
-            closestResource.rect = matchedTemplates[0][0].rect;
-            closestResource.confidence = matchedTemplates[0][0].confidence;
-            closestResourceIndex = 0;
+            trackDetections(screenshot, previousMatchedTemplates, cameraShift, resourceTemplates, trackingSearchMargin, matchedTemplates);
+            trackedFrames++;
         }
+        else
+        {
+            matchBudget.deadline = frameDeadline;
+            matchBudget.ship = Point(resourceFrame.cols / 2, resourceFrame.rows / 2);
+            matchTemplatesParallel(resourceFrame, screenshotOffset / resourceDecimation, dividedScreenshot, decimatedResourceTemplates, threadPool,
+                matchedTemplates, frameBudgetEnabled ? &matchBudget : nullptr);
+            upscaleMatches(matchedTemplates, resourceTemplates, resourceDecimation);
+            trackedFrames = 0;
+
+            // the cells the budget left out werent looked at, the fusion holds what it had there
+            if (frameBudgetEnabled) unmatchedRegions = matchBudget.skippedRegions;
+            for (vector<Rect> &regions : unmatchedRegions)
+            {
+                for (Rect &region : regions)
+                {
+                    region = Rect(region.x * resourceDecimation, region.y * resourceDecimation, region.width * resourceDecimation, region.height * resourceDecimation);
+                }
+            }
+        }
+        if (detectionFusionEnabled) detectionFusion.update(cameraShiftKnown ? cameraShift : Point2d(0, 0), matchedTemplates, unmatchedRegions);
+        previousMatchedTemplates = matchedTemplates;
+        clickPredictor.onFrame(frameCaptureMicros, cameraShiftKnown, cameraShift, matchedTemplates[PALLADIUM]);
+        timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
+        profilingStep++;
+
+        for (int i = 0; i < resourceTemplates.size(); i++) metrics.recordDetections(resourceTemplates[i].name, matchedTemplates[i].size());
+        sessionRecorder.recordDetections(matchedTemplates[PALLADIUM]);
+        framePublisher.publish(overlayEnabled ? overlay : screenshot, frameCaptureMicros, status, matchedTemplates);
+        if (minimapReading.shipFound) worldMap.observe(getCurrentMillis(), minimapReading.ship, screenshot.size(), matchedTemplates[PALLADIUM]);
+
+
+        // planning the collection route over all the detected resources
+        // the route is only replanned while looking for a target, during MOVING and COLLECTING the planned one is kept
+        timeProfilerAux = getCurrentMicros();
+        TemplateMatch closestResource = TemplateMatch(Rect(), -1, NO_TEMPLATE);
+        int closestResourceIndex = -1;
+        if (status == SCANNING || status == TRAVELING)
+        {
+            routePlanner.plan(matchedTemplates[PALLADIUM]);
+            if (routePlanner.hasNext())
+            {
+                closestResource = routePlanner.peekNext();
+                closestResourceIndex = routePlanner.nextDetectionIndex();
+            }
+        }
+        timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
+        profilingStep++;
 
 
         // closest match drawing
@@ -203,14 +444,24 @@ int main()
             // removing the closest match from the vector so that it wont get drawn like the other matches
             matchedTemplates[PALLADIUM].erase(matchedTemplates[0].begin() + closestResourceIndex);
 
-            // drawing closest resource separately to use a different color
-            drawSingleTarget(screenshot, closestResource, templates[0].name, Scalar(255, 255, 255));
+            if (overlayEnabled)
+            {
+                // drawing closest resource separately to use a different color
+                drawSingleTarget(overlay, closestResource, templates[0].name, Scalar(255, 255, 255));
+
+                // draw a line between the ship and the closest resource found
+                line(overlay, 
+                    Point(closestResource.rect.x + closestResource.rect.width / 2, closestResource.rect.y + closestResource.rect.height / 2), 
+                    Point(overlay.cols / 2, overlay.rows / 2), 
+                    Scalar(255, 255, 255), 1, LINE_4, 0);
+            }
+        }
 
-            // draw a line between the ship and the closest resource found
-            line(screenshot, 
-                Point(closestResource.rect.x + closestResource.rect.width / 2, closestResource.rect.y + closestResource.rect.height / 2), 
-                Point(screenshot.cols / 2, screenshot.rows / 2), 
-                Scalar(255, 255, 255), 1, LINE_4, 0);
+        // drawing the rest of the planned route
+        const vector<TemplateMatch> &plannedRoute = routePlanner.route();
+        for (int i = 1; i < plannedRoute.size() && overlayEnabled; i++)
+        {
+            line(overlay, rectCenter(plannedRoute[i - 1].rect), rectCenter(plannedRoute[i].rect), Scalar(255, 120, 0), 1, LINE_4, 0);
         }
         timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
         profilingStep++;
@@ -218,14 +469,46 @@ int main()
 
         // drawing matches
         timeProfilerAux = getCurrentMicros();
-        for (int i = 0; i < templates.size(); i++) 
-            drawMultipleTargets(screenshot, matchedTemplates[i], templates[i].name);
+        if (overlayEnabled)
+        {
+            for (int i = 0; i < templates.size(); i++) 
+                drawMultipleTargets(overlay, matchedTemplates[i], templates[i].name);
+
+            // confirmed tracks in the cells the frame budget skipped, kept but never handed to the route or the clicks
+            if (detectionFusionEnabled)
+            {
+                for (int i = 0; i < resourceTemplates.size(); i++)
+                {
+                    for (const DetectionTrack &track : detectionFusion.getTracks(i))
+                    {
+                        if (track.confirmed && track.held) rectangle(overlay, track.match.rect, Scalar(128, 128, 128), 1);
+                    }
+                }
+            }
+
+            // drawing minimap rect and what was read from it
+            drawSingleTarget(overlay, minimapRect, "Minimap", Scalar(0, 255, 0));
+            for (const Point2d &dot : minimapReading.dots) circle(overlay, minimapRect.tl() + Point(dot), 3, Scalar(255, 120, 0), 1);
+            if (minimapReading.shipFound) circle(overlay, minimapRect.tl() + Point(minimapReading.ship), 3, Scalar(0, 255, 0), FILLED);
+            if (minimapReading.targetFound) circle(overlay, minimapRect.tl() + Point(minimapReading.target), 5, Scalar(255, 255, 255), 1);
+
+            // coverage heatmap blended over the minimap, bright where it is worth going back to
+            Mat heatmap;
+            worldMap.renderHeatmap(getCurrentMillis(), heatmap);
+            Rect mapArea = worldMap.getArea();
+            Rect heatmapRect = Rect(minimapRect.tl() + mapArea.tl(), mapArea.size()) & Rect(0, 0, overlay.cols, overlay.rows);
+            if (heatmapRect.area() > 0)
+            {
+                // cells are cellSize pixels, the ones cut off by the border stick out past the area
+                Mat scaledHeatmap;
+                resize(heatmap, scaledHeatmap, Size(heatmap.cols * worldMapSettings.cellSize, heatmap.rows * worldMapSettings.cellSize), 0, 0, INTER_NEAREST);
+                Mat minimapOverlay = overlay(heatmapRect);
+                addWeighted(minimapOverlay, 0.7, scaledHeatmap(Rect(0, 0, heatmapRect.width, heatmapRect.height)), 0.3, 0, minimapOverlay);
+            }
+        }
         timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
         profilingStep++;
 
-        // drawing minimap rect
-        drawSingleTarget(screenshot, minimapRect, "Minimap", Scalar(0, 255, 0));
-
 
         // bot logic on-off toggle
         if (GetAsyncKeyState(0x70) & 0x8000) // 0x54 is the virtual key code for 'F1'
@@ -234,10 +517,7 @@ int main()
             {
                 botON = !botON;
                 toggleKeyPressed = true;
-                string msg = "Bot turned ";
-                if (botON) msg = msg + "ON";
-                else msg = msg + "OFF";
-                printWithTimestamp(msg);
+                logEvent(LOG_BOT_TOGGLED, botON);
             }
         } 
         else 
@@ -245,91 +525,28 @@ int main()
             toggleKeyPressed = false;
         }
 
-        // bot decision logic
+        // bot decision logic, the controller resumes whichever behaviour is waiting on this frame
         timeProfilerAux = getCurrentMicros();
+        BotStatus previousStatus = status;
         if (botON)
         {
-            // if the bot is ready to collect and a closest resource has been found
-            if ((status == SCANNING || status == TRAVELING) && closestResource.rect.width != 0)
-            {
-                clickAt(closestResource.rect.x + closestResource.rect.width / 2, closestResource.rect.y + closestResource.rect.height / 2);
-                status = MOVING;
-                movingTimer = getCurrentMillis();
-
-                printWithTimestamp("BOT_STATUS: MOVING");
-
-            }
-            else if (status == MOVING) 
-            {
-                // if 4 seconds of moving havent passed yet
-                if (computeTimePassed(movingTimer, getCurrentMillis()) > 2500)
-                {
-                    status = SCANNING;
-                    printWithTimestamp("Fallback to scanning after 4s passed", YELLOW_TEXT_BLACK_BACKGROUND);
-                }
-                // if 4 seconds have passed we are probably stuck so we go back to scanning
-                else 
-                {
-                    Mat screenshotROI = screenshot(Rect(935, 615, 50, 50));
-                    imshow("test", screenshotROI);
-                    double score;
-                    Rect rectangle;
-                    bool matchFound = matchTemplateWithHighestScore(screenshotROI,
-                        templates[PALLADIUM].grayscale, templates[PALLADIUM].alpha, templates[PALLADIUM].name, templates[PALLADIUM].matchingMode,
-                        0.5, score, rectangle);
-
-                    if (matchFound)
-                    {
-                        status = COLLECTING;
-                        printWithTimestamp("Found collecting match with score: " + to_string(score));
-                        printWithTimestamp("BOT_STATUS: COLLECTING");
-                        collectingTimer = getCurrentMillis();
-                    }
-                }
-
-                
-            }
-            else if (status == COLLECTING)
-            {
-                if (computeTimePassed(collectingTimer, getCurrentMillis()) > 50)
-                {
-                    status = SCANNING;
-                    printWithTimestamp("Collected resource");
-                    printWithTimestamp("BOT_STATUS: SCANNING");
-                }
-            }
-            // if we are scanning but no matches have been found
-            else if (status == SCANNING && matchedTemplates[0].size() == 0)
-            {
-                printWithTimestamp("Cannot find any resources, changing location");
-                status = TRAVELING;
-                printWithTimestamp("BOT_STATUS: TRAVELLING");
-                travellingTimer = getCurrentMillis();
-                Point topLeft = Point(minimapRect.x + minimapRect.width / 3.13, minimapRect.y + minimapRect.height / 1.42);
-                Point bottomRight = Point(minimapRect.x + minimapRect.width / 1.32, minimapRect.y + minimapRect.height / 1.07);
-
-                // generating a random location inside the palladium field
-                random_device rd;
-                mt19937 gen(rd());
-                uniform_int_distribution<int> rdX(topLeft.x, bottomRight.x);
-                uniform_int_distribution<int> rdY(topLeft.y, bottomRight.y);
-                //clickAt(rdX(gen), rdY(gen));
-                clickAt(bottomRight.x -12, rdY(gen));
-            }
-            else if (status == TRAVELING)
-            {
-                if (computeTimePassed(travellingTimer, getCurrentMillis()) > 10000)
-                {
-                    status = SCANNING;
-                    printWithTimestamp("Travelling for too long...", YELLOW_TEXT_BLACK_BACKGROUND);
-                    printWithTimestamp("BOT_STATUS: SCANNING");
-                }
-            }
+            botController.onFrame(screenshot, matchedTemplates[PALLADIUM], minimapReading);
+            status = botController.getStatus();
+            metrics.recordCaptureToDecision(computeTimePassed(frameCaptureMicros, getCurrentMicros()));
         }
 
         timeProfilerTotalTimes[profilingStep] += computeTimePassed(timeProfilerAux, getCurrentMicros());
         profilingStep++;
 
+        if (status != previousStatus)
+        {
+            metrics.recordStatusTransition(previousStatus, status);
+            sessionRecorder.recordStatus(previousStatus, status);
+
+            // the matches tracked so far belong to what the bot was doing before, the next frame scans the whole screen again
+            trackedFrames = trackingMaxFrames;
+        }
+
 
 
         // keeping track of when the loop ends, to calculate how long the loop took and fps
@@ -337,36 +554,91 @@ int main()
         string frameRate;
         string averageFrameRate;
         computeFrameRate(frameDuration, totalTime, totalFrames, frameRate, averageFrameRate);
-        
 
-        // drawing debug information
-        cv::putText(screenshot, frameRate, cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
-        cv::putText(screenshot, averageFrameRate, cv::Point(10, 70), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
-        cv::putText(screenshot, "BOT_STATUS: " + botStatusEnumToString(status), cv::Point(800, 1040), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0, 255, 0), 2);
+        // publishing this frame to the metrics endpoint
+        for (int i = 0; i < timeProfilerSteps.size(); i++) timeProfilerFrameTimes[i] = timeProfilerTotalTimes[i] - timeProfilerFrameStartTotals[i];
+        metrics.recordFrame(frameDuration);
+        metrics.recordStageLatencies(timeProfilerSteps, timeProfilerFrameTimes);
+        metrics.recordStatus(status, frameDuration);
+        metrics.recordWorkerUsage(threadPool.getBusyMicros(), threadPool.getThreadCount());
+        ThreadPoolStats poolStats = threadPool.getStats();
+        metrics.recordThreadPool(poolStats);
+
+        // the per step averages hide the time frames spend waiting, the reaction latency is what the bot is judged by
+        // the percentiles sort a copy of the whole sample window so they are only computed where they are shown
+        if (computeTimePassed(lastSummaryLogMillis, getCurrentMillis()) >= summaryLogIntervalMillis)
+        {
+            LatencySummary decisionLatency = metrics.getCaptureToDecision();
+            LatencySummary clickLatency = metrics.getCaptureToClick();
+            if (decisionLatency.samples > 0)
+            {
+                logEvent(LOG_LATENCY_SUMMARY, decisionLatency.p50Micros, decisionLatency.p95Micros, clickLatency.p50Micros, clickLatency.p95Micros);
+            }
+
+            // how the pool did since the previous summary, to size the pool and the tile grid from
+            ThreadPoolStats interval = poolStats.since(lastSummaryPoolStats);
+            long long busy = 0;
+            long long idle = 0;
+            for (int i = 0; i < interval.workerBusyMicros.size(); i++)
+            {
+                busy += interval.workerBusyMicros[i];
+                idle += interval.workerIdleMicros[i];
+            }
+            double utilization = busy + idle > 0 ? double(busy) / (busy + idle) : 0.0;
+            logEvent(LOG_THREAD_POOL_TIMES, (long long)interval.taskCount(), ThreadPoolStats::percentileMicros(interval.queueWaitBuckets, 0.95),
+                ThreadPoolStats::percentileMicros(interval.runTimeBuckets, 0.95), utilization);
+            logEvent(LOG_THREAD_POOL_QUEUE, interval.averageQueueDepth(), (long long)interval.maxQueueDepth, (long long)interval.contendedLocks,
+                (long long)interval.callerChunks);
+            if (interval.missedDeadlines > 0)
+            {
+                logEvent(LOG_FRAME_BUDGET, (long long)interval.missedDeadlines, (long long)interval.skippedIndexes);
+            }
+
+            lastSummaryPoolStats = poolStats;
+            lastSummaryLogMillis = getCurrentMillis();
+        }
+        
 
-        for (int i = 0; i < timeProfilerSteps.size(); i++)
+        // the overlay window with the debug information
+        if (overlayEnabled)
         {
-            stringstream str;
-            str << fixed << setprecision(4);
-            timeProfilerAverageTimes[i] = timeProfilerTotalTimes[i] / totalFrames / 1000;
+            cv::putText(overlay, frameRate, cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
+            cv::putText(overlay, averageFrameRate, cv::Point(10, 70), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
+            cv::putText(overlay, "BOT_STATUS: " + botStatusEnumToString(status), cv::Point(800, 1040), cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0, 255, 0), 2);
+
+            LatencySummary decisionLatency = metrics.getCaptureToDecision();
+            LatencySummary clickLatency = metrics.getCaptureToClick();
+            stringstream latencyText;
+            latencyText << fixed << setprecision(2) << "capture to decision p50 " << decisionLatency.p50Micros / 1000.0 << "ms p95 "
+                << decisionLatency.p95Micros / 1000.0 << "ms, capture to click p50 " << clickLatency.p50Micros / 1000.0 << "ms p95 "
+                << clickLatency.p95Micros / 1000.0 << "ms";
+            cv::putText(overlay, latencyText.str(), cv::Point(10, 770), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 255), 1);
+
+            for (int i = 0; i < timeProfilerSteps.size(); i++)
+            {
+                stringstream str;
+                str << fixed << setprecision(4);
+                timeProfilerAverageTimes[i] = timeProfilerTotalTimes[i] / totalFrames / 1000;
 
-            str << timeProfilerAverageTimes[i];
+                str << timeProfilerAverageTimes[i];
 
-            // spacing based on how many digits the avg time has
-            if (int(timeProfilerAverageTimes[i]) % 10 > 0) str << " ";
-            else str << "  ";
+                // spacing based on how many digits the avg time has
+                if (int(timeProfilerAverageTimes[i]) % 10 > 0) str << " ";
+                else str << "  ";
 
-            str << "ms - " << timeProfilerSteps[i];
+                str << "ms - " << timeProfilerSteps[i];
 
-            cv::putText(screenshot, str.str(), cv::Point(10, 800 + i * 20), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 1);
-        }
+                cv::putText(overlay, str.str(), cv::Point(10, 800 + i * 20), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 1);
+            }
 
-        // showing the frame at the end
-        cv::imshow("CppDarkOrbitBotView", screenshot);
-        int key = cv::waitKey(10);
+            // showing the frame at the end
+            cv::imshow("CppDarkOrbitBotView", overlay);
+            int key = cv::waitKey(10);
+        }
     }
 
     cv::destroyAllWindows();
+    asyncLogger.stop();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include <opencv2/core/types.hpp>
+#include <algorithm>
+#include <numeric>
+
+#include "DetectionFusion.h"
+#include "RoutePlanner.h"
+
+using namespace std;
+using namespace cv;
+
+DetectionFusion::DetectionFusion(const vector<Template> &templates, const DetectionFusionSettings &settings) : settings_(settings)
+{
+    for (const Template &t : templates) thresholds_.push_back(t.confidenceThreshold);
+    tracks_.resize(templates.size());
+}
+
+void DetectionFusion::relaxThresholds(vector<Template> &templates) const
+{
+    for (int i = 0; i < templates.size() && i < thresholds_.size(); i++)
+    {
+        templates[i].confidenceThreshold = thresholds_[i] - settings_.thresholdMargin;
+    }
+}
+
+double DetectionFusion::evidenceOf(double confidence, int templateIndex) const
+{
+    double relaxed = thresholds_[templateIndex] - settings_.thresholdMargin;
+    return max(0.0, (confidence - relaxed) / settings_.thresholdMargin);
+}
+
+void DetectionFusion::update(Point2d shift, vector<vector<TemplateMatch>> &matches, const vector<vector<Rect>> &unmatchedRegions)
+{
+    Point offset(cvRound(shift.x), cvRound(shift.y));
+
+    for (int i = 0; i < matches.size() && i < tracks_.size(); i++)
+    {
+        vector<DetectionTrack> &tracks = tracks_[i];
+        vector<TemplateMatch> &candidates = matches[i];
+
+        // the tracks are moved to where the camera motion says they are now, then every one that was looked for decays
+        // a track in a region the frame budget skipped wasnt missed, it keeps its evidence until its region is matched again
+        for (DetectionTrack &track : tracks)
+        {
+            track.match.rect = track.match.rect + offset;
+            track.seen = false;
+            track.held = false;
+
+            Point center = rectCenter(track.match.rect);
+            if (i < unmatchedRegions.size())
+            {
+                for (const Rect &region : unmatchedRegions[i])
+                {
+                    if (region.contains(center)) track.held = true;
+                }
+            }
+            if (!track.held) track.evidence *= settings_.decay;
+        }
+
+        // strongest candidates first, each one goes to the closest track that wasnt matched yet on this frame
+        vector<int> order(candidates.size());
+        iota(order.begin(), order.end(), 0);
+        sort(order.begin(), order.end(), [&candidates](int a, int b) { return candidates[a].confidence > candidates[b].confidence; });
+
+        vector<bool> matched(tracks.size(), false);
+        for (int candidateIndex : order)
+        {
+            const TemplateMatch &candidate = candidates[candidateIndex];
+            Point center = rectCenter(candidate.rect);
+            double radius = settings_.matchRadiusFactor * max(candidate.rect.width, candidate.rect.height);
+
+            int nearest = -1;
+            double nearestDistance = radius;
+            for (int t = 0; t < tracks.size(); t++)
+            {
+                if (matched[t]) continue;
+
+                double distance = norm(center - rectCenter(tracks[t].match.rect));
+                if (distance <= nearestDistance)
+                {
+                    nearestDistance = distance;
+                    nearest = t;
+                }
+            }
+
+            double evidence = evidenceOf(candidate.confidence, i);
+            if (nearest >= 0)
+            {
+                tracks[nearest].match = candidate;
+                tracks[nearest].evidence = min(settings_.maxEvidence, tracks[nearest].evidence + evidence);
+                tracks[nearest].seen = true;
+                tracks[nearest].held = false;
+                tracks[nearest].hits++;
+                matched[nearest] = true;
+            }
+            else
+            {
+                tracks.push_back(DetectionTrack{ candidate, min(settings_.maxEvidence, evidence), false, true, false, 1 });
+                matched.push_back(true);
+            }
+        }
+
+        // hysteresis, confirming needs the full evidence while staying confirmed only needs part of it
+        // the epsilon keeps a match exactly at the template threshold confirming on its own despite the rounding
+        for (DetectionTrack &track : tracks)
+        {
+            if (track.evidence >= settings_.confirmEvidence - 1e-9) track.confirmed = true;
+            else if (track.evidence < settings_.holdEvidence) track.confirmed = false;
+        }
+
+        tracks.erase(remove_if(tracks.begin(), tracks.end(), [this](const DetectionTrack &track) { return track.evidence < settings_.dropEvidence; }),
+            tracks.end());
+
+        candidates.clear();
+        for (const DetectionTrack &track : tracks)
+        {
+            if (track.confirmed && track.seen) candidates.push_back(track.match);
+        }
+    }
+}
+
+const vector<DetectionTrack> &DetectionFusion::getTracks(int templateIndex) const
+{
+    return tracks_[templateIndex];
+}
+
+void DetectionFusion::reset()
+{
+    for (vector<DetectionTrack> &tracks : tracks_) tracks.clear();
+}
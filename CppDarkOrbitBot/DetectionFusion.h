@@ -0,0 +1,61 @@
+#ifndef DETECTION_FUSION
+#define DETECTION_FUSION
+
+#include <opencv2/core/types.hpp>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+// evidence is counted in units of one match exactly at the template threshold
+// a match at the relaxed threshold adds nothing, one at the template threshold adds 1 and better ones more
+struct DetectionFusionSettings {
+    double thresholdMargin = 0.1;       // the matching threshold is lowered by this, weaker matches only count once they repeat
+    double decay = 0.6;                 // evidence kept from one frame to the next
+    double confirmEvidence = 1.0;       // a single match at the template threshold is enough, like without fusion
+    double holdEvidence = 0.5;          // confirmed tracks stay confirmed above this, so a weak match after one missed frame still shows them
+    double dropEvidence = 0.05;         // tracks below this are forgotten
+    double maxEvidence = 1.0;           // no more than one full match, a track that stopped matching falls below the hold level after two frames
+    double matchRadiusFactor = 0.5;     // a match belongs to a track when its center is within this many template sizes
+};
+
+struct DetectionTrack {
+    TemplateMatch match;    // the latest match, moved by the camera motion on frames without one
+    double evidence;
+    bool confirmed;
+    bool seen;              // matched on the latest frame, only these are handed out as detections
+    bool held;              // in a region left unmatched on the latest frame, keeps its evidence but is only shown on the overlay
+    int hits;
+};
+
+// accumulates the evidence for every detection over the frames instead of judging every frame on its own
+// so the matching can keep weaker candidates without them flickering in and out
+class DetectionFusion {
+public:
+    // templates are the matched ones in the order their matches come in, their thresholds are the confirmation level
+    DetectionFusion(const vector<Template> &templates, const DetectionFusionSettings &settings);
+
+    // lowers the thresholds of the templates by the margin, matching has to keep the weaker candidates for the fusion to see them
+    void relaxThresholds(vector<Template> &templates) const;
+
+    // matches[i] holds the candidates of template i for this frame and is replaced by the confirmed tracks matched on it
+    // a confirmed track without a match this frame is kept but not handed out, nothing gets clicked where there is no match
+    // shift is how far the content moved since the previous frame, zero when unknown
+    // unmatchedRegions[i] are the parts of the frame template i wasnt matched on, the tracks in them keep their evidence
+    // and are marked held, they are not handed out either since only the camera estimate says where they are now
+    void update(Point2d shift, vector<vector<TemplateMatch>> &matches, const vector<vector<Rect>> &unmatchedRegions = {});
+
+    const vector<DetectionTrack> &getTracks(int templateIndex) const;
+    void reset();
+
+private:
+    DetectionFusionSettings settings_;
+    vector<double> thresholds_;
+    vector<vector<DetectionTrack>> tracks_;
+
+    double evidenceOf(double confidence, int templateIndex) const;
+};
+
+#endif
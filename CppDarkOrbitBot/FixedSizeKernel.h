@@ -0,0 +1,135 @@
+#ifndef FIXED_SIZE_KERNEL
+#define FIXED_SIZE_KERNEL
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+#include <immintrin.h>
+
+#include "SparseTemplate.h"
+
+using namespace std;
+using namespace cv;
+
+typedef void (*FixedSizeKernel)(const Mat &grayscaleScreenshot, const SparseTemplate &sparse, Mat &result);
+
+// the fixed size kernels are for the small searches done every frame, the tracking windows around the previous detections
+// and the collection region, full screen searches stay on the generic sparse kernel and the ncc engine
+constexpr int FIXED_SIZE_MAX_SEARCH_AREA = 96 * 96;
+
+SPARSE_TARGET_AVX2 inline long long horizontalSumFixedSize(__m256i v)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+// every template row is read as the same run of whole chunks with the transparent lanes masked out
+// so the chunks per row and the template offsets are compile time constants and the chunk loop unrolls completely
+template<int Width, int Height, TemplateMatchModes Mode>
+SPARSE_TARGET_AVX2 void matchFixedSizeTemplateAvx2(const Mat &grayscaleScreenshot, const SparseTemplate &sparse, Mat &result)
+{
+    constexpr int CHUNKS_PER_ROW = (Width + SPARSE_CHUNK_WIDTH - 1) / SPARSE_CHUNK_WIDTH;
+    constexpr int ROW_WIDTH = CHUNKS_PER_ROW * SPARSE_CHUNK_WIDTH;
+
+    // the window sum is only needed by the ccoeff modes and the sum of squares by all but the plain ccoeff and ccorr
+    constexpr bool NEEDS_SUM = Mode == TM_CCOEFF || Mode == TM_CCOEFF_NORMED;
+    constexpr bool NEEDS_SQUARES = Mode != TM_CCOEFF && Mode != TM_CCORR;
+
+    const short *weights = sparse.rowWeights.data();
+    const uchar *laneMasks = sparse.rowMasks.data();
+
+    const uchar *image = grayscaleScreenshot.data;
+    size_t imageStep = grayscaleScreenshot.step;
+    const uchar *imageEnd = image + ptrdiff_t(grayscaleScreenshot.rows - 1) * imageStep + grayscaleScreenshot.cols;
+
+    for (int y = 0; y < result.rows; y++)
+    {
+        float *resultRow = result.ptr<float>(y);
+        for (int x = 0; x < result.cols; x++)
+        {
+            const uchar *origin = image + ptrdiff_t(y) * imageStep + x;
+            long long sum = 0, sumSquares = 0, sumProducts = 0;
+
+            // the last chunk of a row reads past the template width into the next image row, masked out
+            // only on the last template row that can leave the image, near the right edge it is done pixel by pixel
+            const uchar *lastRow = origin + ptrdiff_t(Height - 1) * imageStep;
+            bool lastRowFits = lastRow + ROW_WIDTH <= imageEnd;
+            int vectorRows = lastRowFits ? Height : Height - 1;
+
+            __m128i sums = _mm_setzero_si128();
+            __m256i squares = _mm256_setzero_si256();
+            __m256i products = _mm256_setzero_si256();
+
+            for (int ty = 0; ty < vectorRows; ty++)
+            {
+                const uchar *row = origin + ptrdiff_t(ty) * imageStep;
+                const int templateRow = ty * ROW_WIDTH;
+                for (int k = 0; k < CHUNKS_PER_ROW; k++)
+                {
+                    // masked while still 8 bit, the sum of the 16 pixels comes from a single sad against zero
+                    __m128i packed = _mm_and_si128(_mm_loadu_si128((const __m128i *)(row + k * SPARSE_CHUNK_WIDTH)),
+                        _mm_loadu_si128((const __m128i *)(laneMasks + templateRow + k * SPARSE_CHUNK_WIDTH)));
+                    __m256i pixels = _mm256_cvtepu8_epi16(packed);
+                    __m256i weight = _mm256_loadu_si256((const __m256i *)(weights + templateRow + k * SPARSE_CHUNK_WIDTH));
+
+                    if constexpr (NEEDS_SUM) sums = _mm_add_epi64(sums, _mm_sad_epu8(packed, _mm_setzero_si128()));
+                    if constexpr (NEEDS_SQUARES) squares = _mm256_add_epi32(squares, _mm256_madd_epi16(pixels, pixels));
+                    products = _mm256_add_epi32(products, _mm256_madd_epi16(pixels, weight));
+                }
+            }
+
+            if constexpr (NEEDS_SUM) sum = _mm_cvtsi128_si32(sums) + _mm_extract_epi32(sums, 2);
+            if constexpr (NEEDS_SQUARES) sumSquares = horizontalSumFixedSize(squares);
+            sumProducts = horizontalSumFixedSize(products);
+
+            if (!lastRowFits)
+            {
+                const int templateRow = (Height - 1) * ROW_WIDTH;
+                for (int tx = 0; tx < Width; tx++)
+                {
+                    int pixel = lastRow[tx] & laneMasks[templateRow + tx];
+                    sum += pixel;
+                    sumSquares += pixel * pixel;
+                    sumProducts += pixel * weights[templateRow + tx];
+                }
+            }
+
+            resultRow[x] = computeMatchScore(Mode, sparse.pixelCount, double(sum), double(sumSquares), double(sumProducts), sparse.sum, sparse.sumSquares);
+        }
+    }
+}
+
+// direct matching kernel for one template size and matching mode, instantiated from the template registry
+template<int Width, int Height, TemplateMatchModes Mode>
+void matchFixedSizeTemplate(const Mat &grayscaleScreenshot, const SparseTemplate &sparse, Mat &result)
+{
+    static_assert(Width > 0 && Height > 0, "Template size must be positive");
+    static_assert(Width * Height <= SPARSE_MAX_PIXELS, "Template too big for 32 bit accumulators");
+
+    // a template that doesnt have the registered size or a cpu without avx2 goes through the generic sparse kernel
+    // the padding read past the end of every row has to stay inside the next row
+    constexpr int ROW_WIDTH = (Width + SPARSE_CHUNK_WIDTH - 1) / SPARSE_CHUNK_WIDTH * SPARSE_CHUNK_WIDTH;
+    if (sparse.width != Width || sparse.height != Height || sparse.rowWidth != ROW_WIDTH || grayscaleScreenshot.step < ROW_WIDTH - Width
+        || !checkHardwareSupport(CV_CPU_AVX2))
+    {
+        matchSparseTemplate(grayscaleScreenshot, sparse, Mode, result);
+        return;
+    }
+
+    CV_Assert(grayscaleScreenshot.type() == CV_8UC1);
+
+    int resultRows = grayscaleScreenshot.rows - Height + 1;
+    int resultCols = grayscaleScreenshot.cols - Width + 1;
+    if (resultRows <= 0 || resultCols <= 0)
+    {
+        result = Mat();
+        return;
+    }
+
+    result.create(resultRows, resultCols, CV_32FC1);
+    matchFixedSizeTemplateAvx2<Width, Height, Mode>(grayscaleScreenshot, sparse, result);
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/utility.hpp>
+#include <immintrin.h>
+
+#include "FrameConversion.h"
+
+using namespace std;
+using namespace cv;
+
+// msvc allows intrinsics of any instruction set in any function, gcc and clang need them enabled per function
+#if defined(_MSC_VER)
+#define FRAME_TARGET_AVX2
+#else
+#define FRAME_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// fixed point weights opencv uses for COLOR_BGR2GRAY on 8 bit images, gray = (B*1868 + G*9617 + R*4899 + 2^13) >> 14
+constexpr int GRAY_SHIFT = 14;
+constexpr int GRAY_BLUE_WEIGHT = 1868;
+constexpr int GRAY_GREEN_WEIGHT = 9617;
+constexpr int GRAY_RED_WEIGHT = 4899;
+
+typedef void (*GrayRowConverter)(const uchar *source, uchar *destination, int width);
+typedef void (*DecimatedGrayRowConverter)(const uchar *top, const uchar *bottom, uchar *destination, int width);
+
+static void grayRowScalar(const uchar *source, uchar *destination, int width)
+{
+    for (int x = 0; x < width; x++)
+    {
+        const uchar *pixel = source + x * 4;
+        destination[x] = uchar((pixel[0] * GRAY_BLUE_WEIGHT + pixel[1] * GRAY_GREEN_WEIGHT + pixel[2] * GRAY_RED_WEIGHT + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+    }
+}
+
+// the 2x2 block is summed first, dividing the sum by 4 is folded into the final shift
+static void decimatedGrayRowScalar(const uchar *top, const uchar *bottom, uchar *destination, int width)
+{
+    for (int x = 0; x < width; x++)
+    {
+        const uchar *a = top + x * 8;
+        const uchar *b = bottom + x * 8;
+        int blue = a[0] + a[4] + b[0] + b[4];
+        int green = a[1] + a[5] + b[1] + b[5];
+        int red = a[2] + a[6] + b[2] + b[6];
+        destination[x] = uchar((blue * GRAY_BLUE_WEIGHT + green * GRAY_GREEN_WEIGHT + red * GRAY_RED_WEIGHT + (1 << (GRAY_SHIFT + 1))) >> (GRAY_SHIFT + 2));
+    }
+}
+
+// 8 pixels per iteration, the channels are widened to 16 bit and madd gives B*wb + G*wg and R*wr per pixel
+FRAME_TARGET_AVX2 static void grayRowAvx2(const uchar *source, uchar *destination, int width)
+{
+    const __m256i weights = _mm256_setr_epi16(
+        GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0, GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0,
+        GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0, GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0);
+    const __m256i rounding = _mm256_set1_epi32(1 << (GRAY_SHIFT - 1));
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *)(source + x * 4));
+        __m256i low = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels)), weights);
+        __m256i high = _mm256_madd_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1)), weights);
+
+        // hadd works per 128 bit lane so the gray values come out as p0 p1 p4 p5 | p2 p3 p6 p7
+        __m256i gray = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(low, high), rounding), GRAY_SHIFT);
+        __m256i words = _mm256_packus_epi32(gray, gray);
+        __m128i ordered = _mm_unpacklo_epi32(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storel_epi64((__m128i *)(destination + x), _mm_packus_epi16(ordered, ordered));
+    }
+
+    grayRowScalar(source + x * 4, destination + x, width - x);
+}
+
+// 4 output pixels per iteration from 8 pixels of both rows
+FRAME_TARGET_AVX2 static void decimatedGrayRowAvx2(const uchar *top, const uchar *bottom, uchar *destination, int width)
+{
+    const __m256i weights = _mm256_setr_epi16(
+        GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0, GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0,
+        GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0, GRAY_BLUE_WEIGHT, GRAY_GREEN_WEIGHT, GRAY_RED_WEIGHT, 0);
+    const __m256i rounding = _mm256_set1_epi32(1 << (GRAY_SHIFT + 1));
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(top + x * 8));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(bottom + x * 8));
+
+        // vertical sums, low holds pixels 0-3 and high pixels 4-7, two pixels per 128 bit lane
+        __m256i low = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(a)), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(b)));
+        __m256i high = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(a, 1)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(b, 1)));
+
+        // horizontal sums of the neighbouring pixels, the blocks end up as o0 o2 | o1 o3
+        low = _mm256_add_epi16(low, _mm256_srli_si256(low, 8));
+        high = _mm256_add_epi16(high, _mm256_srli_si256(high, 8));
+        __m256i blocks = _mm256_unpacklo_epi64(low, high);
+
+        __m256i weighted = _mm256_madd_epi16(blocks, weights);
+        __m256i gray = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(weighted, weighted), rounding), GRAY_SHIFT + 2);
+        __m128i ordered = _mm_unpacklo_epi32(_mm256_castsi256_si128(gray), _mm256_extracti128_si256(gray, 1));
+        __m128i words = _mm_packus_epi32(ordered, ordered);
+        *(int *)(destination + x) = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    }
+
+    decimatedGrayRowScalar(top + x * 8, bottom + x * 8, destination + x, width - x);
+}
+
+static void convertGrayscale(const Mat &bgra, int decimation, Mat &output)
+{
+    bool avx2 = checkHardwareSupport(CV_CPU_AVX2);
+
+    if (decimation == 1)
+    {
+        GrayRowConverter convertRow = avx2 ? grayRowAvx2 : grayRowScalar;
+        for (int y = 0; y < output.rows; y++) convertRow(bgra.ptr<uchar>(y), output.ptr<uchar>(y), output.cols);
+        return;
+    }
+
+    DecimatedGrayRowConverter convertRow = avx2 ? decimatedGrayRowAvx2 : decimatedGrayRowScalar;
+    for (int y = 0; y < output.rows; y++) convertRow(bgra.ptr<uchar>(y * 2), bgra.ptr<uchar>(y * 2 + 1), output.ptr<uchar>(y), output.cols);
+}
+
+static void convertGreen(const Mat &bgra, int decimation, Mat &output)
+{
+    for (int y = 0; y < output.rows; y++)
+    {
+        uchar *destination = output.ptr<uchar>(y);
+
+        if (decimation == 1)
+        {
+            const uchar *source = bgra.ptr<uchar>(y);
+            for (int x = 0; x < output.cols; x++) destination[x] = source[x * 4 + 1];
+            continue;
+        }
+
+        const uchar *top = bgra.ptr<uchar>(y * 2);
+        const uchar *bottom = bgra.ptr<uchar>(y * 2 + 1);
+        for (int x = 0; x < output.cols; x++)
+        {
+            destination[x] = uchar((top[x * 8 + 1] + top[x * 8 + 5] + bottom[x * 8 + 1] + bottom[x * 8 + 5] + 2) >> 2);
+        }
+    }
+}
+
+static void convertBgr(const Mat &bgra, int decimation, Mat &output)
+{
+    if (decimation == 1)
+    {
+        cvtColor(bgra, output, COLOR_BGRA2BGR);
+        return;
+    }
+
+    for (int y = 0; y < output.rows; y++)
+    {
+        const uchar *top = bgra.ptr<uchar>(y * 2);
+        const uchar *bottom = bgra.ptr<uchar>(y * 2 + 1);
+        uchar *destination = output.ptr<uchar>(y);
+
+        for (int x = 0; x < output.cols; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                destination[x * 3 + c] = uchar((top[x * 8 + c] + top[x * 8 + 4 + c] + bottom[x * 8 + c] + bottom[x * 8 + 4 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+void convertCapturedRegion(const Mat &bgra, Rect region, int decimation, Mat &output)
+{
+    Rect fullRegion = Rect(region.x * decimation, region.y * decimation, region.width * decimation, region.height * decimation)
+        & Rect(0, 0, bgra.cols, bgra.rows);
+
+    output = Mat();
+    if (fullRegion.area() > 0) convertCapturedFrame(bgra(fullRegion), CAPTURE_BGR, decimation, output);
+}
+
+void convertCapturedFrame(const Mat &bgra, CaptureFormat format, int decimation, Mat &output)
+{
+    int rows = bgra.rows / decimation;
+    int cols = bgra.cols / decimation;
+
+    switch (format)
+    {
+    case CAPTURE_GRAYSCALE:
+        output.create(rows, cols, CV_8UC1);
+        convertGrayscale(bgra, decimation, output);
+        break;
+    case CAPTURE_GREEN:
+        output.create(rows, cols, CV_8UC1);
+        convertGreen(bgra, decimation, output);
+        break;
+    case CAPTURE_BGR:
+        output.create(rows, cols, CV_8UC3);
+        convertBgr(bgra, decimation, output);
+        break;
+    }
+}
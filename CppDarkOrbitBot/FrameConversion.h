@@ -0,0 +1,30 @@
+#ifndef FRAME_CONVERSION
+#define FRAME_CONVERSION
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+using namespace cv;
+
+enum CaptureFormat {
+    CAPTURE_BGR,          // 3 channels, what cv::imshow and the overlay drawing expect
+    CAPTURE_GRAYSCALE,    // same weights and rounding as cv::cvtColor with COLOR_BGR2GRAY
+    CAPTURE_GREEN         // only the green channel, the cheapest single channel frame
+};
+
+// shared by every capture backend
+struct CaptureSettings {
+    CaptureFormat format = CAPTURE_BGR;
+    int decimation = 1;           // 1 or 2
+    bool keepColor = false;       // also hand out the full resolution BGR frame, only needed for the overlay
+};
+
+// converts a captured 32 bit BGRA frame into the requested format in a single pass
+// decimation 2 averages every 2x2 block into one pixel in the same pass, an odd last row or column is dropped
+void convertCapturedFrame(const Mat &bgra, CaptureFormat format, int decimation, Mat &output);
+// BGR copy of a region of the frame convertCapturedFrame makes out of bgra, region is in the coordinates of that frame
+// output is left empty when the region is outside the frame
+void convertCapturedRegion(const Mat &bgra, Rect region, int decimation, Mat &output);
+
+#endif
@@ -0,0 +1,225 @@
+#include <opencv2/core/types.hpp>
+#include <cstring>
+
+#include "BotUtils.h"
+#include "Constants.h"
+#include "FramePublisher.h"
+
+using namespace std;
+using namespace cv;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static size_t headerBytes()
+{
+    return alignUp(sizeof(SharedFrameHeader), 64);
+}
+
+// every slot starts on its own page, the pixels follow the slot header
+size_t sharedFrameSlotBytes()
+{
+    return alignUp(alignUp(sizeof(SharedFrameSlot), 64) + size_t(FRAME_MAX_WIDTH) * FRAME_MAX_HEIGHT * FRAME_MAX_CHANNELS, 4096);
+}
+
+size_t sharedFrameMemoryBytes()
+{
+    return headerBytes() + sharedFrameSlotBytes() * FRAME_RING_SLOTS;
+}
+
+static SharedFrameSlot *slotAt(uint8_t *view, uint64_t frameNumber)
+{
+    return reinterpret_cast<SharedFrameSlot *>(view + headerBytes() + sharedFrameSlotBytes() * (frameNumber % FRAME_RING_SLOTS));
+}
+
+static const SharedFrameSlot *slotAt(const uint8_t *view, uint64_t frameNumber)
+{
+    return reinterpret_cast<const SharedFrameSlot *>(view + headerBytes() + sharedFrameSlotBytes() * (frameNumber % FRAME_RING_SLOTS));
+}
+
+static size_t pixelOffset()
+{
+    return alignUp(sizeof(SharedFrameSlot), 64);
+}
+
+FramePublisher::FramePublisher() : mapping_(nullptr), view_(nullptr), frameNumber_(0), reportedUnsupportedFrame_(false)
+{
+}
+
+FramePublisher::~FramePublisher()
+{
+    close();
+}
+
+bool FramePublisher::open()
+{
+    if (isOpen()) return true;
+
+    size_t bytes = sharedFrameMemoryBytes();
+    mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(bytes) >> 32), DWORD(bytes & 0xFFFFFFFF), FRAME_SHARED_MEMORY_NAME);
+    if (mapping_ == nullptr)
+    {
+        printWithTimestamp("Could not create the shared memory for the frame viewers", RED_TEXT_BLACK_BACKGROUND);
+        return false;
+    }
+
+    view_ = static_cast<uint8_t *>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, bytes));
+    if (view_ == nullptr)
+    {
+        printWithTimestamp("Could not map the shared memory for the frame viewers", RED_TEXT_BLACK_BACKGROUND);
+        close();
+        return false;
+    }
+
+    // a new mapping is zeroed, one left over from a previous run starts over with no frame published
+    SharedFrameHeader *header = reinterpret_cast<SharedFrameHeader *>(view_);
+    header->latestFrame.store(0, memory_order_release);
+    for (int i = 0; i < FRAME_RING_SLOTS; i++) slotAt(view_, i)->sequence.store(0, memory_order_relaxed);
+    header->magic = FRAME_SHARED_MEMORY_MAGIC;
+    header->version = FRAME_SHARED_MEMORY_VERSION;
+    header->slotCount = FRAME_RING_SLOTS;
+    header->slotBytes = uint32_t(sharedFrameSlotBytes());
+
+    frameNumber_ = 0;
+    return true;
+}
+
+void FramePublisher::close()
+{
+    if (view_ != nullptr) UnmapViewOfFile(view_);
+    if (mapping_ != nullptr) CloseHandle(mapping_);
+    view_ = nullptr;
+    mapping_ = nullptr;
+}
+
+bool FramePublisher::isOpen() const
+{
+    return view_ != nullptr;
+}
+
+void FramePublisher::publish(const Mat &frame, long long captureMicros, BotStatus status, const vector<vector<TemplateMatch>> &matches)
+{
+    if (!isOpen() || frame.empty()) return;
+
+    if (frame.cols > FRAME_MAX_WIDTH || frame.rows > FRAME_MAX_HEIGHT || frame.channels() > FRAME_MAX_CHANNELS || frame.depth() != CV_8U)
+    {
+        if (!reportedUnsupportedFrame_) printWithTimestamp("Frames this big cannot be published to the viewers", RED_TEXT_BLACK_BACKGROUND);
+        reportedUnsupportedFrame_ = true;
+        return;
+    }
+
+    uint64_t frameNumber = ++frameNumber_;
+    SharedFrameSlot *slot = slotAt(view_, frameNumber);
+
+    slot->sequence.store(frameNumber * 2 + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->frameNumber = frameNumber;
+    slot->captureMicros = captureMicros;
+    slot->width = frame.cols;
+    slot->height = frame.rows;
+    slot->channels = frame.channels();
+    slot->status = status;
+
+    int detectionCount = 0;
+    for (const vector<TemplateMatch> &templateMatches : matches)
+    {
+        for (const TemplateMatch &match : templateMatches)
+        {
+            if (detectionCount == FRAME_MAX_DETECTIONS) break;
+            slot->detections[detectionCount++] = SharedDetection{ match.rect.x, match.rect.y, match.rect.width, match.rect.height,
+                float(match.confidence), int32_t(match.identifier) };
+        }
+    }
+    slot->detectionCount = detectionCount;
+
+    uint8_t *pixels = reinterpret_cast<uint8_t *>(slot) + pixelOffset();
+    size_t rowBytes = size_t(frame.cols) * frame.channels();
+    for (int y = 0; y < frame.rows; y++) memcpy(pixels + y * rowBytes, frame.ptr<uchar>(y), rowBytes);
+
+    slot->sequence.store(frameNumber * 2 + 2, memory_order_release);
+    reinterpret_cast<SharedFrameHeader *>(view_)->latestFrame.store(frameNumber, memory_order_release);
+}
+
+FrameSubscriber::FrameSubscriber() : mapping_(nullptr), view_(nullptr)
+{
+}
+
+FrameSubscriber::~FrameSubscriber()
+{
+    close();
+}
+
+bool FrameSubscriber::open()
+{
+    if (isOpen()) return true;
+
+    mapping_ = OpenFileMappingA(FILE_MAP_READ, FALSE, FRAME_SHARED_MEMORY_NAME);
+    if (mapping_ == nullptr) return false;
+
+    view_ = static_cast<const uint8_t *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, sharedFrameMemoryBytes()));
+    const SharedFrameHeader *header = reinterpret_cast<const SharedFrameHeader *>(view_);
+    if (view_ == nullptr || header->magic != FRAME_SHARED_MEMORY_MAGIC || header->version != FRAME_SHARED_MEMORY_VERSION
+        || header->slotCount != FRAME_RING_SLOTS || header->slotBytes != sharedFrameSlotBytes())
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void FrameSubscriber::close()
+{
+    if (view_ != nullptr) UnmapViewOfFile(view_);
+    if (mapping_ != nullptr) CloseHandle(mapping_);
+    view_ = nullptr;
+    mapping_ = nullptr;
+}
+
+bool FrameSubscriber::isOpen() const
+{
+    return view_ != nullptr;
+}
+
+bool FrameSubscriber::readLatest(uint64_t lastFrameNumber, PublishedFrame &frame)
+{
+    if (!isOpen()) return false;
+
+    const SharedFrameHeader *header = reinterpret_cast<const SharedFrameHeader *>(view_);
+
+    // a slot can be overwritten while it is copied when the viewer falls a whole ring behind, the newest frame is tried again then
+    for (int attempt = 0; attempt < FRAME_RING_SLOTS; attempt++)
+    {
+        uint64_t frameNumber = header->latestFrame.load(memory_order_acquire);
+        if (frameNumber == 0 || frameNumber == lastFrameNumber) return false;
+
+        const SharedFrameSlot *slot = slotAt(view_, frameNumber);
+        uint64_t sequence = slot->sequence.load(memory_order_acquire);
+        if (sequence != frameNumber * 2 + 2) continue;
+
+        int width = slot->width;
+        int height = slot->height;
+        int channels = slot->channels;
+        int detectionCount = slot->detectionCount;
+        if (width <= 0 || width > FRAME_MAX_WIDTH || height <= 0 || height > FRAME_MAX_HEIGHT || channels < 1 || channels > FRAME_MAX_CHANNELS
+            || detectionCount < 0 || detectionCount > FRAME_MAX_DETECTIONS) continue;
+
+        frame.frameNumber = frameNumber;
+        frame.captureMicros = slot->captureMicros;
+        frame.status = BotStatus(slot->status);
+        frame.detections.assign(slot->detections, slot->detections + detectionCount);
+        frame.image.create(height, width, CV_8UC(channels));
+
+        const uint8_t *pixels = reinterpret_cast<const uint8_t *>(slot) + pixelOffset();
+        size_t rowBytes = size_t(width) * channels;
+        for (int y = 0; y < height; y++) memcpy(frame.image.ptr<uchar>(y), pixels + y * rowBytes, rowBytes);
+
+        atomic_thread_fence(memory_order_acquire);
+        if (slot->sequence.load(memory_order_relaxed) == sequence) return true;
+    }
+
+    return false;
+}
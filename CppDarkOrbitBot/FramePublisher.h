@@ -0,0 +1,109 @@
+#ifndef FRAME_PUBLISHER
+#define FRAME_PUBLISHER
+
+#include <opencv2/core/types.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <windows.h>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+// the shared memory every viewer attaches to, local to the windows session
+constexpr const char *FRAME_SHARED_MEMORY_NAME = "Local\\CppDarkOrbitBotFrames";
+constexpr uint32_t FRAME_SHARED_MEMORY_MAGIC = 0x44424F46;     // "FOBD"
+constexpr uint32_t FRAME_SHARED_MEMORY_VERSION = 1;
+constexpr int FRAME_RING_SLOTS = 4;
+constexpr int FRAME_MAX_WIDTH = 1920;
+constexpr int FRAME_MAX_HEIGHT = 1080;
+constexpr int FRAME_MAX_CHANNELS = 3;
+constexpr int FRAME_MAX_DETECTIONS = 256;
+
+struct SharedDetection {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float confidence;
+    int32_t identifier;     // TemplateIdentifier
+};
+
+// the sequence is odd while the slot is being written, a reader copies the slot and only keeps the copy
+// when the sequence was even and the same before and after, so the writer never has to wait for a reader
+struct SharedFrameSlot {
+    atomic<uint64_t> sequence;
+    uint64_t frameNumber;
+    int64_t captureMicros;
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    int32_t status;         // BotStatus
+    int32_t detectionCount;
+    SharedDetection detections[FRAME_MAX_DETECTIONS];
+};
+
+struct SharedFrameHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotBytes;
+    atomic<uint64_t> latestFrame;   // frame number of the newest complete slot, 0 before the first one
+};
+
+// one frame as a viewer got it out of the ring
+struct PublishedFrame {
+    uint64_t frameNumber = 0;
+    long long captureMicros = 0;
+    BotStatus status = SCANNING;
+    Mat image;
+    vector<SharedDetection> detections;
+};
+
+// writes the latest frames into a ring in named shared memory, the main loop only pays for one copy per frame
+// and never waits for or knows about the viewers reading it
+class FramePublisher {
+public:
+    FramePublisher();
+    ~FramePublisher();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    // frames bigger than FRAME_MAX_WIDTH x FRAME_MAX_HEIGHT or with more than 3 channels are skipped
+    void publish(const Mat &frame, long long captureMicros, BotStatus status, const vector<vector<TemplateMatch>> &matches);
+
+private:
+    HANDLE mapping_;
+    uint8_t *view_;
+    uint64_t frameNumber_;
+    bool reportedUnsupportedFrame_;
+};
+
+// the reading side, any number of them can attach to the same publisher
+class FrameSubscriber {
+public:
+    FrameSubscriber();
+    ~FrameSubscriber();
+
+    // false while the bot isnt running
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    // copies the newest frame if it is newer than lastFrameNumber, false when there is nothing new
+    bool readLatest(uint64_t lastFrameNumber, PublishedFrame &frame);
+
+private:
+    HANDLE mapping_;
+    const uint8_t *view_;
+};
+
+size_t sharedFrameSlotBytes();
+size_t sharedFrameMemoryBytes();
+
+#endif
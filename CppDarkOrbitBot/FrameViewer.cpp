@@ -0,0 +1,83 @@
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+
+#include "BotUtils.h"
+#include "Constants.h"
+#include "TemplateRegistry.h"
+#include "FramePublisher.h"
+#include "FrameViewer.h"
+
+using namespace std;
+using namespace cv;
+
+static void drawPublishedFrame(const PublishedFrame &frame, Mat &view)
+{
+    if (frame.image.channels() == 1) cvtColor(frame.image, view, COLOR_GRAY2BGR);
+    else view = frame.image.clone();
+
+    for (const SharedDetection &detection : frame.detections)
+    {
+        // same colors the in process overlay uses
+        Scalar color = detection.identifier == PALLADIUM ? Scalar(255, 120, 0) : Scalar(255, 255, 255);
+        Rect rect(detection.x, detection.y, detection.width, detection.height);
+        rectangle(view, rect, color, 2);
+
+        string name = detection.identifier >= 0 && detection.identifier < TEMPLATE_COUNT
+            ? filesystem::path(TEMPLATE_REGISTRY[detection.identifier].path).filename().string() : "unknown";
+        ostringstream label;
+        label << name << " | " << fixed << setprecision(2) << detection.confidence;
+        putText(view, label.str(), Point(rect.x, max(12, rect.y - 6)), FONT_HERSHEY_SIMPLEX, 0.5, color, 1);
+    }
+
+    // how old the frame was when it reached the viewer, includes the time the bot spent on it before publishing
+    ostringstream info;
+    info << "frame " << frame.frameNumber << " | " << botStatusEnumToString(frame.status) << " | "
+        << computeTimePassed(frame.captureMicros, getCurrentMicros()) / 1000 << " ms since capture";
+    putText(view, info.str(), Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.75, Scalar(0, 255, 0), 2);
+}
+
+int runFrameViewer(const FrameViewerSettings &settings)
+{
+    FrameSubscriber subscriber;
+    PublishedFrame frame;
+    Mat view;
+    uint64_t lastFrameNumber = 0;
+    bool waitingReported = false;
+
+    namedWindow(settings.windowName);
+
+    while (true)
+    {
+        if (!subscriber.isOpen())
+        {
+            if (!subscriber.open())
+            {
+                if (!waitingReported) printWithTimestamp("Waiting for the bot to publish frames...", YELLOW_TEXT_BLACK_BACKGROUND);
+                waitingReported = true;
+
+                int key = waitKey(settings.reconnectMillis);
+                if (key == 27 || key == 'q') break;
+                continue;
+            }
+
+            printWithTimestamp("Attached to the bot frames", GREEN_TEXT_BLACK_BACKGROUND);
+            waitingReported = false;
+            lastFrameNumber = 0;
+        }
+
+        if (subscriber.readLatest(lastFrameNumber, frame))
+        {
+            lastFrameNumber = frame.frameNumber;
+            drawPublishedFrame(frame, view);
+            imshow(settings.windowName, view);
+        }
+
+        int key = waitKey(settings.pollMillis);
+        if (key == 27 || key == 'q') break;
+    }
+
+    destroyWindow(settings.windowName);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef FRAME_VIEWER
+#define FRAME_VIEWER
+
+#include <string>
+
+using namespace std;
+
+// offline mode that shows what a running bot publishes, in its own process so the bot never renders or waits for it
+struct FrameViewerSettings {
+    string windowName = "CppDarkOrbitBotViewer";
+    int pollMillis = 10;                // how often the ring is checked for a new frame
+    int reconnectMillis = 500;          // how often attaching is retried while the bot isnt running
+};
+
+// returns the process exit code, runs until the viewer window gets escape or q
+int runFrameViewer(const FrameViewerSettings &settings);
+
+#endif
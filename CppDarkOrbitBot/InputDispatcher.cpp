@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+
+#include "InputDispatcher.h"
+#include "Timing.h"
+
+using namespace std;
+
+void MockInputBackend::record(InputEventType type, int x, int y, int key)
+{
+    lock_guard<mutex> lock(mutex_);
+    events_.push_back(InputEvent{ type, x, y, key, getCurrentMicros() });
+}
+
+void MockInputBackend::moveTo(int x, int y)
+{
+    record(INPUT_EVENT_MOVE, x, y, 0);
+}
+
+void MockInputBackend::buttonDown()
+{
+    record(INPUT_EVENT_BUTTON_DOWN, 0, 0, 0);
+}
+
+void MockInputBackend::buttonUp()
+{
+    record(INPUT_EVENT_BUTTON_UP, 0, 0, 0);
+}
+
+void MockInputBackend::keyDown(int key)
+{
+    record(INPUT_EVENT_KEY_DOWN, 0, 0, key);
+}
+
+void MockInputBackend::keyUp(int key)
+{
+    record(INPUT_EVENT_KEY_UP, 0, 0, key);
+}
+
+vector<InputEvent> MockInputBackend::getEvents() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return events_;
+}
+
+void MockInputBackend::clear()
+{
+    lock_guard<mutex> lock(mutex_);
+    events_.clear();
+}
+
+InputDispatcher::InputDispatcher(InputBackend &backend, const InputDispatcherSettings &settings) : backend_(backend), settings_(settings),
+    sending_(false), running_(false), droppedCommands_(0)
+{
+}
+
+InputDispatcher::~InputDispatcher()
+{
+    stop();
+}
+
+void InputDispatcher::start()
+{
+    if (running_) return;
+
+    running_ = true;
+    dispatchThread_ = thread(&InputDispatcher::dispatchLoop, this);
+}
+
+// the commands still queued are sent before the thread exits
+void InputDispatcher::stop()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (!running_) return;
+        running_ = false;
+    }
+    commandAvailable_.notify_all();
+    if (dispatchThread_.joinable()) dispatchThread_.join();
+}
+
+bool InputDispatcher::isRunning() const
+{
+    return running_;
+}
+
+void InputDispatcher::setDeliveredCallback(function<void(const InputCommand &command, long long deliveredMicros)> delivered)
+{
+    delivered_ = delivered;
+}
+
+void InputDispatcher::click(int x, int y, long long captureMicros)
+{
+    InputCommand command;
+    command.type = INPUT_CLICK;
+    command.x = x;
+    command.y = y;
+    command.captureMicros = captureMicros;
+    enqueue(command);
+}
+
+void InputDispatcher::move(int x, int y, long long captureMicros)
+{
+    InputCommand command;
+    command.type = INPUT_MOVE;
+    command.x = x;
+    command.y = y;
+    command.captureMicros = captureMicros;
+    enqueue(command);
+}
+
+void InputDispatcher::pressKey(int key, long long captureMicros)
+{
+    InputCommand command;
+    command.type = INPUT_KEY;
+    command.key = key;
+    command.captureMicros = captureMicros;
+    enqueue(command);
+}
+
+void InputDispatcher::enqueue(InputCommand command)
+{
+    command.enqueuedMicros = getCurrentMicros();
+
+    {
+        unique_lock<mutex> lock(mutex_);
+        if (running_)
+        {
+            // a click decided on an old frame is worth less than the newest one, so the oldest command makes room
+            // the newest command always fits, even with a capacity below one
+            if (!commands_.empty() && commands_.size() >= size_t(max(1, settings_.capacity)))
+            {
+                commands_.pop_front();
+                droppedCommands_++;
+            }
+            commands_.push_back(command);
+            lock.unlock();
+            commandAvailable_.notify_one();
+            return;
+        }
+    }
+
+    send(command);
+}
+
+void InputDispatcher::waitUntilIdle()
+{
+    unique_lock<mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return commands_.empty() && !sending_; });
+}
+
+long long InputDispatcher::getDroppedCommands() const
+{
+    return droppedCommands_;
+}
+
+void InputDispatcher::dispatchLoop()
+{
+    while (true)
+    {
+        InputCommand command;
+        {
+            unique_lock<mutex> lock(mutex_);
+            commandAvailable_.wait(lock, [this]() { return !running_ || !commands_.empty(); });
+            if (commands_.empty()) return;
+
+            command = commands_.front();
+            commands_.pop_front();
+            sending_ = true;
+        }
+
+        send(command);
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            sending_ = false;
+        }
+        idle_.notify_all();
+    }
+}
+
+void InputDispatcher::send(const InputCommand &command)
+{
+    switch (command.type)
+    {
+    case INPUT_CLICK:
+        backend_.moveTo(command.x, command.y);
+        backend_.buttonDown();
+        this_thread::sleep_for(chrono::milliseconds(settings_.buttonHoldMillis));
+        backend_.buttonUp();
+        break;
+    case INPUT_MOVE:
+        backend_.moveTo(command.x, command.y);
+        break;
+    case INPUT_KEY:
+        backend_.keyDown(command.key);
+        this_thread::sleep_for(chrono::milliseconds(settings_.keyHoldMillis));
+        backend_.keyUp(command.key);
+        break;
+    }
+
+    if (delivered_) delivered_(command, getCurrentMicros());
+}
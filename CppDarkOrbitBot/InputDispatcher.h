@@ -0,0 +1,127 @@
+#ifndef INPUT_DISPATCHER
+#define INPUT_DISPATCHER
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// the os calls the dispatcher needs, so the commands can be sent somewhere else than the real mouse and keyboard
+// the win32 one lives in Win32InputBackend so the dispatcher itself builds without the windows headers
+class InputBackend {
+public:
+    virtual ~InputBackend() = default;
+
+    virtual void moveTo(int x, int y) = 0;
+    virtual void buttonDown() = 0;
+    virtual void buttonUp() = 0;
+    virtual void keyDown(int key) = 0;
+    virtual void keyUp(int key) = 0;
+};
+
+enum InputEventType {
+    INPUT_EVENT_MOVE,
+    INPUT_EVENT_BUTTON_DOWN,
+    INPUT_EVENT_BUTTON_UP,
+    INPUT_EVENT_KEY_DOWN,
+    INPUT_EVENT_KEY_UP
+};
+
+struct InputEvent {
+    InputEventType type;
+    int x;
+    int y;
+    int key;
+    long long micros;
+};
+
+// only records what it was asked to do and when, for checking the bot behaviour without touching the real mouse
+class MockInputBackend : public InputBackend {
+public:
+    void moveTo(int x, int y) override;
+    void buttonDown() override;
+    void buttonUp() override;
+    void keyDown(int key) override;
+    void keyUp(int key) override;
+
+    vector<InputEvent> getEvents() const;
+    void clear();
+
+private:
+    mutable mutex mutex_;
+    vector<InputEvent> events_;
+
+    void record(InputEventType type, int x, int y, int key);
+};
+
+enum InputCommandType {
+    INPUT_CLICK,
+    INPUT_MOVE,
+    INPUT_KEY
+};
+
+struct InputCommand {
+    InputCommandType type;
+    int x = 0;
+    int y = 0;
+    int key = 0;
+    long long captureMicros = 0;    // capture time of the frame the command was decided on, 0 when it wasnt decided on a frame
+    long long enqueuedMicros = 0;
+};
+
+struct InputDispatcherSettings {
+    int capacity = 16;                  // commands waiting at most, the oldest one is dropped to make room for a new one
+    long long buttonHoldMillis = 5;     // between button down and up of a click
+    long long keyHoldMillis = 30;       // between key down and up
+};
+
+// sends the input on its own thread so the main loop can capture and match the next frame while a click is held
+// while the thread isnt running the commands are sent straight away on the calling thread
+class InputDispatcher {
+public:
+    InputDispatcher(InputBackend &backend, const InputDispatcherSettings &settings);
+    ~InputDispatcher();
+
+    void start();
+    void stop();
+    bool isRunning() const;
+
+    // called once a command was fully sent, deliveredMicros is when the last event went out, never for a dropped command
+    // runs on the dispatcher thread, or on the calling thread while the dispatcher is stopped, has to be set before start
+    void setDeliveredCallback(function<void(const InputCommand &command, long long deliveredMicros)> delivered);
+
+    void click(int x, int y, long long captureMicros = 0);
+    void move(int x, int y, long long captureMicros = 0);
+    void pressKey(int key, long long captureMicros = 0);
+
+    // blocks until every queued command was sent
+    void waitUntilIdle();
+
+    long long getDroppedCommands() const;
+
+private:
+    InputBackend &backend_;
+    InputDispatcherSettings settings_;
+    function<void(const InputCommand &, long long)> delivered_;
+
+    mutex mutex_;
+    condition_variable commandAvailable_;
+    condition_variable idle_;
+    deque<InputCommand> commands_;
+    bool sending_;
+
+    atomic<bool> running_;
+    atomic<long long> droppedCommands_;
+    thread dispatchThread_;
+
+    void enqueue(InputCommand command);
+    void dispatchLoop();
+    void send(const InputCommand &command);
+};
+
+#endif
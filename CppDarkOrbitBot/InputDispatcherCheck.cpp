@@ -0,0 +1,173 @@
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "InputDispatcher.h"
+
+using namespace std;
+
+// checks the input dispatcher against the mock backend, no real mouse or keyboard involved:
+//   ./input_dispatcher_check
+
+static int failures = 0;
+
+static void expect(bool condition, const string &message)
+{
+    if (condition) return;
+    std::cerr << "FAILED: " << message << std::endl;
+    failures++;
+}
+
+// holds the first move until it is released, so the dispatcher thread is busy while the queue fills up
+class BlockingInputBackend : public MockInputBackend {
+public:
+    void moveTo(int x, int y) override
+    {
+        {
+            unique_lock<mutex> lock(mutex_);
+            if (!blocked_)
+            {
+                blocked_ = true;
+                changed_.notify_all();
+                changed_.wait(lock, [this]() { return released_; });
+            }
+        }
+        MockInputBackend::moveTo(x, y);
+    }
+
+    void waitUntilBlocked()
+    {
+        unique_lock<mutex> lock(mutex_);
+        changed_.wait(lock, [this]() { return blocked_; });
+    }
+
+    void release()
+    {
+        lock_guard<mutex> lock(mutex_);
+        released_ = true;
+        changed_.notify_all();
+    }
+
+private:
+    mutex mutex_;
+    condition_variable changed_;
+    bool blocked_ = false;
+    bool released_ = false;
+};
+
+static vector<int> movedTo(const vector<InputEvent> &events)
+{
+    vector<int> xs;
+    for (const InputEvent &event : events)
+    {
+        if (event.type == INPUT_EVENT_MOVE) xs.push_back(event.x);
+    }
+    return xs;
+}
+
+static string join(const vector<int> &values)
+{
+    string text;
+    for (int value : values) text += (text.empty() ? "" : ",") + to_string(value);
+    return "[" + text + "]";
+}
+
+// the first click holds the thread, the queue of two then takes four more and has to keep only the newest two
+static void checkDropsOldestWhenFull()
+{
+    BlockingInputBackend backend;
+    InputDispatcherSettings settings;
+    settings.capacity = 2;
+    settings.buttonHoldMillis = 0;
+    InputDispatcher dispatcher(backend, settings);
+
+    mutex deliveredMutex;
+    vector<int> delivered;
+    dispatcher.setDeliveredCallback([&](const InputCommand &command, long long deliveredMicros)
+        {
+            lock_guard<mutex> lock(deliveredMutex);
+            delivered.push_back(command.x);
+        });
+
+    dispatcher.start();
+    dispatcher.click(1, 0);
+    backend.waitUntilBlocked();
+    for (int x = 2; x <= 5; x++) dispatcher.click(x, 0);
+
+    expect(dispatcher.getDroppedCommands() == 2, "dropped " + to_string(dispatcher.getDroppedCommands()) + " commands instead of 2");
+
+    backend.release();
+    dispatcher.waitUntilIdle();
+    dispatcher.stop();
+
+    vector<int> expected = { 1, 4, 5 };
+    expect(movedTo(backend.getEvents()) == expected, "moved to " + join(movedTo(backend.getEvents())) + " instead of " + join(expected));
+
+    // the dropped clicks never reached the backend, so they must not be reported as delivered either
+    lock_guard<mutex> lock(deliveredMutex);
+    expect(delivered == expected, "delivered " + join(delivered) + " instead of " + join(expected));
+}
+
+// without the thread the command is sent before the call returns, on the calling thread
+static void checkSendsSynchronouslyWhileStopped()
+{
+    MockInputBackend backend;
+    InputDispatcherSettings settings;
+    settings.buttonHoldMillis = 0;
+    settings.keyHoldMillis = 0;
+    InputDispatcher dispatcher(backend, settings);
+
+    thread::id deliveredOn;
+    int deliveredCount = 0;
+    dispatcher.setDeliveredCallback([&](const InputCommand &command, long long deliveredMicros)
+        {
+            deliveredOn = this_thread::get_id();
+            deliveredCount++;
+        });
+
+    expect(!dispatcher.isRunning(), "dispatcher runs before start");
+
+    dispatcher.click(7, 8);
+    vector<InputEvent> events = backend.getEvents();
+    expect(events.size() == 3, "click while stopped sent " + to_string(events.size()) + " events instead of 3");
+    if (events.size() == 3)
+    {
+        expect(events[0].type == INPUT_EVENT_MOVE && events[0].x == 7 && events[0].y == 8, "click while stopped did not move to 7,8 first");
+        expect(events[1].type == INPUT_EVENT_BUTTON_DOWN && events[2].type == INPUT_EVENT_BUTTON_UP, "click while stopped is not button down then up");
+    }
+
+    dispatcher.pressKey(65);
+    events = backend.getEvents();
+    expect(events.size() == 5 && events[3].type == INPUT_EVENT_KEY_DOWN && events[4].type == INPUT_EVENT_KEY_UP && events[4].key == 65,
+        "key press while stopped was not sent");
+
+    expect(deliveredCount == 2, "delivered " + to_string(deliveredCount) + " commands while stopped instead of 2");
+    expect(deliveredOn == this_thread::get_id(), "delivered callback did not run on the calling thread while stopped");
+
+    // and the same dispatcher goes back to sending synchronously after a stop
+    dispatcher.start();
+    dispatcher.move(9, 9);
+    dispatcher.waitUntilIdle();
+    dispatcher.stop();
+    backend.clear();
+    dispatcher.move(10, 10);
+    expect(movedTo(backend.getEvents()) == vector<int>{ 10 }, "move after stop was not sent straight away");
+    expect(dispatcher.getDroppedCommands() == 0, "commands were dropped without a full queue");
+}
+
+int main()
+{
+    checkDropsOldestWhenFull();
+    checkSendsSynchronouslyWhileStopped();
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " input dispatcher checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Input dispatcher checks passed" << std::endl;
+    return 0;
+}
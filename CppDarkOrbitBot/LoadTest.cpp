@@ -0,0 +1,258 @@
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+
+#include "BotUtils.h"
+#include "BotCV.h"
+#include "Constants.h"
+#include "TemplateRegistry.h"
+#include "ThreadPool.h"
+#include "LoadTest.h"
+
+using namespace std;
+using namespace cv;
+
+// totals of one template over all the frames of one density, times in micros
+struct LoadTestTotals {
+    long long correlationMicros = 0;
+    long long candidateMicros = 0;
+    long long firstNmsMicros = 0;
+    long long mergeMicros = 0;
+    long long candidates = 0;
+    long long firstNmsKept = 0;
+    long long detections = 0;
+    long long labels = 0;
+    long long truePositives = 0;
+};
+
+// greedy matching in score order, each label can only be matched once
+static int countMatchedLabels(const vector<Rect> &detections, const vector<Rect> &labels, double iouThreshold)
+{
+    vector<bool> matched(labels.size(), false);
+    int truePositives = 0;
+
+    for (const Rect &detection : detections)
+    {
+        int bestLabel = -1;
+        double bestIoU = iouThreshold;
+        for (int j = 0; j < labels.size(); j++)
+        {
+            if (matched[j]) continue;
+            double iou = calculateIoU(detection, labels[j]);
+            if (iou >= bestIoU)
+            {
+                bestIoU = iou;
+                bestLabel = j;
+            }
+        }
+
+        if (bestLabel >= 0)
+        {
+            matched[bestLabel] = true;
+            truePositives++;
+        }
+    }
+
+    return truePositives;
+}
+
+// the same steps matchTemplatesParallel and matchSingleTemplate go through, on one thread so every step can be timed on its own
+static void measureTemplate(vector<vector<Mat>> &grid, const LoadTestSettings &settings, Template &matched,
+    const vector<Rect> &labels, LoadTestTotals &totals)
+{
+    int gridSizeX = grid[0][0].cols - settings.screenshotOffset;
+    int gridSizeY = grid[0][0].rows - settings.screenshotOffset;
+
+    vector<Rect> mergedRectangles;
+    vector<double> mergedConfidences;
+
+    for (int gridRow = 0; gridRow < grid.size(); gridRow++)
+    {
+        for (int gridColumn = 0; gridColumn < grid[gridRow].size(); gridColumn++)
+        {
+            long long stepStart = getCurrentMicros();
+            Mat result;
+            computeMatchResult(grid[gridRow][gridColumn], matched.grayscale, matched.alpha, matched.sparse, matched.fixedSizeKernel, matched.matchingMode, result);
+            totals.correlationMicros += computeTimePassed(stepStart, getCurrentMicros());
+
+            stepStart = getCurrentMicros();
+            vector<Rect> rectangles;
+            vector<double> confidences;
+            collectCandidates(result, matched.confidenceThreshold, matched.grayscale.size(), rectangles, confidences);
+            totals.candidateMicros += computeTimePassed(stepStart, getCurrentMicros());
+
+            stepStart = getCurrentMicros();
+            vector<int> keptIndexes;
+            applyBucketedNMS(rectangles, sortByScore(confidences), matched.grayscale.size(), 0.3, keptIndexes);
+            totals.firstNmsMicros += computeTimePassed(stepStart, getCurrentMicros());
+
+            totals.candidates += rectangles.size();
+            totals.firstNmsKept += keptIndexes.size();
+
+            // moving the kept matches into full frame coordinates, same offsets as matchTemplatesParallel
+            stepStart = getCurrentMicros();
+            int xOffset = gridColumn * gridSizeX + (gridColumn == 0 ? 0 : -settings.screenshotOffset);
+            int yOffset = gridRow * gridSizeY + (gridRow == 0 ? 0 : -settings.screenshotOffset);
+            for (int index : keptIndexes)
+            {
+                mergedRectangles.emplace_back(rectangles[index] + Point(xOffset, yOffset));
+                mergedConfidences.emplace_back(confidences[index]);
+            }
+            totals.mergeMicros += computeTimePassed(stepStart, getCurrentMicros());
+        }
+    }
+
+    long long mergeStart = getCurrentMicros();
+    vector<int> finalIndexes;
+    applyBucketedNMS(mergedRectangles, sortByScore(mergedConfidences), matched.grayscale.size(), 0.3, finalIndexes);
+    totals.mergeMicros += computeTimePassed(mergeStart, getCurrentMicros());
+
+    vector<Rect> detections;
+    for (int index : finalIndexes) detections.push_back(mergedRectangles[index]);
+
+    totals.detections += detections.size();
+    totals.labels += labels.size();
+    totals.truePositives += countMatchedLabels(detections, labels, settings.iouThreshold);
+}
+
+int runLoadTest(const LoadTestSettings &settings)
+{
+    long long loadTestStart = getCurrentMillis();
+
+    vector<Template> templates = createTemplatesFromRegistry();
+    loadImages(templates);
+    extractPngNames(templates);
+
+    // the resources the bot looks for are matched, every other template that can show up more than once is scattered as well
+    // so the matcher also has to reject lookalikes, the hud templates only show up as clutter
+    vector<Template> matchedTemplates;
+    vector<Template> sprites;
+    vector<Template> clutter;
+    for (Template &t : templates)
+    {
+        if (t.grayscale.empty()) continue;
+
+        const TemplateDescriptor &descriptor = TEMPLATE_REGISTRY[t.identifier];
+        if (descriptor.flags & TEMPLATE_HUD) clutter.push_back(t);
+        else if (t.multipleMatches) sprites.push_back(t);
+    }
+    for (TemplateIdentifier identifier : RESOURCE_TEMPLATES)
+    {
+        if (templates[identifier].grayscale.empty() || !templates[identifier].multipleMatches) continue;
+        matchedTemplates.push_back(templates[identifier]);
+    }
+
+    if (sprites.empty() || matchedTemplates.empty())
+    {
+        printWithTimestamp("No templates to load test with, the resource templates could not be loaded", RED_TEXT_BLACK_BACKGROUND);
+        return -1;
+    }
+
+    if (!settings.exportDirectory.empty())
+    {
+        error_code error;
+        filesystem::create_directories(settings.exportDirectory, error);
+    }
+
+    int threadCount = settings.threadCount > 0 ? settings.threadCount : max(1u, thread::hardware_concurrency());
+    ThreadPool threadPool(threadCount);
+    SyntheticWorldGenerator generator(sprites, clutter, settings.seed);
+
+    ofstream output(settings.outputPath);
+    if (!output.is_open())
+    {
+        printWithTimestamp("Could not write load test results to " + settings.outputPath, RED_TEXT_BLACK_BACKGROUND);
+        return -1;
+    }
+
+    output << fixed << setprecision(4);
+    output << "density,template,placed_objects,labels,candidates,first_nms_kept,detections,true_positives,recall,"
+        "correlation_ms,candidate_ms,first_nms_ms,merge_ms,parallel_ms,generation_ms\n";
+
+    printWithTimestamp("Load testing " + to_string(settings.densities.size()) + " densities, " + to_string(settings.framesPerDensity)
+        + " frames each", YELLOW_TEXT_BLACK_BACKGROUND);
+
+    // per frame nms and merge times of the previous density, to show how fast they grow
+    double previousDensity = 0;
+    double previousNmsMillis = 0;
+
+    for (int density : settings.densities)
+    {
+        SyntheticWorldSettings worldSettings = settings.world;
+        worldSettings.objectCount = density;
+
+        vector<LoadTestTotals> totals(matchedTemplates.size());
+        long long placedObjects = 0;
+        long long generationMicros = 0;
+        long long parallelMicros = 0;
+
+        for (int frameIndex = 0; frameIndex < settings.framesPerDensity; frameIndex++)
+        {
+            long long stepStart = getCurrentMicros();
+            SyntheticFrame frame;
+            generator.generate(worldSettings, frame);
+            generationMicros += computeTimePassed(stepStart, getCurrentMicros());
+
+            for (const vector<Rect> &labels : frame.labels) placedObjects += labels.size();
+
+            if (frameIndex == 0 && !settings.exportDirectory.empty())
+            {
+                string imagePath = (filesystem::path(settings.exportDirectory) / ("synthetic_" + to_string(density) + ".png")).string();
+                if (!saveSyntheticFrame(frame, templates, imagePath)) printWithTimestamp("Could not save " + imagePath, RED_TEXT_BLACK_BACKGROUND);
+            }
+
+            vector<vector<Mat>> grid = divideImage(frame.image, settings.screenshotGridColumns, settings.screenshotGridRows, settings.screenshotOffset);
+
+            for (int i = 0; i < matchedTemplates.size(); i++)
+            {
+                measureTemplate(grid, settings, matchedTemplates[i], frame.labels[matchedTemplates[i].identifier], totals[i]);
+            }
+
+            // the whole matching the way the bot runs it, on the thread pool
+            stepStart = getCurrentMicros();
+            vector<vector<TemplateMatch>> parallelMatches(matchedTemplates.size());
+            matchTemplatesParallel(frame.image, settings.screenshotOffset, grid, matchedTemplates, threadPool, parallelMatches);
+            parallelMicros += computeTimePassed(stepStart, getCurrentMicros());
+        }
+
+        double frames = max(1, settings.framesPerDensity);
+        for (int i = 0; i < matchedTemplates.size(); i++)
+        {
+            const LoadTestTotals &t = totals[i];
+            double recall = t.labels > 0 ? double(t.truePositives) / t.labels : 1.0;
+
+            output << density << "," << matchedTemplates[i].name << "," << placedObjects / frames << "," << t.labels / frames << ","
+                << t.candidates / frames << "," << t.firstNmsKept / frames << "," << t.detections / frames << "," << t.truePositives / frames << ","
+                << recall << "," << t.correlationMicros / frames / 1000 << "," << t.candidateMicros / frames / 1000 << ","
+                << t.firstNmsMicros / frames / 1000 << "," << t.mergeMicros / frames / 1000 << "," << parallelMicros / frames / 1000 << ","
+                << generationMicros / frames / 1000 << "\n";
+
+            // nms compares every kept box with every remaining candidate, the growth factor compared to the object growth
+            // shows whether a stage is still linear at this density
+            double nmsMillis = (t.firstNmsMicros + t.mergeMicros) / frames / 1000;
+            ostringstream summary;
+            summary << fixed << setprecision(2) << "Density " << density << ", " << matchedTemplates[i].name << ": "
+                << t.candidates / frames << " candidates, " << t.detections / frames << " detections, recall " << recall
+                << ", correlation " << t.correlationMicros / frames / 1000 << "ms, candidates " << t.candidateMicros / frames / 1000
+                << "ms, nms+merge " << nmsMillis << "ms, parallel " << parallelMicros / frames / 1000 << "ms";
+            if (i == 0 && previousDensity > 0 && previousNmsMillis > 0)
+            {
+                summary << " (x" << density / previousDensity << " objects, x" << nmsMillis / previousNmsMillis << " nms)";
+            }
+            printWithTimestamp(summary.str(), GREEN_TEXT_BLACK_BACKGROUND);
+
+            if (i == 0)
+            {
+                previousDensity = density;
+                previousNmsMillis = nmsMillis;
+            }
+        }
+    }
+
+    printWithTimestamp("Load test results written to " + settings.outputPath + " in " + to_string(computeTimePassed(loadTestStart, getCurrentMillis())) + "ms",
+        GREEN_TEXT_BLACK_BACKGROUND);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef LOAD_TEST
+#define LOAD_TEST
+
+#include <string>
+#include <vector>
+
+#include "SyntheticWorld.h"
+
+using namespace std;
+
+// offline load test of the detector on synthetic frames of increasing object density
+// every stage of the resource matching is timed separately so the ones that grow faster than the object count stand out
+struct LoadTestSettings {
+    vector<int> densities = { 0, 10, 25, 50, 100, 200, 400, 800 };
+    int framesPerDensity = 5;
+    unsigned int seed = 1;                          // fixed so runs can be compared, 0 for a random one
+    SyntheticWorldSettings world;
+    int screenshotGridColumns = 4;                  // same grid as the live bot
+    int screenshotGridRows = 3;
+    int screenshotOffset = 50;
+    int threadCount = 0;                            // 0 for one per core
+    double iouThreshold = 0.5;                      // overlap needed for a detection to count as a label
+    string outputPath = "load_test.csv";
+    string exportDirectory;                         // when set the first frame of every density is saved there with its labels
+};
+
+// returns the process exit code
+int runLoadTest(const LoadTestSettings &settings);
+
+#endif
@@ -0,0 +1,438 @@
+// winsock2 has to be included before windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "BotUtils.h"
+#include "Constants.h"
+#include "Metrics.h"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+using namespace std;
+
+static const vector<double> MILLISECOND_BUCKETS = { 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000 };
+// a few seconds of frames, enough for a stable p95 that still follows changes
+static const size_t LATENCY_WINDOW_SIZE = 512;
+
+static string escapeLabelValue(const string &value)
+{
+    string escaped;
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"') escaped += '\\';
+        if (c == '\n')
+        {
+            escaped += "\\n";
+            continue;
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+Histogram::Histogram(const vector<double> &bounds) : bounds_(bounds), bucketCounts_(bounds.size(), 0), count_(0), sum_(0)
+{
+}
+
+void Histogram::observe(double value)
+{
+    for (int i = 0; i < bounds_.size(); i++)
+    {
+        if (value <= bounds_[i]) bucketCounts_[i]++;
+    }
+    count_++;
+    sum_ += value;
+}
+
+void Histogram::render(ostringstream &output, const string &name, const string &labels) const
+{
+    string separator = labels.empty() ? "" : ",";
+
+    for (int i = 0; i < bounds_.size(); i++)
+    {
+        output << name << "_bucket{" << labels << separator << "le=\"" << bounds_[i] << "\"} " << bucketCounts_[i] << "\n";
+    }
+    output << name << "_bucket{" << labels << separator << "le=\"+Inf\"} " << count_ << "\n";
+
+    string braces = labels.empty() ? "" : "{" + labels + "}";
+    output << name << "_sum" << braces << " " << sum_ << "\n";
+    output << name << "_count" << braces << " " << count_ << "\n";
+}
+
+LatencyWindow::LatencyWindow(size_t capacity) : capacity_(capacity), next_(0)
+{
+    samples_.reserve(capacity);
+}
+
+void LatencyWindow::add(long long micros)
+{
+    if (samples_.size() < capacity_) samples_.push_back(micros);
+    else samples_[next_] = micros;
+    next_ = (next_ + 1) % capacity_;
+}
+
+long long LatencyWindow::percentile(double p) const
+{
+    if (samples_.empty()) return 0;
+
+    vector<long long> sorted = samples_;
+    size_t index = min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5));
+    nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+size_t LatencyWindow::size() const
+{
+    return samples_.size();
+}
+
+// the pool keeps power of two microsecond buckets, rendered cumulative like every other histogram here
+static void renderPowerOfTwoHistogram(ostringstream &output, const string &name, const vector<unsigned long long> &buckets)
+{
+    unsigned long long cumulative = 0;
+    for (int i = 0; i + 1 < buckets.size(); i++)
+    {
+        cumulative += buckets[i];
+        output << name << "_bucket{le=\"" << (1LL << i) / 1000.0 << "\"} " << cumulative << "\n";
+    }
+    if (!buckets.empty()) cumulative += buckets.back();
+    output << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    output << name << "_count " << cumulative << "\n";
+}
+
+static LatencySummary summarize(const LatencyWindow &window)
+{
+    LatencySummary summary;
+    summary.p50Micros = window.percentile(0.5);
+    summary.p95Micros = window.percentile(0.95);
+    summary.maxMicros = window.percentile(1.0);
+    summary.samples = window.size();
+    return summary;
+}
+
+BotMetrics::BotMetrics() : frames_(0), currentFPS_(0), frameDuration_(MILLISECOND_BUCKETS), currentStatus_(SCANNING),
+    workerBusyMicros_(0), workerThreads_(0), lastWorkerBusyMicros_(0), lastWorkerSampleMicros_(0), workerUtilization_(0),
+    captureToDecision_(MILLISECOND_BUCKETS), captureToClick_(MILLISECOND_BUCKETS),
+    recentCaptureToDecision_(LATENCY_WINDOW_SIZE), recentCaptureToClick_(LATENCY_WINDOW_SIZE)
+{
+}
+
+void BotMetrics::recordFrame(long long frameMillis)
+{
+    lock_guard<mutex> lock(mutex_);
+    frames_++;
+    currentFPS_ = frameMillis > 0 ? 1000.0 / frameMillis : 0;
+    frameDuration_.observe(double(frameMillis));
+}
+
+void BotMetrics::recordStageLatencies(const vector<string> &stages, const vector<long long> &stageMicros)
+{
+    lock_guard<mutex> lock(mutex_);
+    for (int i = 0; i < stages.size() && i < stageMicros.size(); i++)
+    {
+        auto stage = stageLatencies_.find(stages[i]);
+        if (stage == stageLatencies_.end()) stage = stageLatencies_.emplace(stages[i], Histogram(MILLISECOND_BUCKETS)).first;
+        stage->second.observe(stageMicros[i] / 1000.0);
+    }
+}
+
+void BotMetrics::recordDetections(const string &templateName, int count)
+{
+    lock_guard<mutex> lock(mutex_);
+    detectionsTotal_[templateName] += count;
+    detectionsCurrent_[templateName] = count;
+}
+
+void BotMetrics::recordStatus(BotStatus status, long long millisInStatus)
+{
+    lock_guard<mutex> lock(mutex_);
+    currentStatus_ = status;
+    statusSeconds_[status] += millisInStatus / 1000.0;
+}
+
+void BotMetrics::recordStatusTransition(BotStatus from, BotStatus to)
+{
+    lock_guard<mutex> lock(mutex_);
+    statusTransitions_[make_pair(from, to)]++;
+}
+
+void BotMetrics::recordWorkerUsage(long long busyMicros, size_t threadCount)
+{
+    lock_guard<mutex> lock(mutex_);
+    long long now = getCurrentMicros();
+
+    // utilization since the previous sample, busy time of all workers over the time all of them could have been busy
+    if (lastWorkerSampleMicros_ != 0 && now > lastWorkerSampleMicros_ && threadCount > 0)
+    {
+        workerUtilization_ = double(busyMicros - lastWorkerBusyMicros_) / (double(now - lastWorkerSampleMicros_) * threadCount);
+    }
+
+    workerBusyMicros_ = busyMicros;
+    workerThreads_ = threadCount;
+    lastWorkerBusyMicros_ = busyMicros;
+    lastWorkerSampleMicros_ = now;
+}
+
+void BotMetrics::recordCaptureToDecision(long long micros)
+{
+    lock_guard<mutex> lock(mutex_);
+    captureToDecision_.observe(micros / 1000.0);
+    recentCaptureToDecision_.add(micros);
+}
+
+void BotMetrics::recordCaptureToClick(long long micros)
+{
+    lock_guard<mutex> lock(mutex_);
+    captureToClick_.observe(micros / 1000.0);
+    recentCaptureToClick_.add(micros);
+}
+
+void BotMetrics::recordThreadPool(const ThreadPoolStats &stats)
+{
+    lock_guard<mutex> lock(mutex_);
+    threadPool_ = stats;
+}
+
+LatencySummary BotMetrics::getCaptureToDecision() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return summarize(recentCaptureToDecision_);
+}
+
+LatencySummary BotMetrics::getCaptureToClick() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return summarize(recentCaptureToClick_);
+}
+
+string BotMetrics::renderPrometheus() const
+{
+    lock_guard<mutex> lock(mutex_);
+    ostringstream output;
+    output << fixed << setprecision(6);
+
+    output << "# HELP darkorbit_bot_frames_total Frames processed by the main loop.\n";
+    output << "# TYPE darkorbit_bot_frames_total counter\n";
+    output << "darkorbit_bot_frames_total " << frames_ << "\n";
+
+    output << "# HELP darkorbit_bot_frame_rate Frame rate of the last frame.\n";
+    output << "# TYPE darkorbit_bot_frame_rate gauge\n";
+    output << "darkorbit_bot_frame_rate " << currentFPS_ << "\n";
+
+    output << "# HELP darkorbit_bot_frame_duration_milliseconds Duration of a whole main loop iteration.\n";
+    output << "# TYPE darkorbit_bot_frame_duration_milliseconds histogram\n";
+    frameDuration_.render(output, "darkorbit_bot_frame_duration_milliseconds", "");
+
+    output << "# HELP darkorbit_bot_stage_duration_milliseconds Duration of every profiled step of the main loop.\n";
+    output << "# TYPE darkorbit_bot_stage_duration_milliseconds histogram\n";
+    for (const auto &stage : stageLatencies_)
+    {
+        stage.second.render(output, "darkorbit_bot_stage_duration_milliseconds", "stage=\"" + escapeLabelValue(stage.first) + "\"");
+    }
+
+    output << "# HELP darkorbit_bot_detections_total Matches found per template over all frames.\n";
+    output << "# TYPE darkorbit_bot_detections_total counter\n";
+    for (const auto &detections : detectionsTotal_)
+    {
+        output << "darkorbit_bot_detections_total{template=\"" << escapeLabelValue(detections.first) << "\"} " << detections.second << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_detections Matches found per template in the last frame.\n";
+    output << "# TYPE darkorbit_bot_detections gauge\n";
+    for (const auto &detections : detectionsCurrent_)
+    {
+        output << "darkorbit_bot_detections{template=\"" << escapeLabelValue(detections.first) << "\"} " << detections.second << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_status Current bot status, 1 for the active one.\n";
+    output << "# TYPE darkorbit_bot_status gauge\n";
+    for (BotStatus status : { SCANNING, MOVING, COLLECTING, TRAVELING })
+    {
+        output << "darkorbit_bot_status{status=\"" << botStatusEnumToString(status) << "\"} " << (status == currentStatus_ ? 1 : 0) << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_status_seconds_total Time spent in every bot status.\n";
+    output << "# TYPE darkorbit_bot_status_seconds_total counter\n";
+    for (const auto &status : statusSeconds_)
+    {
+        output << "darkorbit_bot_status_seconds_total{status=\"" << botStatusEnumToString(status.first) << "\"} " << status.second << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_status_transitions_total Transitions of the bot state machine.\n";
+    output << "# TYPE darkorbit_bot_status_transitions_total counter\n";
+    for (const auto &transition : statusTransitions_)
+    {
+        output << "darkorbit_bot_status_transitions_total{from=\"" << botStatusEnumToString(transition.first.first)
+            << "\",to=\"" << botStatusEnumToString(transition.first.second) << "\"} " << transition.second << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_worker_busy_seconds_total Time all worker threads together spent running tasks.\n";
+    output << "# TYPE darkorbit_bot_worker_busy_seconds_total counter\n";
+    output << "darkorbit_bot_worker_busy_seconds_total " << workerBusyMicros_ / 1000000.0 << "\n";
+
+    output << "# HELP darkorbit_bot_worker_threads Number of worker threads in the pool.\n";
+    output << "# TYPE darkorbit_bot_worker_threads gauge\n";
+    output << "darkorbit_bot_worker_threads " << workerThreads_ << "\n";
+
+    output << "# HELP darkorbit_bot_worker_utilization Fraction of the worker time spent running tasks during the last frame.\n";
+    output << "# TYPE darkorbit_bot_worker_utilization gauge\n";
+    output << "darkorbit_bot_worker_utilization " << workerUtilization_ << "\n";
+
+    output << "# HELP darkorbit_bot_capture_to_decision_milliseconds Time from capturing a frame until the bot decided on it.\n";
+    output << "# TYPE darkorbit_bot_capture_to_decision_milliseconds histogram\n";
+    captureToDecision_.render(output, "darkorbit_bot_capture_to_decision_milliseconds", "");
+
+    output << "# HELP darkorbit_bot_capture_to_click_milliseconds Time from capturing a frame until the click decided on it was released.\n";
+    output << "# TYPE darkorbit_bot_capture_to_click_milliseconds histogram\n";
+    captureToClick_.render(output, "darkorbit_bot_capture_to_click_milliseconds", "");
+
+    output << "# HELP darkorbit_bot_pool_queue_depth Tasks waiting in the thread pool queue.\n";
+    output << "# TYPE darkorbit_bot_pool_queue_depth gauge\n";
+    output << "darkorbit_bot_pool_queue_depth " << threadPool_.queueDepth << "\n";
+
+    output << "# HELP darkorbit_bot_pool_queue_depth_max Deepest the thread pool queue got.\n";
+    output << "# TYPE darkorbit_bot_pool_queue_depth_max gauge\n";
+    output << "darkorbit_bot_pool_queue_depth_max " << threadPool_.maxQueueDepth << "\n";
+
+    output << "# HELP darkorbit_bot_pool_queue_depth_average Average queue depth seen by every enqueue.\n";
+    output << "# TYPE darkorbit_bot_pool_queue_depth_average gauge\n";
+    output << "darkorbit_bot_pool_queue_depth_average " << threadPool_.averageQueueDepth() << "\n";
+
+    output << "# HELP darkorbit_bot_pool_worker_busy_seconds_total Time every worker spent running tasks.\n";
+    output << "# TYPE darkorbit_bot_pool_worker_busy_seconds_total counter\n";
+    for (int i = 0; i < threadPool_.workerBusyMicros.size(); i++)
+    {
+        output << "darkorbit_bot_pool_worker_busy_seconds_total{worker=\"" << i << "\"} " << threadPool_.workerBusyMicros[i] / 1000000.0 << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_pool_worker_idle_seconds_total Time every worker spent waiting for a task.\n";
+    output << "# TYPE darkorbit_bot_pool_worker_idle_seconds_total counter\n";
+    for (int i = 0; i < threadPool_.workerIdleMicros.size(); i++)
+    {
+        output << "darkorbit_bot_pool_worker_idle_seconds_total{worker=\"" << i << "\"} " << threadPool_.workerIdleMicros[i] / 1000000.0 << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_pool_worker_tasks_total Tasks run by every worker.\n";
+    output << "# TYPE darkorbit_bot_pool_worker_tasks_total counter\n";
+    for (int i = 0; i < threadPool_.workerTasks.size(); i++)
+    {
+        output << "darkorbit_bot_pool_worker_tasks_total{worker=\"" << i << "\"} " << threadPool_.workerTasks[i] << "\n";
+    }
+
+    output << "# HELP darkorbit_bot_pool_queue_wait_milliseconds Time from enqueueing a task until a worker started it.\n";
+    output << "# TYPE darkorbit_bot_pool_queue_wait_milliseconds histogram\n";
+    renderPowerOfTwoHistogram(output, "darkorbit_bot_pool_queue_wait_milliseconds", threadPool_.queueWaitBuckets);
+
+    output << "# HELP darkorbit_bot_pool_task_duration_milliseconds Run time of the thread pool tasks.\n";
+    output << "# TYPE darkorbit_bot_pool_task_duration_milliseconds histogram\n";
+    renderPowerOfTwoHistogram(output, "darkorbit_bot_pool_task_duration_milliseconds", threadPool_.runTimeBuckets);
+
+    output << "# HELP darkorbit_bot_pool_contended_locks_total Queue lock acquisitions that had to wait for another thread.\n";
+    output << "# TYPE darkorbit_bot_pool_contended_locks_total counter\n";
+    output << "darkorbit_bot_pool_contended_locks_total " << threadPool_.contendedLocks << "\n";
+
+    output << "# HELP darkorbit_bot_pool_parallel_chunks_total Chunks of parallelFor batches by the thread that ran them.\n";
+    output << "# TYPE darkorbit_bot_pool_parallel_chunks_total counter\n";
+    output << "darkorbit_bot_pool_parallel_chunks_total{thread=\"caller\"} " << threadPool_.callerChunks << "\n";
+    output << "darkorbit_bot_pool_parallel_chunks_total{thread=\"worker\"} " << threadPool_.workerChunks << "\n";
+
+    output << "# HELP darkorbit_bot_pool_missed_deadlines_total parallelFor batches that ran past their deadline.\n";
+    output << "# TYPE darkorbit_bot_pool_missed_deadlines_total counter\n";
+    output << "darkorbit_bot_pool_missed_deadlines_total " << threadPool_.missedDeadlines << "\n";
+
+    output << "# HELP darkorbit_bot_pool_skipped_indexes_total Optional parallelFor indexes never started because the deadline passed.\n";
+    output << "# TYPE darkorbit_bot_pool_skipped_indexes_total counter\n";
+    output << "darkorbit_bot_pool_skipped_indexes_total " << threadPool_.skippedIndexes << "\n";
+
+    return output.str();
+}
+
+MetricsServer::MetricsServer(BotMetrics &metrics, int port) : metrics_(metrics), port_(port), running_(false)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+void MetricsServer::start()
+{
+    if (running_) return;
+
+    running_ = true;
+    serverThread_ = thread(&MetricsServer::serve, this);
+}
+
+void MetricsServer::stop()
+{
+    running_ = false;
+    if (serverThread_.joinable()) serverThread_.join();
+}
+
+void MetricsServer::serve()
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        printWithTimestamp("Metrics server failed to initialise winsock", RED_TEXT_BLACK_BACKGROUND);
+        return;
+    }
+
+    SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port_);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    if (listenSocket == INVALID_SOCKET
+        || bind(listenSocket, (sockaddr *)&address, sizeof(address)) == SOCKET_ERROR
+        || listen(listenSocket, SOMAXCONN) == SOCKET_ERROR)
+    {
+        printWithTimestamp("Metrics server could not listen on port " + to_string(port_), RED_TEXT_BLACK_BACKGROUND);
+        if (listenSocket != INVALID_SOCKET) closesocket(listenSocket);
+        WSACleanup();
+        return;
+    }
+
+    printWithTimestamp("Metrics available at http://127.0.0.1:" + to_string(port_) + "/metrics", YELLOW_TEXT_BLACK_BACKGROUND);
+
+    while (running_)
+    {
+        // waiting with a timeout so stop() doesnt have to wait for a scrape to come in
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(listenSocket, &readSet);
+        timeval timeout = { 0, 200000 };
+        if (select(0, &readSet, nullptr, nullptr, &timeout) <= 0) continue;
+
+        SOCKET client = accept(listenSocket, nullptr, nullptr);
+        if (client == INVALID_SOCKET) continue;
+
+        // a client that connects and never sends would otherwise block the recv below and stop() with it
+        DWORD clientTimeoutMillis = 500;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char *)&clientTimeoutMillis, sizeof(clientTimeoutMillis));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char *)&clientTimeoutMillis, sizeof(clientTimeoutMillis));
+
+        // every request gets the metrics, the request itself is only read so the client doesnt see a reset
+        char request[1024];
+        recv(client, request, sizeof(request), 0);
+
+        string body = metrics_.renderPrometheus();
+        string response = "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + to_string(body.size()) + "\r\n"
+            "Connection: close\r\n\r\n" + body;
+
+        send(client, response.data(), int(response.size()), 0);
+        shutdown(client, SD_SEND);
+        closesocket(client);
+    }
+
+    closesocket(listenSocket);
+    WSACleanup();
+}
@@ -0,0 +1,125 @@
+#ifndef METRICS
+#define METRICS
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BotUtils.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// cumulative histogram in the prometheus layout, every bucket counts the observations less or equal to its bound
+class Histogram {
+public:
+    explicit Histogram(const vector<double> &bounds);
+
+    void observe(double value);
+    void render(ostringstream &output, const string &name, const string &labels) const;
+
+private:
+    vector<double> bounds_;
+    vector<unsigned long long> bucketCounts_;
+    unsigned long long count_;
+    double sum_;
+};
+
+// the most recent samples of a latency, the histograms only keep bucket counts so percentiles for the overlay come from here
+class LatencyWindow {
+public:
+    explicit LatencyWindow(size_t capacity);
+
+    void add(long long micros);
+    // p between 0 and 1, 0 when nothing was added yet
+    long long percentile(double p) const;
+    size_t size() const;
+
+private:
+    vector<long long> samples_;
+    size_t capacity_;
+    size_t next_;
+};
+
+struct LatencySummary {
+    long long p50Micros = 0;
+    long long p95Micros = 0;
+    long long maxMicros = 0;
+    size_t samples = 0;
+};
+
+// everything the bot exposes about itself, updated from the main loop and read by the metrics server
+class BotMetrics {
+public:
+    BotMetrics();
+
+    void recordFrame(long long frameMillis);
+    void recordStageLatencies(const vector<string> &stages, const vector<long long> &stageMicros);
+    void recordDetections(const string &templateName, int count);
+    void recordStatus(BotStatus status, long long millisInStatus);
+    void recordStatusTransition(BotStatus from, BotStatus to);
+    void recordWorkerUsage(long long busyMicros, size_t threadCount);
+    // both measured from the moment the frame the decision was made on was captured
+    void recordCaptureToDecision(long long micros);
+    void recordCaptureToClick(long long micros);
+    void recordThreadPool(const ThreadPoolStats &stats);
+
+    LatencySummary getCaptureToDecision() const;
+    LatencySummary getCaptureToClick() const;
+
+    string renderPrometheus() const;
+
+private:
+    mutable mutex mutex_;
+
+    unsigned long long frames_;
+    double currentFPS_;
+    Histogram frameDuration_;
+
+    map<string, Histogram> stageLatencies_;
+
+    map<string, unsigned long long> detectionsTotal_;
+    map<string, int> detectionsCurrent_;
+
+    BotStatus currentStatus_;
+    map<BotStatus, double> statusSeconds_;
+    map<pair<BotStatus, BotStatus>, unsigned long long> statusTransitions_;
+
+    long long workerBusyMicros_;
+    size_t workerThreads_;
+    long long lastWorkerBusyMicros_;
+    long long lastWorkerSampleMicros_;
+    double workerUtilization_;
+
+    Histogram captureToDecision_;
+    Histogram captureToClick_;
+    LatencyWindow recentCaptureToDecision_;
+    LatencyWindow recentCaptureToClick_;
+
+    ThreadPoolStats threadPool_;
+};
+
+// serves BotMetrics in the prometheus text format on 127.0.0.1, so it can only be scraped from the same machine
+class MetricsServer {
+public:
+    MetricsServer(BotMetrics &metrics, int port);
+    ~MetricsServer();
+
+    void start();
+    void stop();
+
+private:
+    BotMetrics &metrics_;
+    int port_;
+
+    atomic<bool> running_;
+    thread serverThread_;
+
+    void serve();
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+#include "MinimapAnalyzer.h"
+
+using namespace std;
+using namespace cv;
+
+MinimapAnalyzer::MinimapAnalyzer(const MinimapAnalyzerSettings &settings) : settings_(settings)
+{
+}
+
+Rect MinimapAnalyzer::innerRect(Size minimapSize) const
+{
+    int top = max(settings_.borderMargin, settings_.headerHeight);
+    return Rect(settings_.borderMargin, top, minimapSize.width - 2 * settings_.borderMargin, minimapSize.height - top - settings_.borderMargin);
+}
+
+bool MinimapAnalyzer::analyze(const Mat &minimap, MinimapReading &reading)
+{
+    reading = MinimapReading();
+    if (minimap.empty() || minimap.channels() != 3) return false;
+
+    // the header text is as white as the ship, left in it would pull the centroid up
+    Rect inner = innerRect(minimap.size());
+    if (inner.width <= 0 || inner.height <= 0) return false;
+    Mat view = minimap(inner);
+
+    // the ship is either a dot or the outline of the visible area, the centroid of its pixels is the ship in both cases
+    inRange(view, settings_.shipLower, settings_.shipUpper, shipMask_);
+    Moments shipMoments = moments(shipMask_, true);
+    if (shipMoments.m00 <= 0) return false;
+
+    reading.shipFound = true;
+    reading.ship = Point2d(shipMoments.m10 / shipMoments.m00 + inner.x, shipMoments.m01 / shipMoments.m00 + inner.y);
+
+    // the outline of the visible area is the biggest white shape, a lone pixel or the ship dot is not it
+    Rect2d outline;
+    int shapes = connectedComponentsWithStats(shipMask_, labels_, stats_, centroids_, 8, CV_32S);
+    for (int i = 1; i < shapes; i++)
+    {
+        Rect2d shape(stats_.at<int>(i, CC_STAT_LEFT) + inner.x, stats_.at<int>(i, CC_STAT_TOP) + inner.y,
+            stats_.at<int>(i, CC_STAT_WIDTH), stats_.at<int>(i, CC_STAT_HEIGHT));
+        if (shape.area() > outline.area()) outline = shape;
+    }
+
+    Size2d expected = settings_.viewportSize;
+    if (outline.width > 2 && outline.height > 2 && outline.width >= expected.width / 2 && outline.height >= expected.height / 2)
+    {
+        reading.viewport = outline;
+    }
+    else
+    {
+        reading.viewport = Rect2d(reading.ship.x - expected.width / 2, reading.ship.y - expected.height / 2, expected.width, expected.height);
+    }
+
+    inRange(view, settings_.resourceLower, settings_.resourceUpper, resourceMask_);
+    int components = connectedComponentsWithStats(resourceMask_, labels_, stats_, centroids_, 8, CV_32S);
+
+    // label 0 is the background
+    for (int i = 1; i < components; i++)
+    {
+        int area = stats_.at<int>(i, CC_STAT_AREA);
+        if (area < settings_.minimumDotArea || area > settings_.maximumDotArea) continue;
+
+        reading.dots.emplace_back(centroids_.at<double>(i, 0) + inner.x, centroids_.at<double>(i, 1) + inner.y);
+    }
+
+    Point2d ship = reading.ship;
+    sort(reading.dots.begin(), reading.dots.end(), [ship](const Point2d &a, const Point2d &b)
+        {
+            return norm(a - ship) < norm(b - ship);
+        });
+
+    for (const Point2d &dot : reading.dots)
+    {
+        // dots inside the viewport are already in the main view, the screen matching handles them
+        if (reading.viewport.contains(dot)) continue;
+
+        reading.targetFound = true;
+        reading.target = dot;
+        break;
+    }
+
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef MINIMAP_ANALYZER
+#define MINIMAP_ANALYZER
+
+#include <opencv2/core/types.hpp>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+// bgr color ranges, a pixel belongs to a marker when every channel is inside the range
+struct MinimapAnalyzerSettings {
+    Scalar shipLower = Scalar(200, 200, 200);       // the ship and the white rectangle of the visible area around it
+    Scalar shipUpper = Scalar(255, 255, 255);
+    Scalar resourceLower = Scalar(150, 110, 0);     // the cyan dots of resources and fields
+    Scalar resourceUpper = Scalar(255, 230, 90);
+    int minimumDotArea = 2;                         // smaller blobs are compression noise or map grid lines crossing
+    int maximumDotArea = 200;                       // bigger ones are map decoration or the legend, not a dot
+    int borderMargin = 3;                           // the minimap frame is drawn in the ship color, it is skipped
+    int headerHeight = 0;                           // rows at the top with the white map name and buttons, set from the minimap templates
+    Size2d viewportSize = Size2d(0, 0);             // the screen in minimap pixels, used around the ship when the outline is not drawn
+};
+
+struct MinimapReading {
+    bool shipFound = false;
+    Point2d ship;                   // minimap coordinates
+    vector<Point2d> dots;           // minimap coordinates, closest to the ship first
+    Rect2d viewport;                // minimap coordinates, the part of the map that is on screen right now
+
+    bool targetFound = false;
+    Point2d target;                 // the closest dot outside the viewport
+};
+
+// reads the ship position and the resource dots from the color minimap, only a few thousand pixels so it can run every frame
+class MinimapAnalyzer {
+public:
+    explicit MinimapAnalyzer(const MinimapAnalyzerSettings &settings);
+
+    // minimap is the BGR minimap region, returns false when it is empty or the ship could not be found
+    bool analyze(const Mat &minimap, MinimapReading &reading);
+
+    // the part of the minimap that shows the map, below the header and inside the border
+    Rect innerRect(Size minimapSize) const;
+
+private:
+    MinimapAnalyzerSettings settings_;
+
+    Mat shipMask_;
+    Mat resourceMask_;
+    Mat labels_;
+    Mat stats_;
+    Mat centroids_;
+};
+
+#endif
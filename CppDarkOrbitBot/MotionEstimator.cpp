@@ -0,0 +1,65 @@
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "MotionEstimator.h"
+
+using namespace std;
+using namespace cv;
+
+MotionEstimator::MotionEstimator(const MotionEstimatorSettings &settings) : settings_(settings), lastResponse_(0)
+{
+    if (settings_.decimation < 1) settings_.decimation = 1;
+}
+
+void MotionEstimator::prepare(const Mat &grayscaleFrame, Mat &prepared)
+{
+    Mat small;
+    resize(grayscaleFrame, small, Size(grayscaleFrame.cols / settings_.decimation, grayscaleFrame.rows / settings_.decimation), 0, 0, INTER_AREA);
+    small.convertTo(prepared, CV_32F);
+
+    // the static regions are filled with the mean so they dont add edges of their own
+    Scalar fill = mean(prepared);
+    Rect frameRect(0, 0, prepared.cols, prepared.rows);
+    for (const Rect &region : settings_.staticRegions)
+    {
+        Rect scaled(region.x / settings_.decimation, region.y / settings_.decimation,
+            (region.width + settings_.decimation - 1) / settings_.decimation, (region.height + settings_.decimation - 1) / settings_.decimation);
+        scaled &= frameRect;
+        if (scaled.area() > 0) prepared(scaled).setTo(fill);
+    }
+
+    // the hanning window keeps the frame borders from dominating the spectrum
+    if (window_.size() != prepared.size()) createHanningWindow(window_, prepared.size(), CV_32F);
+}
+
+bool MotionEstimator::update(const Mat &grayscaleFrame, Point2d &shift)
+{
+    Mat current;
+    prepare(grayscaleFrame, current);
+
+    if (previous_.empty() || previous_.size() != current.size())
+    {
+        previous_ = current;
+        lastResponse_ = 0;
+        return false;
+    }
+
+    Point2d smallShift = phaseCorrelate(previous_, current, window_, &lastResponse_);
+    previous_ = current;
+
+    if (lastResponse_ < settings_.minimumResponse) return false;
+
+    shift = Point2d(smallShift.x * settings_.decimation, smallShift.y * settings_.decimation);
+    return true;
+}
+
+void MotionEstimator::reset()
+{
+    previous_.release();
+    lastResponse_ = 0;
+}
+
+double MotionEstimator::getLastResponse() const
+{
+    return lastResponse_;
+}
@@ -0,0 +1,40 @@
+#ifndef MOTION_ESTIMATOR
+#define MOTION_ESTIMATOR
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+struct MotionEstimatorSettings {
+    int decimation = 4;                   // the frame is shrunk by this factor before correlating
+    double minimumResponse = 0.1;         // phase correlation peaks weaker than this are treated as unknown motion
+    vector<Rect> staticRegions;           // hud and the ship, in full resolution coordinates, they dont scroll with the background
+};
+
+// estimates how far the background scrolled between two consecutive frames with phase correlation
+// the static regions are flattened out before correlating so the hud doesnt pull the estimate towards zero
+class MotionEstimator {
+public:
+    explicit MotionEstimator(const MotionEstimatorSettings &settings);
+
+    // shift is how far the content of this frame moved compared to the previous one, in full resolution pixels
+    // returns false on the first frame, after reset or when the correlation peak is too weak to be trusted
+    bool update(const Mat &grayscaleFrame, Point2d &shift);
+    void reset();
+
+    double getLastResponse() const;
+
+private:
+    MotionEstimatorSettings settings_;
+
+    Mat previous_;
+    Mat window_;
+    double lastResponse_;
+
+    void prepare(const Mat &grayscaleFrame, Mat &prepared);
+};
+
+#endif
@@ -0,0 +1,348 @@
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/utility.hpp>
+#include <immintrin.h>
+#include <algorithm>
+
+#include "NccEngine.h"
+
+using namespace std;
+using namespace cv;
+
+// msvc allows intrinsics of any instruction set in any function, gcc and clang need them enabled per function
+#if defined(_MSC_VER)
+#define NCC_TARGET_AVX2
+#else
+#define NCC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+typedef void (*NccWindowSums)(const Mat &rowSums, const Mat &rowSquareSums, Point origin, const vector<NccRun> &runs, int count, int *sums, int *squareSums);
+typedef void (*NccProducts)(const uchar *origin, const ptrdiff_t *offsets, const NccGroup &group, long long *products);
+
+bool buildNccTemplate(const Mat &grayscale, const Mat &alpha, NccTemplate &ncc)
+{
+    ncc = NccTemplate();
+
+    if (grayscale.empty() || grayscale.type() != CV_8UC1) return false;
+    if (!alpha.empty() && (alpha.type() != CV_8UC1 || alpha.size() != grayscale.size())) return false;
+
+    ncc.width = grayscale.cols;
+    ncc.height = grayscale.rows;
+    ncc.weights.assign(size_t(ncc.width) * ncc.height, short(0));
+
+    for (int y = 0; y < grayscale.rows; y++)
+    {
+        const uchar *grayRow = grayscale.ptr<uchar>(y);
+        const uchar *alphaRow = alpha.empty() ? nullptr : alpha.ptr<uchar>(y);
+
+        int x = 0;
+        while (x < grayscale.cols)
+        {
+            if (alphaRow && alphaRow[x] == 0)
+            {
+                x++;
+                continue;
+            }
+
+            NccRun run = { y, x, 0 };
+            while (x < grayscale.cols && (!alphaRow || alphaRow[x] != 0))
+            {
+                ncc.weights[y * ncc.width + x] = grayRow[x];
+                ncc.sum += grayRow[x];
+                ncc.sumSquares += double(grayRow[x]) * grayRow[x];
+                run.count++;
+                x++;
+            }
+
+            ncc.pixelCount += run.count;
+            ncc.runs.emplace_back(run);
+        }
+    }
+
+    if (ncc.pixelCount == 0 || ncc.pixelCount > NCC_MAX_PIXELS)
+    {
+        ncc = NccTemplate();
+        return false;
+    }
+
+    return true;
+}
+
+bool isNccMatchModeSupported(TemplateMatchModes matchMode)
+{
+    return isSparseMatchModeSupported(matchMode);
+}
+
+void buildNccGroup(const vector<const NccTemplate *> &members, NccGroup &group)
+{
+    group = NccGroup();
+    if (members.empty()) return;
+
+    CV_Assert(members.size() <= NCC_MAX_GROUP_SIZE);
+
+    group.width = members[0]->width;
+    group.height = members[0]->height;
+    group.members = members;
+
+    // members with the same runs read the same pixels, so the first of them computes the window sums for all
+    for (int k = 0; k < members.size(); k++)
+    {
+        CV_Assert(members[k]->width == group.width && members[k]->height == group.height);
+
+        int footprint = k;
+        for (int j = 0; j < k; j++)
+        {
+            if (group.footprints[j] == j && members[j]->runs == members[k]->runs)
+            {
+                footprint = j;
+                break;
+            }
+        }
+        group.footprints.push_back(footprint);
+    }
+
+    // the products are accumulated over every pixel that is opaque in at least one member
+    vector<bool> opaque(size_t(group.width) * group.height, false);
+    for (const NccTemplate *member : members)
+    {
+        for (const NccRun &run : member->runs)
+        {
+            for (int i = 0; i < run.count; i++) opaque[run.dy * group.width + run.dx + i] = true;
+        }
+    }
+
+    for (int y = 0; y < group.height; y++)
+    {
+        int x = 0;
+        while (x < group.width)
+        {
+            if (!opaque[y * group.width + x])
+            {
+                x++;
+                continue;
+            }
+
+            SparseChunk chunk = { y, x, 0 };
+            while (x < group.width && opaque[y * group.width + x] && chunk.count < SPARSE_CHUNK_WIDTH)
+            {
+                chunk.count++;
+                x++;
+            }
+
+            for (const NccTemplate *member : members)
+            {
+                for (int i = 0; i < SPARSE_CHUNK_WIDTH; i++)
+                {
+                    group.weights.emplace_back(i < chunk.count ? member->weights[chunk.dy * group.width + chunk.dx + i] : short(0));
+                }
+            }
+            group.chunks.emplace_back(chunk);
+        }
+    }
+}
+
+void NccFrame::build(const Mat &frame, ThreadPool &threadPool)
+{
+    if (frame.channels() == 1) image_ = frame;
+    else cvtColor(frame, image_, COLOR_BGR2GRAY);
+
+    rowSums_.create(image_.rows, image_.cols + 1, CV_32SC1);
+    rowSquareSums_.create(image_.rows, image_.cols + 1, CV_32SC1);
+
+    // every row is independent so the frame is split into one band of rows per worker
+    int bandCount = max(1, min(int(threadPool.getThreadCount()), image_.rows));
+    for (int band = 0; band < bandCount; band++)
+    {
+        threadPool.enqueue([this, band, bandCount]() {
+            int firstRow = image_.rows * band / bandCount;
+            int lastRow = image_.rows * (band + 1) / bandCount;
+            for (int y = firstRow; y < lastRow; y++)
+            {
+                const uchar *pixels = image_.ptr<uchar>(y);
+                int *sums = rowSums_.ptr<int>(y);
+                int *squareSums = rowSquareSums_.ptr<int>(y);
+
+                int sum = 0, squareSum = 0;
+                sums[0] = 0;
+                squareSums[0] = 0;
+                for (int x = 0; x < image_.cols; x++)
+                {
+                    sum += pixels[x];
+                    squareSum += pixels[x] * pixels[x];
+                    sums[x + 1] = sum;
+                    squareSums[x + 1] = squareSum;
+                }
+            }
+        });
+    }
+    threadPool.waitForCompletion();
+}
+
+// window sums of count consecutive windows starting at origin (frame coordinates of the first window)
+// run by run so the row integral pointers are only looked up once per run
+static void windowSumsScalar(const Mat &rowSums, const Mat &rowSquareSums, Point origin, const vector<NccRun> &runs, int count, int *sums, int *squareSums)
+{
+    fill(sums, sums + count, 0);
+    fill(squareSums, squareSums + count, 0);
+
+    for (const NccRun &run : runs)
+    {
+        const int *rowSum = rowSums.ptr<int>(origin.y + run.dy) + origin.x + run.dx;
+        const int *rowSquareSum = rowSquareSums.ptr<int>(origin.y + run.dy) + origin.x + run.dx;
+        for (int i = 0; i < count; i++)
+        {
+            sums[i] += rowSum[i + run.count] - rowSum[i];
+            squareSums[i] += rowSquareSum[i + run.count] - rowSquareSum[i];
+        }
+    }
+}
+
+// 8 windows per iteration, the row integrals are contiguous along x so every run is two loads per integral
+NCC_TARGET_AVX2 static void windowSumsAvx2(const Mat &rowSums, const Mat &rowSquareSums, Point origin, const vector<NccRun> &runs, int count, int *sums, int *squareSums)
+{
+    fill(sums, sums + count, 0);
+    fill(squareSums, squareSums + count, 0);
+
+    for (const NccRun &run : runs)
+    {
+        const int *rowSum = rowSums.ptr<int>(origin.y + run.dy) + origin.x + run.dx;
+        const int *rowSquareSum = rowSquareSums.ptr<int>(origin.y + run.dy) + origin.x + run.dx;
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i sum = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(rowSum + i + run.count)), _mm256_loadu_si256((const __m256i *)(rowSum + i)));
+            __m256i squareSum = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(rowSquareSum + i + run.count)),
+                _mm256_loadu_si256((const __m256i *)(rowSquareSum + i)));
+            _mm256_storeu_si256((__m256i *)(sums + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(sums + i)), sum));
+            _mm256_storeu_si256((__m256i *)(squareSums + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(squareSums + i)), squareSum));
+        }
+        for (; i < count; i++)
+        {
+            sums[i] += rowSum[i + run.count] - rowSum[i];
+            squareSums[i] += rowSquareSum[i + run.count] - rowSquareSum[i];
+        }
+    }
+}
+
+static void productsScalar(const uchar *origin, const ptrdiff_t *offsets, const NccGroup &group, long long *products)
+{
+    int memberCount = group.members.size();
+    for (int k = 0; k < memberCount; k++) products[k] = 0;
+
+    for (int c = 0; c < group.chunks.size(); c++)
+    {
+        const uchar *pixels = origin + offsets[c];
+        const short *weights = &group.weights[size_t(c) * memberCount * SPARSE_CHUNK_WIDTH];
+        for (int i = 0; i < group.chunks[c].count; i++)
+        {
+            int pixel = pixels[i];
+            for (int k = 0; k < memberCount; k++) products[k] += pixel * weights[k * SPARSE_CHUNK_WIDTH + i];
+        }
+    }
+}
+
+// every chunk of the frame is loaded and widened once, then multiplied with the weights of every member
+// the member count is a template parameter so the accumulators stay in registers
+template<int MemberCount>
+NCC_TARGET_AVX2 static void productsAvx2(const uchar *origin, const ptrdiff_t *offsets, const NccGroup &group, long long *products)
+{
+    __m256i accumulators[MemberCount];
+    for (int k = 0; k < MemberCount; k++) accumulators[k] = _mm256_setzero_si256();
+
+    const short *weights = group.weights.data();
+    int chunkCount = group.chunks.size();
+    for (int c = 0; c < chunkCount; c++)
+    {
+        // the lanes past the end of the chunk have zero weights for every member, so they dont need masking
+        __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(origin + offsets[c])));
+        for (int k = 0; k < MemberCount; k++)
+        {
+            accumulators[k] = _mm256_add_epi32(accumulators[k], _mm256_madd_epi16(pixels, _mm256_loadu_si256((const __m256i *)weights)));
+            weights += SPARSE_CHUNK_WIDTH;
+        }
+    }
+
+    for (int k = 0; k < MemberCount; k++)
+    {
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(accumulators[k]), _mm256_extracti128_si256(accumulators[k], 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        products[k] = _mm_cvtsi128_si32(sum);
+    }
+}
+
+static NccProducts selectProductsAvx2(int memberCount)
+{
+    switch (memberCount)
+    {
+    case 1: return productsAvx2<1>;
+    case 2: return productsAvx2<2>;
+    case 3: return productsAvx2<3>;
+    case 4: return productsAvx2<4>;
+    case 5: return productsAvx2<5>;
+    case 6: return productsAvx2<6>;
+    case 7: return productsAvx2<7>;
+    default: return productsAvx2<8>;
+    }
+}
+static_assert(NCC_MAX_GROUP_SIZE == 8, "selectProductsAvx2 needs a case for every group size");
+
+void matchNccGroup(const NccFrame &frame, Rect region, const NccGroup &group, TemplateMatchModes matchMode, vector<Mat> &results)
+{
+    const Mat &image = frame.image();
+    int memberCount = group.members.size();
+
+    region &= Rect(0, 0, image.cols, image.rows);
+    int resultRows = region.height - group.height + 1;
+    int resultCols = region.width - group.width + 1;
+
+    results.assign(memberCount, Mat());
+    if (memberCount == 0 || resultRows <= 0 || resultCols <= 0) return;
+    for (Mat &result : results) result.create(resultRows, resultCols, CV_32FC1);
+
+    vector<ptrdiff_t> offsets(group.chunks.size());
+    ptrdiff_t maxOffset = 0;
+    for (int c = 0; c < group.chunks.size(); c++)
+    {
+        offsets[c] = ptrdiff_t(group.chunks[c].dy) * image.step + group.chunks[c].dx;
+        maxOffset = max(maxOffset, offsets[c]);
+    }
+
+    bool avx2 = checkHardwareSupport(CV_CPU_AVX2);
+    NccWindowSums windowSums = avx2 ? windowSumsAvx2 : windowSumsScalar;
+    NccProducts accumulateProducts = avx2 ? selectProductsAvx2(memberCount) : productsScalar;
+
+    // the vector loads always read whole chunks, so positions where that would go past the end of the image use the scalar path
+    const uchar *imageEnd = image.ptr<uchar>(image.rows - 1) + image.cols;
+
+    vector<vector<int>> sums(memberCount, vector<int>(resultCols));
+    vector<vector<int>> squareSums(memberCount, vector<int>(resultCols));
+    long long products[NCC_MAX_GROUP_SIZE];
+
+    for (int y = 0; y < resultRows; y++)
+    {
+        for (int k = 0; k < memberCount; k++)
+        {
+            if (group.footprints[k] != k) continue;
+            windowSums(frame.rowSums(), frame.rowSquareSums(), Point(region.x, region.y + y), group.members[k]->runs, resultCols,
+                sums[k].data(), squareSums[k].data());
+        }
+
+        const uchar *row = image.ptr<uchar>(region.y + y) + region.x;
+        for (int x = 0; x < resultCols; x++)
+        {
+            const uchar *origin = row + x;
+            if (origin + maxOffset + SPARSE_CHUNK_WIDTH <= imageEnd) accumulateProducts(origin, offsets.data(), group, products);
+            else productsScalar(origin, offsets.data(), group, products);
+
+            for (int k = 0; k < memberCount; k++)
+            {
+                const NccTemplate &member = *group.members[k];
+                int footprint = group.footprints[k];
+                results[k].ptr<float>(y)[x] = computeMatchScore(matchMode, member.pixelCount, double(sums[footprint][x]), double(squareSums[footprint][x]),
+                    double(products[k]), member.sum, member.sumSquares);
+            }
+        }
+    }
+}
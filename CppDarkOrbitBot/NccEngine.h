@@ -0,0 +1,83 @@
+#ifndef NCC_ENGINE
+#define NCC_ENGINE
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <vector>
+
+#include "SparseTemplate.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+// the window sums are kept in 32 bit lanes, same limit as the sparse kernel
+constexpr int NCC_MAX_PIXELS = 30000;
+// templates matched together in one pass, their product accumulators all stay in registers
+constexpr int NCC_MAX_GROUP_SIZE = 8;
+
+// horizontal run of opaque template pixels, its window sums are two lookups in the row integrals
+struct NccRun {
+    int dy;
+    int dx;
+    int count;
+
+    bool operator==(const NccRun &other) const { return dy == other.dy && dx == other.dx && count == other.count; }
+};
+
+// the parts of a template the engine needs, built once when the templates are loaded
+// weights hold width * height entries with the transparent pixels zeroed
+struct NccTemplate {
+    int width = 0;
+    int height = 0;
+    int pixelCount = 0;
+
+    vector<NccRun> runs;
+    vector<short> weights;
+
+    double sum = 0;
+    double sumSquares = 0;
+
+    bool empty() const { return runs.empty(); }
+};
+
+// integral images along every row of one frame, rowSums[y][x] is the sum of the first x pixels of row y
+// a row is enough since masked templates need the window sums per run anyway, and the 32 bit sums stay exact
+// built once per frame and shared by every template and tile matched on it
+class NccFrame {
+public:
+    void build(const Mat &frame, ThreadPool &threadPool);
+
+    const Mat &image() const { return image_; }
+    const Mat &rowSums() const { return rowSums_; }
+    const Mat &rowSquareSums() const { return rowSquareSums_; }
+
+private:
+    Mat image_;
+    Mat rowSums_;
+    Mat rowSquareSums_;
+};
+
+// same size templates evaluated together, every window is loaded once for all of them
+// the members with the same opaque pixels also share their window sums
+// a group of one member is valid and is what the live bot matches while palladium is its only resource template
+struct NccGroup {
+    int width = 0;
+    int height = 0;
+
+    vector<const NccTemplate *> members;
+    vector<int> footprints;                 // per member, index of the first member with the same runs
+
+    vector<SparseChunk> chunks;             // union of the opaque pixels of all members
+    vector<short> weights;                  // members.size() * SPARSE_CHUNK_WIDTH per chunk, zero padded
+};
+
+bool buildNccTemplate(const Mat &grayscale, const Mat &alpha, NccTemplate &ncc);
+bool isNccMatchModeSupported(TemplateMatchModes matchMode);
+// members have to be the same size, at most NCC_MAX_GROUP_SIZE of them
+void buildNccGroup(const vector<const NccTemplate *> &members, NccGroup &group);
+// scores of every member over the region of the frame, results[k] belongs to members[k]
+// the scores are the same as the sparse kernel gives for each member on its own
+void matchNccGroup(const NccFrame &frame, Rect region, const NccGroup &group, TemplateMatchModes matchMode, vector<Mat> &results);
+
+#endif
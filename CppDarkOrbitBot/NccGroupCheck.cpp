@@ -0,0 +1,151 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "NccEngine.h"
+#include "SparseTemplate.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace cv;
+
+// checks a two member ncc group against the sparse kernel run on every member by itself:
+//   ./ncc_group_check <pngs directory>
+// endurium1 and endurium2 are both 33x27, they are pasted into a noisy frame and matched as one group
+
+static const double SCORE_TOLERANCE = 1e-4;
+
+static int failures = 0;
+
+static void expect(bool condition, const string &message)
+{
+    if (condition) return;
+    std::cerr << "FAILED: " << message << std::endl;
+    failures++;
+}
+
+// the same grayscale and alpha the bot builds in loadImages
+static bool loadTemplate(const string &path, Mat &grayscale, Mat &alpha)
+{
+    Mat png = imread(path, IMREAD_UNCHANGED);
+    if (png.empty() || png.channels() != 4) return false;
+
+    cvtColor(png, grayscale, COLOR_BGRA2GRAY);
+    extractChannel(png, alpha, 3);
+    return true;
+}
+
+// the opaque pixels of the template are copied over the frame, like the sprites in the synthetic worlds
+static void paste(Mat &frame, const Mat &grayscale, const Mat &alpha, Point position)
+{
+    grayscale.copyTo(frame(Rect(position, grayscale.size())), alpha);
+}
+
+static void compareWithSparse(const Mat &frame, Rect region, const Mat &groupResult, const SparseTemplate &sparse, TemplateMatchModes matchMode,
+    const string &name)
+{
+    Mat sparseResult;
+    matchSparseTemplate(frame(region), sparse, matchMode, sparseResult);
+
+    expect(groupResult.size() == sparseResult.size(), name + " group result is " + to_string(groupResult.cols) + "x" + to_string(groupResult.rows)
+        + " but the sparse one " + to_string(sparseResult.cols) + "x" + to_string(sparseResult.rows));
+    if (groupResult.size() != sparseResult.size()) return;
+
+    int mismatches = 0;
+    double largestDifference = 0;
+    for (int y = 0; y < groupResult.rows; y++)
+    {
+        for (int x = 0; x < groupResult.cols; x++)
+        {
+            double difference = fabs(groupResult.at<float>(y, x) - sparseResult.at<float>(y, x));
+            largestDifference = max(largestDifference, difference);
+            if (difference > SCORE_TOLERANCE) mismatches++;
+        }
+    }
+    expect(mismatches == 0, name + " differs from the sparse kernel at " + to_string(mismatches) + " positions, by up to " + to_string(largestDifference));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: ncc_group_check <pngs directory>" << std::endl;
+        return 1;
+    }
+
+    string directory = argv[1];
+    const vector<string> names = { "endurium1.png", "endurium2.png" };
+
+    vector<Mat> grayscales(names.size());
+    vector<Mat> alphas(names.size());
+    vector<SparseTemplate> sparses(names.size());
+    vector<NccTemplate> nccs(names.size());
+    for (int k = 0; k < names.size(); k++)
+    {
+        if (!loadTemplate(directory + "/" + names[k], grayscales[k], alphas[k]))
+        {
+            std::cerr << "Could not load " << directory + "/" + names[k] << " with an alpha channel" << std::endl;
+            return 1;
+        }
+        expect(buildSparseTemplate(grayscales[k], alphas[k], sparses[k]), names[k] + " has no sparse template");
+        expect(buildNccTemplate(grayscales[k], alphas[k], nccs[k]), names[k] + " has no ncc template");
+    }
+    if (failures > 0) return 1;
+
+    NccGroup group;
+    buildNccGroup({ &nccs[0], &nccs[1] }, group);
+    expect(group.members.size() == 2, "group has " + to_string(group.members.size()) + " members");
+
+    // the default rng state is fixed so a failure can be reproduced
+    Mat frame(360, 480, CV_8UC1);
+    randu(frame, Scalar(0), Scalar(256));
+    vector<Point> positions = { Point(40, 30), Point(300, 200) };
+    for (int k = 0; k < names.size(); k++) paste(frame, grayscales[k], alphas[k], positions[k]);
+
+    ThreadPool threadPool(2);
+    NccFrame nccFrame;
+    nccFrame.build(frame, threadPool);
+
+    // the whole frame, and a region away from the origin that reaches the bottom right corner where the vector loads stop
+    vector<Rect> regions = { Rect(0, 0, frame.cols, frame.rows), Rect(frame.cols - 200, frame.rows - 150, 200, 150) };
+    for (TemplateMatchModes matchMode : { TM_CCOEFF_NORMED, TM_SQDIFF_NORMED, TM_CCORR_NORMED })
+    {
+        if (!isNccMatchModeSupported(matchMode)) continue;
+
+        for (Rect region : regions)
+        {
+            vector<Mat> results;
+            matchNccGroup(nccFrame, region, group, matchMode, results);
+            expect(results.size() == 2, "group returned " + to_string(results.size()) + " results");
+            if (results.size() != 2) continue;
+
+            for (int k = 0; k < names.size(); k++)
+            {
+                compareWithSparse(frame, region, results[k], sparses[k], matchMode,
+                    names[k] + " mode " + to_string(int(matchMode)) + " region " + to_string(region.x) + "," + to_string(region.y));
+            }
+        }
+    }
+
+    // every member finds itself where it was pasted
+    vector<Mat> results;
+    matchNccGroup(nccFrame, regions[0], group, TM_CCOEFF_NORMED, results);
+    for (int k = 0; k < results.size(); k++)
+    {
+        Point best;
+        minMaxLoc(results[k], nullptr, nullptr, nullptr, &best);
+        expect(best == positions[k], names[k] + " best match is at " + to_string(best.x) + "," + to_string(best.y));
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " ncc group checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "NCC group checks passed" << std::endl;
+    return 0;
+}
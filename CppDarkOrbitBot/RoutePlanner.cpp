@@ -0,0 +1,307 @@
+#include <opencv2/core/types.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "BotUtils.h"
+#include "RoutePlanner.h"
+
+using namespace std;
+using namespace cv;
+
+static double pointDistance(const Point &a, const Point &b)
+{
+    return hypot(double(a.x - b.x), double(a.y - b.y));
+}
+
+Point rectCenter(const Rect &rect)
+{
+    return Point(rect.x + rect.width / 2, rect.y + rect.height / 2);
+}
+
+SpatialGrid::SpatialGrid(int width, int height, int cellSize) : cellSize_(cellSize)
+{
+    columns_ = max(1, (width + cellSize - 1) / cellSize);
+    rows_ = max(1, (height + cellSize - 1) / cellSize);
+    cells_.resize(columns_ * rows_);
+}
+
+int SpatialGrid::cellIndex(int column, int row) const
+{
+    return row * columns_ + column;
+}
+
+void SpatialGrid::clear()
+{
+    for (vector<int> &cell : cells_) cell.clear();
+    positions_.clear();
+}
+
+void SpatialGrid::insert(int index, Point position)
+{
+    if (index >= positions_.size()) positions_.resize(index + 1);
+    positions_[index] = position;
+
+    // points outside of the screen are clamped into the border cells
+    int column = clamp(position.x / cellSize_, 0, columns_ - 1);
+    int row = clamp(position.y / cellSize_, 0, rows_ - 1);
+    cells_[cellIndex(column, row)].emplace_back(index);
+}
+
+void SpatialGrid::nearest(Point position, int count, double minimumDistance, vector<int> &indexes) const
+{
+    if (count <= 0) return;
+
+    // distance - point index
+    vector<pair<double, int>> candidates;
+
+    int column = clamp(position.x / cellSize_, 0, columns_ - 1);
+    int row = clamp(position.y / cellSize_, 0, rows_ - 1);
+    int maxRing = max(columns_, rows_);
+
+    for (int ring = 0; ring <= maxRing; ring++)
+    {
+        // only visiting the cells on the border of the current ring, the inner ones were visited already
+        for (int r = row - ring; r <= row + ring; r++)
+        {
+            for (int c = column - ring; c <= column + ring; c++)
+            {
+                if (r < 0 || c < 0 || r >= rows_ || c >= columns_) continue;
+                if (abs(r - row) != ring && abs(c - column) != ring) continue;
+
+                for (int index : cells_[cellIndex(c, r)])
+                {
+                    double distance = pointDistance(position, positions_[index]);
+                    if (distance > minimumDistance) candidates.emplace_back(distance, index);
+                }
+            }
+        }
+
+        // every point that wasnt visited yet is at least this far away from the query point
+        // so once we have enough candidates closer than that the search can stop
+        if (candidates.size() >= count)
+        {
+            nth_element(candidates.begin(), candidates.begin() + (count - 1), candidates.end());
+            if (candidates[count - 1].first <= ring * cellSize_) break;
+        }
+    }
+
+    int resultCount = min<int>(count, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + resultCount, candidates.end());
+    for (int i = 0; i < resultCount; i++) indexes.emplace_back(candidates[i].second);
+}
+
+int SpatialGrid::nearestWithin(Point position, double radius) const
+{
+    int firstColumn = clamp(int((position.x - radius) / cellSize_), 0, columns_ - 1);
+    int lastColumn = clamp(int((position.x + radius) / cellSize_), 0, columns_ - 1);
+    int firstRow = clamp(int((position.y - radius) / cellSize_), 0, rows_ - 1);
+    int lastRow = clamp(int((position.y + radius) / cellSize_), 0, rows_ - 1);
+
+    int closestIndex = -1;
+    double closestDistance = radius;
+
+    for (int r = firstRow; r <= lastRow; r++)
+    {
+        for (int c = firstColumn; c <= lastColumn; c++)
+        {
+            for (int index : cells_[cellIndex(c, r)])
+            {
+                double distance = pointDistance(position, positions_[index]);
+                if (distance <= closestDistance)
+                {
+                    closestDistance = distance;
+                    closestIndex = index;
+                }
+            }
+        }
+    }
+
+    return closestIndex;
+}
+
+RoutePlanner::RoutePlanner(int screenWidth, int screenHeight, int maxRouteLength, double minimumDistance)
+    : screenWidth_(screenWidth), screenHeight_(screenHeight), maxRouteLength_(maxRouteLength), minimumDistance_(minimumDistance),
+    grid_(screenWidth, screenHeight, 128)
+{
+}
+
+Point RoutePlanner::shipPosition() const
+{
+    return Point(screenWidth_ / 2, screenHeight_ / 2);
+}
+
+void RoutePlanner::buildGrid(const vector<TemplateMatch> &detections)
+{
+    grid_.clear();
+    for (int i = 0; i < detections.size(); i++) grid_.insert(i, rectCenter(detections[i].rect));
+}
+
+void RoutePlanner::plan(const vector<TemplateMatch> &detections)
+{
+    clear();
+    buildGrid(detections);
+
+    // only the nearest K detections are routed, the far ones will be closer after the next pickups anyway
+    vector<int> candidates;
+    grid_.nearest(shipPosition(), maxRouteLength_, minimumDistance_, candidates);
+
+    // if the only detection is right under the ship we still go for it
+    if (candidates.empty() && detections.size() == 1) candidates.emplace_back(0);
+    if (candidates.empty()) return;
+
+    // index 0 is the ship, index i + 1 is candidates[i]
+    vector<Point> points;
+    points.emplace_back(shipPosition());
+    for (int index : candidates) points.emplace_back(rectCenter(detections[index].rect));
+
+    // greedy nearest neighbour order starting from the ship
+    vector<int> order;
+    vector<bool> visited(points.size(), false);
+    int current = 0;
+    visited[0] = true;
+    for (int step = 1; step < points.size(); step++)
+    {
+        int next = -1;
+        double nextDistance = 0;
+        for (int j = 1; j < points.size(); j++)
+        {
+            if (visited[j]) continue;
+
+            double distance = pointDistance(points[current], points[j]);
+            if (next == -1 || distance < nextDistance)
+            {
+                next = j;
+                nextDistance = distance;
+            }
+        }
+        visited[next] = true;
+        order.emplace_back(next);
+        current = next;
+    }
+
+    improveWithTwoOpt(points, order);
+
+    for (int pointIndex : order)
+    {
+        route_.emplace_back(detections[candidates[pointIndex - 1]]);
+        routeDetectionIndexes_.emplace_back(candidates[pointIndex - 1]);
+    }
+}
+
+void RoutePlanner::improveWithTwoOpt(vector<Point> &points, vector<int> &order) const
+{
+    // the path is open and always starts at the ship, so only the segments after it get reversed
+    int n = order.size();
+    bool improved = true;
+
+    while (improved)
+    {
+        improved = false;
+        for (int i = 0; i < n - 1; i++)
+        {
+            for (int j = i + 1; j < n; j++)
+            {
+                const Point &before = i == 0 ? points[0] : points[order[i - 1]];
+                const Point &first = points[order[i]];
+                const Point &last = points[order[j]];
+
+                double removed = pointDistance(before, first);
+                double added = pointDistance(before, last);
+
+                if (j + 1 < n)
+                {
+                    const Point &after = points[order[j + 1]];
+                    removed += pointDistance(last, after);
+                    added += pointDistance(first, after);
+                }
+
+                if (added + 1e-6 < removed)
+                {
+                    reverse(order.begin() + i, order.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+void RoutePlanner::clear()
+{
+    route_.clear();
+    routeDetectionIndexes_.clear();
+}
+
+bool RoutePlanner::hasNext() const
+{
+    return !route_.empty();
+}
+
+TemplateMatch RoutePlanner::peekNext() const
+{
+    return route_.front();
+}
+
+int RoutePlanner::nextDetectionIndex() const
+{
+    return routeDetectionIndexes_.empty() ? -1 : routeDetectionIndexes_.front();
+}
+
+void RoutePlanner::popNext()
+{
+    // the camera follows the ship, so once it reaches the target everything else on screen
+    // will have moved by the distance between the target and the ship
+    Point target = rectCenter(route_.front().rect);
+    Point offset = shipPosition() - target;
+
+    route_.erase(route_.begin());
+    routeDetectionIndexes_.erase(routeDetectionIndexes_.begin());
+
+    for (int i = 0; i < route_.size(); i++)
+    {
+        route_[i].rect.x += offset.x;
+        route_[i].rect.y += offset.y;
+        // the remaining targets no longer point into the frame the route was planned on
+        routeDetectionIndexes_[i] = -1;
+    }
+}
+
+bool RoutePlanner::confirmNext(const vector<TemplateMatch> &detections, double snapRadius)
+{
+    buildGrid(detections);
+
+    // snapping the predicted position of the next target onto a detection of the current frame
+    // targets that cant be found anymore (collected by someone else, bad prediction) are skipped
+    while (hasNext())
+    {
+        int index = grid_.nearestWithin(rectCenter(route_.front().rect), snapRadius);
+        if (index != -1)
+        {
+            route_.front() = detections[index];
+            routeDetectionIndexes_.front() = index;
+            return true;
+        }
+
+        route_.erase(route_.begin());
+        routeDetectionIndexes_.erase(routeDetectionIndexes_.begin());
+    }
+
+    return false;
+}
+
+const vector<TemplateMatch> &RoutePlanner::route() const
+{
+    return route_;
+}
+
+double RoutePlanner::routeLength() const
+{
+    double length = 0;
+    Point previous = shipPosition();
+    for (const TemplateMatch &target : route_)
+    {
+        Point current = rectCenter(target.rect);
+        length += pointDistance(previous, current);
+        previous = current;
+    }
+    return length;
+}
@@ -0,0 +1,68 @@
+#ifndef ROUTE_PLANNER
+#define ROUTE_PLANNER
+
+#include <opencv2/core/types.hpp>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+// uniform grid over the screen, every cell keeps the indexes of the points that fall inside it
+// so nearest neighbour queries only have to look at the cells around the query point
+class SpatialGrid {
+public:
+    SpatialGrid(int width, int height, int cellSize);
+
+    void clear();
+    void insert(int index, Point position);
+    void nearest(Point position, int count, double minimumDistance, vector<int> &indexes) const;
+    int nearestWithin(Point position, double radius) const;
+
+private:
+    int cellSize_;
+    int columns_, rows_;
+
+    vector<vector<int>> cells_;
+    vector<Point> positions_;
+
+    int cellIndex(int column, int row) const;
+};
+
+// plans a visiting order over the detections of a frame starting from the ship (screen center)
+// the order is built greedily from the nearest K detections and then improved with 2-opt
+class RoutePlanner {
+public:
+    RoutePlanner(int screenWidth, int screenHeight, int maxRouteLength, double minimumDistance);
+
+    void plan(const vector<TemplateMatch> &detections);
+    void clear();
+
+    bool hasNext() const;
+    TemplateMatch peekNext() const;
+    int nextDetectionIndex() const;
+    void popNext();
+    bool confirmNext(const vector<TemplateMatch> &detections, double snapRadius);
+
+    const vector<TemplateMatch> &route() const;
+    double routeLength() const;
+    Point shipPosition() const;
+
+private:
+    int screenWidth_, screenHeight_;
+    int maxRouteLength_;
+    double minimumDistance_;
+
+    SpatialGrid grid_;
+
+    vector<TemplateMatch> route_;
+    vector<int> routeDetectionIndexes_;
+
+    void buildGrid(const vector<TemplateMatch> &detections);
+    void improveWithTwoOpt(vector<Point> &points, vector<int> &order) const;
+};
+
+Point rectCenter(const Rect &rect);
+
+#endif
@@ -0,0 +1,522 @@
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/opencv.hpp>
+#include <cstring>
+
+#include "BotUtils.h"
+#include "Constants.h"
+#include "SessionRecorder.h"
+
+using namespace std;
+using namespace cv;
+
+static const char SESSION_MAGIC[8] = { 'D', 'O', 'B', 'R', 'E', 'C', '0', '1' };
+static const char SESSION_INDEX_MAGIC[8] = { 'D', 'O', 'B', 'R', 'I', 'D', 'X', '1' };
+constexpr unsigned int SESSION_VERSION = 1;
+constexpr int SESSION_HEADER_SIZE = 16;
+constexpr int SESSION_RECORD_HEADER_SIZE = 16;
+constexpr int SESSION_FOOTER_SIZE = 16;
+constexpr int DELTA_MOSAIC_COLUMNS = 16;
+
+template<typename T>
+static void appendValue(vector<uchar> &buffer, T value)
+{
+    const uchar *bytes = (const uchar *)&value;
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static T readValue(const uchar *&cursor)
+{
+    T value;
+    memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+// wraps the rest of the payload without copying it, for imdecode
+static Mat remainingPayload(vector<uchar> &payload, const uchar *cursor)
+{
+    int offset = int(cursor - payload.data());
+    return Mat(1, int(payload.size()) - offset, CV_8UC1, payload.data() + offset);
+}
+
+static Rect tileRect(int column, int row, int tileSize, Size frameSize)
+{
+    int x = column * tileSize;
+    int y = row * tileSize;
+    return Rect(x, y, min(tileSize, frameSize.width - x), min(tileSize, frameSize.height - y));
+}
+
+SessionRecorder::SessionRecorder(const SessionRecorderSettings &settings) : settings_(settings), queuedFrames_(0), queuedEvents_(0),
+    lastFrameMillis_(0), running_(false), droppedFrames_(0), droppedEvents_(0), lastKeyframeTimestamp_(0)
+{
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    stop();
+}
+
+bool SessionRecorder::start()
+{
+    file_.open(settings_.path, ios::binary | ios::trunc);
+    if (!file_.is_open())
+    {
+        printWithTimestamp("Could not open session recording: " + settings_.path, RED_TEXT_BLACK_BACKGROUND);
+        return false;
+    }
+
+    file_.write(SESSION_MAGIC, sizeof(SESSION_MAGIC));
+    file_.write((const char *)&SESSION_VERSION, sizeof(SESSION_VERSION));
+    file_.write((const char *)&settings_.tileSize, sizeof(settings_.tileSize));
+
+    running_ = true;
+    writerThread_ = thread(&SessionRecorder::writerLoop, this);
+
+    printWithTimestamp("Recording session to " + settings_.path, YELLOW_TEXT_BLACK_BACKGROUND);
+    return true;
+}
+
+void SessionRecorder::stop()
+{
+    {
+        lock_guard<mutex> lock(queueMutex_);
+        if (!running_) return;
+        running_ = false;
+    }
+    queueCondition_.notify_all();
+    if (writerThread_.joinable()) writerThread_.join();
+}
+
+void SessionRecorder::push(QueuedItem &&item, bool isFrame)
+{
+    {
+        lock_guard<mutex> lock(queueMutex_);
+        if (!running_) return;
+
+        if (isFrame)
+        {
+            if (queuedFrames_ >= settings_.maxQueuedFrames)
+            {
+                droppedFrames_++;
+                return;
+            }
+            queuedFrames_++;
+        }
+        else
+        {
+            if (queuedEvents_ >= settings_.maxQueuedEvents)
+            {
+                droppedEvents_++;
+                return;
+            }
+            queuedEvents_++;
+        }
+
+        queue_.emplace_back(move(item));
+    }
+    queueCondition_.notify_one();
+}
+
+void SessionRecorder::recordFrame(const Mat &frame)
+{
+    long long now = getCurrentMillis();
+    {
+        // checking before the copy so skipped and dropped frames cost nothing on the main loop
+        lock_guard<mutex> lock(queueMutex_);
+        if (!running_ || now - lastFrameMillis_ < settings_.frameIntervalMillis) return;
+        if (queuedFrames_ >= settings_.maxQueuedFrames)
+        {
+            droppedFrames_++;
+            return;
+        }
+        lastFrameMillis_ = now;
+    }
+
+    QueuedItem item = { RECORD_KEYFRAME, getCurrentMicros(), frame.clone() };
+    push(move(item), true);
+}
+
+void SessionRecorder::recordDetections(const vector<TemplateMatch> &detections)
+{
+    QueuedItem item = { RECORD_DETECTIONS, getCurrentMicros(), Mat(), detections };
+    push(move(item), false);
+}
+
+void SessionRecorder::recordStatus(BotStatus from, BotStatus to)
+{
+    QueuedItem item = { RECORD_STATUS, getCurrentMicros(), Mat(), {}, { from, to } };
+    push(move(item), false);
+}
+
+void SessionRecorder::recordClick(int x, int y)
+{
+    QueuedItem item = { RECORD_CLICK, getCurrentMicros(), Mat(), {}, { x, y } };
+    push(move(item), false);
+}
+
+long long SessionRecorder::getDroppedFrames() const
+{
+    return droppedFrames_.load();
+}
+
+long long SessionRecorder::getDroppedEvents() const
+{
+    return droppedEvents_.load();
+}
+
+void SessionRecorder::writerLoop()
+{
+    while (true)
+    {
+        QueuedItem item;
+        {
+            unique_lock<mutex> lock(queueMutex_);
+            queueCondition_.wait(lock, [this]() { return !running_ || !queue_.empty(); });
+
+            // stopping only once everything queued so far has been written
+            if (queue_.empty()) break;
+
+            item = move(queue_.front());
+            queue_.pop_front();
+            if (item.type == RECORD_KEYFRAME) queuedFrames_--;
+            else queuedEvents_--;
+        }
+
+        writeItem(item);
+    }
+
+    writeIndex();
+    file_.close();
+}
+
+void SessionRecorder::writeItem(const QueuedItem &item)
+{
+    vector<uchar> payload;
+
+    switch (item.type)
+    {
+    case RECORD_KEYFRAME:
+        writeFrame(item.frame, item.timestamp);
+        break;
+    case RECORD_DETECTIONS:
+        appendValue<unsigned int>(payload, (unsigned int)item.detections.size());
+        for (const TemplateMatch &detection : item.detections)
+        {
+            appendValue<int>(payload, detection.rect.x);
+            appendValue<int>(payload, detection.rect.y);
+            appendValue<int>(payload, detection.rect.width);
+            appendValue<int>(payload, detection.rect.height);
+            appendValue<float>(payload, float(detection.confidence));
+            appendValue<int>(payload, detection.identifier);
+        }
+        writeRecord(RECORD_DETECTIONS, item.timestamp, payload);
+        break;
+    default:
+        appendValue<int>(payload, item.values[0]);
+        appendValue<int>(payload, item.values[1]);
+        writeRecord(item.type, item.timestamp, payload);
+        break;
+    }
+}
+
+void SessionRecorder::writeFrame(const Mat &frame, long long timestamp)
+{
+    int tileSize = settings_.tileSize;
+    int tileColumns = (frame.cols + tileSize - 1) / tileSize;
+    int tileRows = (frame.rows + tileSize - 1) / tileSize;
+
+    bool keyframe = reference_.empty() || reference_.size() != frame.size() || reference_.type() != frame.type()
+        || timestamp - lastKeyframeTimestamp_ >= settings_.keyframeIntervalMillis * 1000;
+
+    // comparing every tile against what the reader will have reconstructed at this point
+    vector<Point> changedTiles;
+    if (!keyframe)
+    {
+        for (int row = 0; row < tileRows; row++)
+        {
+            for (int column = 0; column < tileColumns; column++)
+            {
+                Rect tile = tileRect(column, row, tileSize, frame.size());
+                if (norm(frame(tile), reference_(tile), NORM_INF) > settings_.changeThreshold) changedTiles.emplace_back(column, row);
+            }
+        }
+
+        if (changedTiles.size() > settings_.keyframeChangedRatio * tileColumns * tileRows) keyframe = true;
+    }
+
+    vector<uchar> payload;
+    vector<uchar> encoded;
+
+    if (keyframe)
+    {
+        frame.copyTo(reference_);
+        lastKeyframeTimestamp_ = timestamp;
+        keyframeIndex_.emplace_back(timestamp, (unsigned long long)file_.tellp());
+
+        imencode(settings_.imageFormat, frame, encoded);
+        appendValue<int>(payload, frame.cols);
+        appendValue<int>(payload, frame.rows);
+        payload.insert(payload.end(), encoded.begin(), encoded.end());
+        writeRecord(RECORD_KEYFRAME, timestamp, payload);
+        return;
+    }
+
+    appendValue<unsigned int>(payload, (unsigned int)changedTiles.size());
+    for (const Point &tile : changedTiles)
+    {
+        appendValue<unsigned short>(payload, (unsigned short)tile.x);
+        appendValue<unsigned short>(payload, (unsigned short)tile.y);
+    }
+
+    // the changed tiles are packed into one mosaic so there is only one encode per frame
+    if (!changedTiles.empty())
+    {
+        int mosaicColumns = min<int>(DELTA_MOSAIC_COLUMNS, changedTiles.size());
+        int mosaicRows = (changedTiles.size() + mosaicColumns - 1) / mosaicColumns;
+        Mat mosaic(mosaicRows * tileSize, mosaicColumns * tileSize, frame.type(), Scalar());
+
+        for (int i = 0; i < changedTiles.size(); i++)
+        {
+            Rect tile = tileRect(changedTiles[i].x, changedTiles[i].y, tileSize, frame.size());
+            Rect cell((i % mosaicColumns) * tileSize, (i / mosaicColumns) * tileSize, tile.width, tile.height);
+
+            Mat mosaicCell = mosaic(cell);
+            frame(tile).copyTo(mosaicCell);
+            Mat referenceTile = reference_(tile);
+            frame(tile).copyTo(referenceTile);
+        }
+
+        imencode(settings_.imageFormat, mosaic, encoded);
+        payload.insert(payload.end(), encoded.begin(), encoded.end());
+    }
+
+    writeRecord(RECORD_DELTA, timestamp, payload);
+}
+
+void SessionRecorder::writeRecord(SessionRecordType type, long long timestamp, const vector<uchar> &payload)
+{
+    unsigned char header[4] = { (unsigned char)type, 0, 0, 0 };
+    unsigned int payloadSize = (unsigned int)payload.size();
+
+    file_.write((const char *)header, sizeof(header));
+    file_.write((const char *)&timestamp, sizeof(timestamp));
+    file_.write((const char *)&payloadSize, sizeof(payloadSize));
+    if (!payload.empty()) file_.write((const char *)payload.data(), payload.size());
+}
+
+void SessionRecorder::writeIndex()
+{
+    unsigned long long indexOffset = (unsigned long long)file_.tellp();
+
+    vector<uchar> payload;
+    appendValue<unsigned int>(payload, (unsigned int)keyframeIndex_.size());
+    for (const auto &keyframe : keyframeIndex_)
+    {
+        appendValue<long long>(payload, keyframe.first);
+        appendValue<unsigned long long>(payload, keyframe.second);
+    }
+    writeRecord(RECORD_INDEX, getCurrentMicros(), payload);
+
+    file_.write((const char *)&indexOffset, sizeof(indexOffset));
+    file_.write(SESSION_INDEX_MAGIC, sizeof(SESSION_INDEX_MAGIC));
+}
+
+bool SessionReader::open(const string &path)
+{
+    file_.open(path, ios::binary);
+    if (!file_.is_open()) return false;
+
+    char magic[8];
+    unsigned int version = 0;
+    file_.read(magic, sizeof(magic));
+    file_.read((char *)&version, sizeof(version));
+    file_.read((char *)&tileSize_, sizeof(tileSize_));
+
+    if (!file_ || memcmp(magic, SESSION_MAGIC, sizeof(magic)) != 0 || version != SESSION_VERSION) return false;
+
+    if (!readIndex()) return false;
+
+    file_.clear();
+    file_.seekg(SESSION_HEADER_SIZE);
+    return true;
+}
+
+bool SessionReader::readIndex()
+{
+    file_.seekg(0, ios::end);
+    unsigned long long fileSize = (unsigned long long)file_.tellg();
+
+    // a complete recording ends with the footer pointing at the keyframe index
+    if (fileSize >= SESSION_HEADER_SIZE + SESSION_FOOTER_SIZE)
+    {
+        unsigned long long indexOffset = 0;
+        char magic[8];
+        file_.seekg(fileSize - SESSION_FOOTER_SIZE);
+        file_.read((char *)&indexOffset, sizeof(indexOffset));
+        file_.read(magic, sizeof(magic));
+
+        if (file_ && memcmp(magic, SESSION_INDEX_MAGIC, sizeof(magic)) == 0 && indexOffset < fileSize)
+        {
+            recordsEnd_ = indexOffset;
+
+            file_.seekg(indexOffset + SESSION_RECORD_HEADER_SIZE);
+            unsigned int count = 0;
+            file_.read((char *)&count, sizeof(count));
+            for (unsigned int i = 0; i < count && file_; i++)
+            {
+                long long timestamp;
+                unsigned long long offset;
+                file_.read((char *)&timestamp, sizeof(timestamp));
+                file_.read((char *)&offset, sizeof(offset));
+                keyframes_.emplace_back(timestamp, offset);
+            }
+            return bool(file_);
+        }
+    }
+
+    // no footer, the recording was cut off so the keyframes are found by walking the record headers
+    file_.clear();
+    file_.seekg(SESSION_HEADER_SIZE);
+    recordsEnd_ = SESSION_HEADER_SIZE;
+    while (true)
+    {
+        unsigned long long offset = (unsigned long long)file_.tellg();
+        unsigned char header[4];
+        long long timestamp;
+        unsigned int payloadSize;
+
+        file_.read((char *)header, sizeof(header));
+        file_.read((char *)&timestamp, sizeof(timestamp));
+        file_.read((char *)&payloadSize, sizeof(payloadSize));
+        if (!file_ || offset + SESSION_RECORD_HEADER_SIZE + payloadSize > fileSize) break;
+
+        if (header[0] == RECORD_KEYFRAME) keyframes_.emplace_back(timestamp, offset);
+        file_.seekg(payloadSize, ios::cur);
+        recordsEnd_ = offset + SESSION_RECORD_HEADER_SIZE + payloadSize;
+    }
+
+    return true;
+}
+
+bool SessionReader::seek(long long timestamp)
+{
+    if (keyframes_.empty()) return false;
+
+    // starting from the last keyframe at or before the timestamp, deltas cant be applied without one
+    int keyframe = 0;
+    for (int i = 0; i < keyframes_.size(); i++)
+    {
+        if (keyframes_[i].first <= timestamp) keyframe = i;
+    }
+
+    file_.clear();
+    file_.seekg(keyframes_[keyframe].second);
+    frame_.release();
+    return true;
+}
+
+bool SessionReader::next(SessionRecord &record)
+{
+    unsigned long long offset = (unsigned long long)file_.tellg();
+    if (!file_ || offset + SESSION_RECORD_HEADER_SIZE > recordsEnd_) return false;
+
+    unsigned char header[4];
+    unsigned int payloadSize;
+    file_.read((char *)header, sizeof(header));
+    file_.read((char *)&record.timestamp, sizeof(record.timestamp));
+    file_.read((char *)&payloadSize, sizeof(payloadSize));
+
+    vector<uchar> payload(payloadSize);
+    if (payloadSize > 0) file_.read((char *)payload.data(), payloadSize);
+    if (!file_) return false;
+
+    record.type = SessionRecordType(header[0]);
+    record.frame.release();
+    record.detections.clear();
+
+    const uchar *cursor = payload.data();
+
+    switch (record.type)
+    {
+    case RECORD_KEYFRAME:
+    {
+        width_ = readValue<int>(cursor);
+        height_ = readValue<int>(cursor);
+        frame_ = imdecode(remainingPayload(payload, cursor), IMREAD_UNCHANGED);
+        record.frame = frame_.clone();
+        break;
+    }
+    case RECORD_DELTA:
+    {
+        unsigned int tileCount = readValue<unsigned int>(cursor);
+        vector<Point> tiles;
+        for (unsigned int i = 0; i < tileCount; i++)
+        {
+            int column = readValue<unsigned short>(cursor);
+            int row = readValue<unsigned short>(cursor);
+            tiles.emplace_back(column, row);
+        }
+
+        // deltas read before the first keyframe have nothing to be applied on
+        if (frame_.empty()) break;
+
+        if (tileCount > 0)
+        {
+            Mat mosaic = imdecode(remainingPayload(payload, cursor), IMREAD_UNCHANGED);
+            int mosaicColumns = min<int>(DELTA_MOSAIC_COLUMNS, tileCount);
+
+            for (int i = 0; i < tiles.size(); i++)
+            {
+                Rect tile = tileRect(tiles[i].x, tiles[i].y, tileSize_, frame_.size());
+                Rect cell((i % mosaicColumns) * tileSize_, (i / mosaicColumns) * tileSize_, tile.width, tile.height);
+                Mat frameTile = frame_(tile);
+                mosaic(cell).copyTo(frameTile);
+            }
+        }
+        record.frame = frame_.clone();
+        break;
+    }
+    case RECORD_DETECTIONS:
+    {
+        unsigned int count = readValue<unsigned int>(cursor);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            int x = readValue<int>(cursor);
+            int y = readValue<int>(cursor);
+            int width = readValue<int>(cursor);
+            int height = readValue<int>(cursor);
+            float confidence = readValue<float>(cursor);
+            int identifier = readValue<int>(cursor);
+            record.detections.push_back({ Rect(x, y, width, height), confidence, TemplateIdentifier(identifier) });
+        }
+        break;
+    }
+    case RECORD_STATUS:
+        record.fromStatus = BotStatus(readValue<int>(cursor));
+        record.toStatus = BotStatus(readValue<int>(cursor));
+        break;
+    case RECORD_CLICK:
+    {
+        int x = readValue<int>(cursor);
+        int y = readValue<int>(cursor);
+        record.click = Point(x, y);
+        break;
+    }
+    default:
+        break;
+    }
+
+    return true;
+}
+
+const vector<pair<long long, unsigned long long>> &SessionReader::keyframes() const
+{
+    return keyframes_;
+}
+
+Size SessionReader::frameSize() const
+{
+    return Size(width_, height_);
+}
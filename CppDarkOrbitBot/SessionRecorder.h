@@ -0,0 +1,136 @@
+#ifndef SESSION_RECORDER
+#define SESSION_RECORDER
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+// session file layout, all values little endian
+//   header:  "DOBREC01", uint32 version, int32 tileSize
+//   records: uint8 type, 3 bytes padding, int64 timestamp (micros), uint32 payload size, payload
+//   keyframe payload: int32 width, int32 height, encoded frame
+//   delta payload:    uint32 tile count, uint16 column and row per tile, encoded mosaic of the changed tiles
+//   footer:  uint64 offset of the RECORD_INDEX record, "DOBRIDX1"
+// the index lists the timestamp and file offset of every keyframe so a reader can seek without scanning
+// if the bot dies before the footer is written the records can still be read front to back
+enum SessionRecordType {
+    RECORD_KEYFRAME = 1,
+    RECORD_DELTA = 2,
+    RECORD_DETECTIONS = 3,
+    RECORD_STATUS = 4,
+    RECORD_CLICK = 5,
+    RECORD_INDEX = 6
+};
+
+struct SessionRecorderSettings {
+    string path;
+    int tileSize = 64;
+    int changeThreshold = 16;                 // max per channel difference before a tile is sent again
+    long long frameIntervalMillis = 200;      // frames closer together than this are skipped
+    long long keyframeIntervalMillis = 10000;
+    double keyframeChangedRatio = 0.5;        // a delta with more changed tiles than this is written as a keyframe instead
+    int maxQueuedFrames = 4;
+    int maxQueuedEvents = 4096;
+    string imageFormat = ".png";
+};
+
+// records what the bot saw and did on a background thread
+// the record functions never block on disk, when the queue is full the item is dropped and counted
+class SessionRecorder {
+public:
+    explicit SessionRecorder(const SessionRecorderSettings &settings);
+    ~SessionRecorder();
+
+    bool start();
+    void stop();
+
+    void recordFrame(const Mat &frame);
+    void recordDetections(const vector<TemplateMatch> &detections);
+    void recordStatus(BotStatus from, BotStatus to);
+    void recordClick(int x, int y);
+
+    long long getDroppedFrames() const;
+    long long getDroppedEvents() const;
+
+private:
+    struct QueuedItem {
+        SessionRecordType type;
+        long long timestamp;
+        Mat frame;
+        vector<TemplateMatch> detections;
+        int values[2];
+    };
+
+    SessionRecorderSettings settings_;
+
+    mutex queueMutex_;
+    condition_variable queueCondition_;
+    deque<QueuedItem> queue_;
+    int queuedFrames_;
+    int queuedEvents_;
+    long long lastFrameMillis_;
+    bool running_;
+    thread writerThread_;
+
+    atomic<long long> droppedFrames_;
+    atomic<long long> droppedEvents_;
+
+    // only touched by the writer thread
+    ofstream file_;
+    Mat reference_;
+    long long lastKeyframeTimestamp_;
+    vector<pair<long long, unsigned long long>> keyframeIndex_;
+
+    void push(QueuedItem &&item, bool isFrame);
+    void writerLoop();
+    void writeItem(const QueuedItem &item);
+    void writeFrame(const Mat &frame, long long timestamp);
+    void writeRecord(SessionRecordType type, long long timestamp, const vector<uchar> &payload);
+    void writeIndex();
+};
+
+struct SessionRecord {
+    SessionRecordType type;
+    long long timestamp;
+    Mat frame;                            // reconstructed full frame for keyframes and deltas
+    vector<TemplateMatch> detections;
+    BotStatus fromStatus = SCANNING;
+    BotStatus toStatus = SCANNING;
+    Point click;
+};
+
+// replays a session file, frames are rebuilt from the last keyframe and the deltas after it
+class SessionReader {
+public:
+    bool open(const string &path);
+    bool seek(long long timestamp);
+    bool next(SessionRecord &record);
+
+    const vector<pair<long long, unsigned long long>> &keyframes() const;
+    Size frameSize() const;
+
+private:
+    ifstream file_;
+    int width_ = 0;
+    int height_ = 0;
+    int tileSize_ = 0;
+    unsigned long long recordsEnd_ = 0;
+    Mat frame_;
+    vector<pair<long long, unsigned long long>> keyframes_;
+
+    bool readIndex();
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core/utility.hpp>
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+
+#include "SparseTemplate.h"
+
+using namespace std;
+using namespace cv;
+
+struct SparseSums {
+    long long sum;
+    long long sumSquares;
+    long long sumProducts;
+};
+
+typedef void (*SparseAccumulator)(const uchar *origin, const ptrdiff_t *offsets, const SparseTemplate &sparse, SparseSums &sums);
+
+bool buildSparseTemplate(const Mat &grayscale, const Mat &alpha, SparseTemplate &sparse)
+{
+    sparse = SparseTemplate();
+
+    if (grayscale.empty() || alpha.empty() || grayscale.type() != CV_8UC1 || alpha.type() != CV_8UC1 || grayscale.size() != alpha.size())
+        return false;
+
+    sparse.width = grayscale.cols;
+    sparse.height = grayscale.rows;
+
+    for (int y = 0; y < grayscale.rows; y++)
+    {
+        const uchar *grayRow = grayscale.ptr<uchar>(y);
+        const uchar *alphaRow = alpha.ptr<uchar>(y);
+
+        int x = 0;
+        while (x < grayscale.cols)
+        {
+            // skipping the transparent pixels
+            if (alphaRow[x] == 0)
+            {
+                x++;
+                continue;
+            }
+
+            // splitting the opaque span into chunks
+            SparseChunk chunk = { y, x, 0 };
+            while (x < grayscale.cols && alphaRow[x] != 0 && chunk.count < SPARSE_CHUNK_WIDTH)
+            {
+                sparse.weights.emplace_back(grayRow[x]);
+                sparse.laneMasks.emplace_back(short(-1));
+                sparse.sum += grayRow[x];
+                sparse.sumSquares += double(grayRow[x]) * grayRow[x];
+                chunk.count++;
+                x++;
+            }
+            for (int i = chunk.count; i < SPARSE_CHUNK_WIDTH; i++)
+            {
+                sparse.weights.emplace_back(short(0));
+                sparse.laneMasks.emplace_back(short(0));
+            }
+
+            sparse.pixelCount += chunk.count;
+            sparse.chunks.emplace_back(chunk);
+        }
+    }
+
+    if (sparse.pixelCount == 0 || sparse.pixelCount > SPARSE_MAX_PIXELS)
+    {
+        sparse = SparseTemplate();
+        return false;
+    }
+
+    sparse.rowWidth = (sparse.width + SPARSE_CHUNK_WIDTH - 1) / SPARSE_CHUNK_WIDTH * SPARSE_CHUNK_WIDTH;
+    sparse.rowWeights.assign(sparse.rowWidth * sparse.height, 0);
+    sparse.rowMasks.assign(sparse.rowWidth * sparse.height, 0);
+    for (int c = 0; c < sparse.chunks.size(); c++)
+    {
+        const SparseChunk &chunk = sparse.chunks[c];
+        for (int i = 0; i < chunk.count; i++)
+        {
+            sparse.rowWeights[chunk.dy * sparse.rowWidth + chunk.dx + i] = sparse.weights[c * SPARSE_CHUNK_WIDTH + i];
+            sparse.rowMasks[chunk.dy * sparse.rowWidth + chunk.dx + i] = 0xff;
+        }
+    }
+
+    return true;
+}
+
+bool isSparseMatchModeSupported(TemplateMatchModes matchMode)
+{
+    switch (matchMode)
+    {
+    case TM_SQDIFF:
+    case TM_SQDIFF_NORMED:
+    case TM_CCORR:
+    case TM_CCORR_NORMED:
+    case TM_CCOEFF:
+    case TM_CCOEFF_NORMED:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void accumulateScalar(const uchar *origin, const ptrdiff_t *offsets, const SparseTemplate &sparse, SparseSums &sums)
+{
+    long long sum = 0, sumSquares = 0, sumProducts = 0;
+
+    for (int c = 0; c < sparse.chunks.size(); c++)
+    {
+        const uchar *pixels = origin + offsets[c];
+        const short *weights = &sparse.weights[c * SPARSE_CHUNK_WIDTH];
+        for (int i = 0; i < sparse.chunks[c].count; i++)
+        {
+            int pixel = pixels[i];
+            sum += pixel;
+            sumSquares += pixel * pixel;
+            sumProducts += pixel * weights[i];
+        }
+    }
+
+    sums.sum = sum;
+    sums.sumSquares = sumSquares;
+    sums.sumProducts = sumProducts;
+}
+
+SPARSE_TARGET_AVX2 static long long horizontalSumAvx2(__m256i v)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+SPARSE_TARGET_AVX2 static void accumulateAvx2(const uchar *origin, const ptrdiff_t *offsets, const SparseTemplate &sparse, SparseSums &sums)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i sumSquares = _mm256_setzero_si256();
+    __m256i sumProducts = _mm256_setzero_si256();
+
+    const short *weights = sparse.weights.data();
+    const short *laneMasks = sparse.laneMasks.data();
+
+    for (int c = 0; c < sparse.chunks.size(); c++)
+    {
+        // widening the 16 pixels to 16 bit and zeroing the lanes past the end of the chunk
+        __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(origin + offsets[c])));
+        pixels = _mm256_and_si256(pixels, _mm256_loadu_si256((const __m256i *)(laneMasks + c * SPARSE_CHUNK_WIDTH)));
+        __m256i weight = _mm256_loadu_si256((const __m256i *)(weights + c * SPARSE_CHUNK_WIDTH));
+
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pixels, ones));
+        sumSquares = _mm256_add_epi32(sumSquares, _mm256_madd_epi16(pixels, pixels));
+        sumProducts = _mm256_add_epi32(sumProducts, _mm256_madd_epi16(pixels, weight));
+    }
+
+    sums.sum = horizontalSumAvx2(sum);
+    sums.sumSquares = horizontalSumAvx2(sumSquares);
+    sums.sumProducts = horizontalSumAvx2(sumProducts);
+}
+
+SPARSE_TARGET_AVX512 static void accumulateAvx512(const uchar *origin, const ptrdiff_t *offsets, const SparseTemplate &sparse, SparseSums &sums)
+{
+    const __m512i ones = _mm512_set1_epi16(1);
+    __m512i sum = _mm512_setzero_si512();
+    __m512i sumSquares = _mm512_setzero_si512();
+    __m512i sumProducts = _mm512_setzero_si512();
+
+    const short *weights = sparse.weights.data();
+    const short *laneMasks = sparse.laneMasks.data();
+    int chunkCount = sparse.chunks.size();
+
+    // two chunks per iteration, their weights and masks are next to eachother in memory
+    int c = 0;
+    for (; c + 1 < chunkCount; c += 2)
+    {
+        __m256i packed = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(origin + offsets[c]))),
+            _mm_loadu_si128((const __m128i *)(origin + offsets[c + 1])), 1);
+        __m512i pixels = _mm512_cvtepu8_epi16(packed);
+        pixels = _mm512_and_si512(pixels, _mm512_loadu_si512((const void *)(laneMasks + c * SPARSE_CHUNK_WIDTH)));
+        __m512i weight = _mm512_loadu_si512((const void *)(weights + c * SPARSE_CHUNK_WIDTH));
+
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(pixels, ones));
+        sumSquares = _mm512_add_epi32(sumSquares, _mm512_madd_epi16(pixels, pixels));
+        sumProducts = _mm512_add_epi32(sumProducts, _mm512_madd_epi16(pixels, weight));
+    }
+
+    long long tailSum = 0, tailSumSquares = 0, tailSumProducts = 0;
+    if (c < chunkCount)
+    {
+        __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(origin + offsets[c])));
+        pixels = _mm256_and_si256(pixels, _mm256_loadu_si256((const __m256i *)(laneMasks + c * SPARSE_CHUNK_WIDTH)));
+        __m256i weight = _mm256_loadu_si256((const __m256i *)(weights + c * SPARSE_CHUNK_WIDTH));
+
+        tailSum = horizontalSumAvx2(_mm256_madd_epi16(pixels, _mm256_set1_epi16(1)));
+        tailSumSquares = horizontalSumAvx2(_mm256_madd_epi16(pixels, pixels));
+        tailSumProducts = horizontalSumAvx2(_mm256_madd_epi16(pixels, weight));
+    }
+
+    sums.sum = _mm512_reduce_add_epi32(sum) + tailSum;
+    sums.sumSquares = _mm512_reduce_add_epi32(sumSquares) + tailSumSquares;
+    sums.sumProducts = _mm512_reduce_add_epi32(sumProducts) + tailSumProducts;
+}
+
+static float computeScore(const SparseSums &sums, const SparseTemplate &sparse, TemplateMatchModes matchMode)
+{
+    return computeMatchScore(matchMode, sparse.pixelCount, double(sums.sum), double(sums.sumSquares), double(sums.sumProducts), sparse.sum, sparse.sumSquares);
+}
+
+void matchSparseTemplate(const uchar *image, size_t imageStep, int imageRows, int imageCols, const SparseTemplate &sparse, TemplateMatchModes matchMode,
+    float *result, size_t resultStep)
+{
+    int resultRows = imageRows - sparse.height + 1;
+    int resultCols = imageCols - sparse.width + 1;
+    if (resultRows <= 0 || resultCols <= 0) return;
+
+    // the chunk offsets only depend on the row stride so they are resolved once per call
+    vector<ptrdiff_t> offsets(sparse.chunks.size());
+    ptrdiff_t maxOffset = 0;
+    for (int c = 0; c < sparse.chunks.size(); c++)
+    {
+        offsets[c] = ptrdiff_t(sparse.chunks[c].dy) * imageStep + sparse.chunks[c].dx;
+        maxOffset = max(maxOffset, offsets[c]);
+    }
+
+    SparseAccumulator accumulate = accumulateScalar;
+    if (checkHardwareSupport(CV_CPU_AVX_512BW)) accumulate = accumulateAvx512;
+    else if (checkHardwareSupport(CV_CPU_AVX2)) accumulate = accumulateAvx2;
+
+    // the vector loads always read whole chunks, so positions where that would go past the end of the image use the scalar path
+    const uchar *imageEnd = image + ptrdiff_t(imageRows - 1) * imageStep + imageCols;
+
+    SparseSums sums;
+    for (int y = 0; y < resultRows; y++)
+    {
+        float *resultRow = (float *)((uchar *)result + y * resultStep);
+        for (int x = 0; x < resultCols; x++)
+        {
+            const uchar *origin = image + ptrdiff_t(y) * imageStep + x;
+
+            if (origin + maxOffset + SPARSE_CHUNK_WIDTH <= imageEnd) accumulate(origin, offsets.data(), sparse, sums);
+            else accumulateScalar(origin, offsets.data(), sparse, sums);
+
+            resultRow[x] = computeScore(sums, sparse, matchMode);
+        }
+    }
+}
+
+void matchSparseTemplate(const Mat &grayscaleScreenshot, const SparseTemplate &sparse, TemplateMatchModes matchMode, Mat &result)
+{
+    CV_Assert(grayscaleScreenshot.type() == CV_8UC1);
+
+    int resultRows = grayscaleScreenshot.rows - sparse.height + 1;
+    int resultCols = grayscaleScreenshot.cols - sparse.width + 1;
+    if (resultRows <= 0 || resultCols <= 0)
+    {
+        result = Mat();
+        return;
+    }
+
+    result.create(resultRows, resultCols, CV_32FC1);
+    matchSparseTemplate(grayscaleScreenshot.data, grayscaleScreenshot.step, grayscaleScreenshot.rows, grayscaleScreenshot.cols, sparse, matchMode,
+        (float *)result.data, result.step);
+}
@@ -0,0 +1,98 @@
+#ifndef SPARSE_TEMPLATE
+#define SPARSE_TEMPLATE
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cv;
+
+// msvc allows intrinsics of any instruction set in any function, gcc and clang need them enabled per function
+#if defined(_MSC_VER)
+#define SPARSE_TARGET_AVX2
+#define SPARSE_TARGET_AVX512
+#else
+#define SPARSE_TARGET_AVX2 __attribute__((target("avx2")))
+#define SPARSE_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+#endif
+
+// amount of template pixels handled by a single chunk, one 128 bit load of 8 bit pixels
+constexpr int SPARSE_CHUNK_WIDTH = 16;
+
+// the sums are accumulated in 32 bit lanes, this keeps the sum of squares from overflowing
+constexpr int SPARSE_MAX_PIXELS = 30000;
+
+// a horizontal span of up to SPARSE_CHUNK_WIDTH opaque pixels of the template
+struct SparseChunk {
+    int dy;
+    int dx;
+    int count;
+};
+
+// template compressed down to its opaque pixels, built once when the templates are loaded
+// weights and lane masks hold SPARSE_CHUNK_WIDTH entries per chunk, zero padded after count
+struct SparseTemplate {
+    int width = 0;
+    int height = 0;
+    int pixelCount = 0;
+
+    vector<SparseChunk> chunks;
+    vector<short> weights;
+    vector<short> laneMasks;
+
+    // the same pixels as whole rows padded to full chunks, transparent pixels have zero weight and mask, for the fixed size kernels
+    int rowWidth = 0;
+    vector<short> rowWeights;
+    vector<uchar> rowMasks;
+
+    double sum = 0;
+    double sumSquares = 0;
+
+    bool empty() const { return chunks.empty(); }
+};
+
+// same normalisation and clamping as cv::matchTemplate, so thresholds tuned on it stay valid
+inline float computeMatchScore(TemplateMatchModes matchMode, double pixelCount, double windowSum, double windowSumSquares, double products,
+    double templateSum, double templateSumSquares)
+{
+    double numerator;
+    double denominator;
+
+    switch (matchMode)
+    {
+    case TM_SQDIFF:
+        return float(windowSumSquares - 2 * products + templateSumSquares);
+    case TM_CCORR:
+        return float(products);
+    case TM_CCOEFF:
+        return float(products - windowSum * templateSum / pixelCount);
+    case TM_SQDIFF_NORMED:
+        numerator = windowSumSquares - 2 * products + templateSumSquares;
+        denominator = sqrt(max(windowSumSquares, 0.0) * templateSumSquares);
+        break;
+    case TM_CCORR_NORMED:
+        numerator = products;
+        denominator = sqrt(max(windowSumSquares, 0.0) * templateSumSquares);
+        break;
+    default:
+        numerator = products - windowSum * templateSum / pixelCount;
+        denominator = sqrt(max(windowSumSquares - windowSum * windowSum / pixelCount, 0.0)
+            * max(templateSumSquares - templateSum * templateSum / pixelCount, 0.0));
+        break;
+    }
+
+    if (fabs(numerator) < denominator) return float(numerator / denominator);
+    if (fabs(numerator) < denominator * 1.125) return numerator > 0 ? 1.0f : -1.0f;
+    return matchMode == TM_SQDIFF_NORMED ? 1.0f : 0.0f;
+}
+
+bool buildSparseTemplate(const Mat &grayscale, const Mat &alpha, SparseTemplate &sparse);
+bool isSparseMatchModeSupported(TemplateMatchModes matchMode);
+void matchSparseTemplate(const Mat &grayscaleScreenshot, const SparseTemplate &sparse, TemplateMatchModes matchMode, Mat &result);
+void matchSparseTemplate(const uchar *image, size_t imageStep, int imageRows, int imageCols, const SparseTemplate &sparse, TemplateMatchModes matchMode,
+    float *result, size_t resultStep);
+
+#endif
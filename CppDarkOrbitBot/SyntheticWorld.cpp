@@ -0,0 +1,200 @@
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <fstream>
+
+#include "SyntheticWorld.h"
+
+using namespace std;
+using namespace cv;
+
+// how many random positions an object gets before it is left out of a crowded frame
+constexpr int PLACEMENT_ATTEMPTS = 50;
+// the hud is only drawn inside this band along the frame borders, like the real one
+constexpr int HUD_BORDER = 120;
+
+static const vector<string> HUD_TEXTS = {
+    "HP 236000/236000", "SHD 180000", "Cargo 1532/4000", "x: 104 y: 52", "5-2", "Palladium", "Lvl 22", "Uridium 45210", "Credits 12 504 002"
+};
+
+// alpha blends the sprite into the image, the rect has to be inside the image
+static void blendSprite(Mat &image, const Mat &sprite, const Mat &alpha, Point position)
+{
+    for (int y = 0; y < sprite.rows; y++)
+    {
+        const uchar *spriteRow = sprite.ptr<uchar>(y);
+        const uchar *alphaRow = alpha.empty() ? nullptr : alpha.ptr<uchar>(y);
+        uchar *imageRow = image.ptr<uchar>(position.y + y) + position.x;
+
+        for (int x = 0; x < sprite.cols; x++)
+        {
+            int a = alphaRow ? alphaRow[x] : 255;
+            imageRow[x] = uchar((spriteRow[x] * a + imageRow[x] * (255 - a) + 127) / 255);
+        }
+    }
+}
+
+SyntheticWorldGenerator::SyntheticWorldGenerator(const vector<Template> &sprites, const vector<Template> &clutter, unsigned int seed) :
+    sprites_(sprites), clutter_(clutter), random_(seed != 0 ? seed : random_device()())
+{
+}
+
+void SyntheticWorldGenerator::generate(const SyntheticWorldSettings &settings, SyntheticFrame &frame)
+{
+    frame.image.create(settings.frameSize, CV_8UC1);
+    frame.labels.assign(TEMPLATE_COUNT, vector<Rect>());
+
+    // marks the pixels already covered by the hud or an object
+    Mat occupied = Mat::zeros(settings.frameSize, CV_8UC1);
+
+    drawBackground(settings, frame.image);
+    drawHud(settings, frame.image, occupied);
+    drawObjects(settings, frame.image, occupied, frame.labels);
+    addNoise(settings, frame.image);
+}
+
+void SyntheticWorldGenerator::drawBackground(const SyntheticWorldSettings &settings, Mat &image)
+{
+    // low frequency nebula, random values on a coarse grid blown up to the frame size
+    Mat coarse(max(2, settings.frameSize.height / 64), max(2, settings.frameSize.width / 64), CV_32FC1);
+    RNG rng(random_());
+    rng.fill(coarse, RNG::UNIFORM, 0.0, 1.0);
+
+    Mat nebula;
+    resize(coarse, nebula, settings.frameSize, 0, 0, INTER_CUBIC);
+    nebula.convertTo(image, CV_8UC1, 40.0, 8.0);
+
+    uniform_int_distribution<int> starX(0, settings.frameSize.width - 1);
+    uniform_int_distribution<int> starY(0, settings.frameSize.height - 1);
+    uniform_int_distribution<int> starBrightness(90, 255);
+    uniform_int_distribution<int> starRadius(0, 1);
+    for (int i = 0; i < settings.starCount; i++)
+    {
+        circle(image, Point(starX(random_), starY(random_)), starRadius(random_), Scalar(starBrightness(random_)), FILLED, LINE_AA);
+    }
+}
+
+void SyntheticWorldGenerator::drawHud(const SyntheticWorldSettings &settings, Mat &image, Mat &occupied)
+{
+    Rect frameRect(Point(0, 0), settings.frameSize);
+    uniform_int_distribution<int> kind(0, clutter_.empty() ? 1 : 2);
+    uniform_int_distribution<int> side(0, 3);
+    uniform_int_distribution<int> panelSize(40, 220);
+    uniform_int_distribution<int> textIndex(0, int(HUD_TEXTS.size()) - 1);
+
+    for (int i = 0; i < settings.hudElements; i++)
+    {
+        // picking a spot inside the border band on one of the four sides
+        int s = side(random_);
+        int x = uniform_int_distribution<int>(0, settings.frameSize.width - 1)(random_);
+        int y = uniform_int_distribution<int>(0, settings.frameSize.height - 1)(random_);
+        int inset = uniform_int_distribution<int>(0, HUD_BORDER / 2)(random_);
+        if (s == 0) y = inset;
+        if (s == 1) y = max(0, settings.frameSize.height - HUD_BORDER + inset);
+        if (s == 2) x = inset;
+        if (s == 3) x = max(0, settings.frameSize.width - HUD_BORDER + inset);
+
+        Rect area;
+        switch (kind(random_))
+        {
+        case 0:
+        {
+            area = Rect(x, y, panelSize(random_), panelSize(random_) / 3) & frameRect;
+            rectangle(image, area, Scalar(25), FILLED);
+            rectangle(image, area, Scalar(150), 1);
+            break;
+        }
+        case 1:
+        {
+            const string &text = HUD_TEXTS[textIndex(random_)];
+            int baseline;
+            Size textSize = getTextSize(text, FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseline);
+            area = Rect(x, y, textSize.width, textSize.height + baseline) & frameRect;
+            putText(image, text, Point(x, y + textSize.height), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(220), 1, LINE_AA);
+            break;
+        }
+        default:
+        {
+            const Template &sprite = clutter_[uniform_int_distribution<int>(0, int(clutter_.size()) - 1)(random_)];
+            area = Rect(Point(x, y), sprite.grayscale.size());
+            if ((area & frameRect) != area) continue;
+            blendSprite(image, sprite.grayscale, sprite.alpha, area.tl());
+            break;
+        }
+        }
+
+        if (area.area() > 0) occupied(area).setTo(255);
+    }
+}
+
+void SyntheticWorldGenerator::drawObjects(const SyntheticWorldSettings &settings, Mat &image, Mat &occupied, vector<vector<Rect>> &labels)
+{
+    if (sprites_.empty()) return;
+
+    uniform_int_distribution<int> spriteIndex(0, int(sprites_.size()) - 1);
+    uniform_real_distribution<double> scale(settings.minimumScale, max(settings.minimumScale, settings.maximumScale));
+
+    Mat scaledSprite, scaledAlpha;
+    for (int i = 0; i < settings.objectCount; i++)
+    {
+        const Template &sprite = sprites_[spriteIndex(random_)];
+        double factor = scale(random_);
+
+        const Mat *grayscale = &sprite.grayscale;
+        const Mat *alpha = &sprite.alpha;
+        if (factor != 1.0)
+        {
+            Size scaledSize(max(1, cvRound(sprite.grayscale.cols * factor)), max(1, cvRound(sprite.grayscale.rows * factor)));
+            resize(sprite.grayscale, scaledSprite, scaledSize, 0, 0, INTER_LINEAR);
+            if (!sprite.alpha.empty()) resize(sprite.alpha, scaledAlpha, scaledSize, 0, 0, INTER_LINEAR);
+            grayscale = &scaledSprite;
+            alpha = sprite.alpha.empty() ? &sprite.alpha : &scaledAlpha;
+        }
+
+        if (grayscale->cols > settings.frameSize.width || grayscale->rows > settings.frameSize.height) continue;
+
+        uniform_int_distribution<int> positionX(0, settings.frameSize.width - grayscale->cols);
+        uniform_int_distribution<int> positionY(0, settings.frameSize.height - grayscale->rows);
+
+        for (int attempt = 0; attempt < PLACEMENT_ATTEMPTS; attempt++)
+        {
+            Rect rect(Point(positionX(random_), positionY(random_)), grayscale->size());
+            if (!settings.allowOverlap && countNonZero(occupied(rect)) > 0) continue;
+
+            blendSprite(image, *grayscale, *alpha, rect.tl());
+            occupied(rect).setTo(255);
+            labels[sprite.identifier].push_back(rect);
+            break;
+        }
+    }
+}
+
+void SyntheticWorldGenerator::addNoise(const SyntheticWorldSettings &settings, Mat &image)
+{
+    if (settings.noiseSigma <= 0) return;
+
+    Mat noise(image.size(), CV_16SC1);
+    RNG rng(random_());
+    rng.fill(noise, RNG::NORMAL, 0.0, settings.noiseSigma);
+
+    Mat widened;
+    image.convertTo(widened, CV_16SC1);
+    widened += noise;
+    widened.convertTo(image, CV_8UC1);
+}
+
+bool saveSyntheticFrame(const SyntheticFrame &frame, const vector<Template> &templates, const string &imagePath)
+{
+    if (!imwrite(imagePath, frame.image)) return false;
+
+    ofstream labelFile(filesystem::path(imagePath).replace_extension(".txt"));
+    if (!labelFile.is_open()) return false;
+
+    for (int i = 0; i < frame.labels.size() && i < templates.size(); i++)
+    {
+        for (const Rect &rect : frame.labels[i])
+        {
+            labelFile << templates[i].name << " " << rect.x << " " << rect.y << " " << rect.width << " " << rect.height << "\n";
+        }
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef SYNTHETIC_WORLD
+#define SYNTHETIC_WORLD
+
+#include <opencv2/core/types.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+struct SyntheticWorldSettings {
+    Size frameSize = Size(1920, 1080);
+    int objectCount = 50;                 // sprites scattered over the frame, every one of them ends up in the labels
+    double minimumScale = 1.0;            // every sprite is resized by a random factor in this range
+    double maximumScale = 1.0;
+    bool allowOverlap = false;            // without overlap the objects that dont fit anymore are left out
+    int starCount = 400;
+    int hudElements = 12;                 // panels, text and hud template sprites along the frame borders
+    double noiseSigma = 4.0;              // gaussian noise added on top of everything
+};
+
+// one generated frame, grayscale like the frames the capture hands to the matcher
+// labels are indexed by template identifier and hold the rect every object was drawn at
+struct SyntheticFrame {
+    Mat image;
+    vector<vector<Rect>> labels;
+};
+
+// composites the template sprites with their alpha onto a procedural space background at known positions
+class SyntheticWorldGenerator {
+public:
+    // objects are picked from sprites, clutter is only drawn as part of the hud and never labeled
+    // seed 0 picks a random seed
+    SyntheticWorldGenerator(const vector<Template> &sprites, const vector<Template> &clutter, unsigned int seed = 0);
+
+    void generate(const SyntheticWorldSettings &settings, SyntheticFrame &frame);
+
+private:
+    vector<Template> sprites_;
+    vector<Template> clutter_;
+    mt19937 random_;
+
+    void drawBackground(const SyntheticWorldSettings &settings, Mat &image);
+    void drawHud(const SyntheticWorldSettings &settings, Mat &image, Mat &occupied);
+    void drawObjects(const SyntheticWorldSettings &settings, Mat &image, Mat &occupied, vector<vector<Rect>> &labels);
+    void addNoise(const SyntheticWorldSettings &settings, Mat &image);
+};
+
+// writes the image and a label file next to it in the format the threshold sweep reads
+bool saveSyntheticFrame(const SyntheticFrame &frame, const vector<Template> &templates, const string &imagePath);
+
+#endif
@@ -0,0 +1,72 @@
+#include <opencv2/imgproc.hpp>
+#include <array>
+#include <utility>
+
+#include "BotUtils.h"
+#include "Constants.h"
+#include "FixedSizeKernel.h"
+#include "TemplateRegistry.h"
+
+using namespace std;
+using namespace cv;
+
+template<size_t Index>
+constexpr FixedSizeKernel fixedSizeKernelFor()
+{
+    constexpr TemplateDescriptor descriptor = TEMPLATE_REGISTRY[Index];
+    if constexpr (descriptor.kernel == KERNEL_FIXED_SIZE)
+        return &matchFixedSizeTemplate<descriptor.width, descriptor.height, descriptor.matchingMode>;
+    else
+        return nullptr;
+}
+
+template<size_t... Indexes>
+constexpr array<FixedSizeKernel, TEMPLATE_COUNT> createFixedSizeKernelTable(index_sequence<Indexes...>)
+{
+    return { fixedSizeKernelFor<Indexes>()... };
+}
+
+// one kernel instantiation per (width, height, mode) declared in the registry
+static constexpr array<FixedSizeKernel, TEMPLATE_COUNT> FIXED_SIZE_KERNELS = createFixedSizeKernelTable(make_index_sequence<TEMPLATE_COUNT>());
+
+vector<Template> createTemplatesFromRegistry()
+{
+    vector<Template> templates;
+
+    for (int i = 0; i < TEMPLATE_REGISTRY.size(); i++)
+    {
+        const TemplateDescriptor &descriptor = TEMPLATE_REGISTRY[i];
+
+        Template entry = { descriptor.path, descriptor.identifier, descriptor.matchingMode, descriptor.confidenceThreshold,
+            descriptor.useDividedScreenshot, descriptor.multipleMatches, Mat(), Mat() };
+        entry.fixedSizeKernel = FIXED_SIZE_KERNELS[i];
+
+        templates.emplace_back(entry);
+    }
+
+    return templates;
+}
+
+bool verifyTemplateSizes(vector<Template> &templates)
+{
+    bool sizesMatch = true;
+
+    for (int i = 0; i < templates.size(); i++)
+    {
+        const TemplateDescriptor &descriptor = TEMPLATE_REGISTRY[templates[i].identifier];
+
+        if (templates[i].grayscale.empty()) continue;
+
+        if (templates[i].grayscale.cols != descriptor.width || templates[i].grayscale.rows != descriptor.height)
+        {
+            printWithTimestamp("Template " + templates[i].name + " is " + to_string(templates[i].grayscale.cols) + "x" + to_string(templates[i].grayscale.rows)
+                + " but registered as " + to_string(descriptor.width) + "x" + to_string(descriptor.height), RED_TEXT_BLACK_BACKGROUND);
+
+            // the fixed size kernel was built for the registered size so it cant be used for this image
+            templates[i].fixedSizeKernel = nullptr;
+            sizesMatch = false;
+        }
+    }
+
+    return sizesMatch;
+}
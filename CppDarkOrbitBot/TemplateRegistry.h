@@ -0,0 +1,123 @@
+#ifndef TEMPLATE_REGISTRY_H
+#define TEMPLATE_REGISTRY_H
+
+#include <opencv2/imgproc.hpp>
+#include <array>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+enum TemplateFlags {
+    TEMPLATE_RESOURCE = 1,
+    TEMPLATE_MINIMAP = 2,
+    TEMPLATE_HUD = 4
+};
+
+// KERNEL_DEFAULT uses the sparse kernel for masked templates and opencv for the rest
+// KERNEL_FIXED_SIZE adds a sparse kernel built for the registered size and mode, used for the small searches around known positions
+enum TemplateKernel {
+    KERNEL_DEFAULT = 0,
+    KERNEL_FIXED_SIZE = 1
+};
+
+struct TemplateDescriptor {
+    TemplateIdentifier identifier;
+    const char *path;
+    int width;
+    int height;
+    TemplateMatchModes matchingMode;
+    double confidenceThreshold;
+    bool useDividedScreenshot;
+    bool multipleMatches;
+    int flags;
+    TemplateKernel kernel;
+};
+
+// every template the bot knows about, ordered by identifier
+// sizes have to match the png files, they are checked again once the images are loaded and the fixed size kernels are built for them
+// palladium is searched every frame in the tracking windows and in the collection region, both small enough for its fixed size kernel
+constexpr array<TemplateDescriptor, TEMPLATE_COUNT> TEMPLATE_REGISTRY = {{
+    {PALLADIUM, "C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\palladium1.png", 38, 46, TM_CCOEFF_NORMED, 0.75, true, true, TEMPLATE_RESOURCE, KERNEL_FIXED_SIZE},
+    {CARGO_ICON, "C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\cargo_icon.png", 24, 21, TM_SQDIFF_NORMED, 0.1, false, false, TEMPLATE_HUD, KERNEL_DEFAULT},
+    {PROMETIUM, "C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\prometium1.png", 44, 31, TM_CCOEFF_NORMED, 0.75, true, true, 0, KERNEL_DEFAULT},
+    {ENDURIUM, "C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\endurium2.png", 33, 27, TM_CCOEFF_NORMED, 0.7, true, true, 0, KERNEL_DEFAULT},
+    {MINIMAP_ICON, "C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\minimap_icon.png", 22, 25, TM_SQDIFF_NORMED, 0.1, false, false, TEMPLATE_MINIMAP | TEMPLATE_HUD, KERNEL_DEFAULT},
+    {MINIMAP_BUTTONS, "C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\minimap_buttons.png", 32, 32, TM_SQDIFF_NORMED, 0.1, false, false, TEMPLATE_MINIMAP | TEMPLATE_HUD, KERNEL_DEFAULT},
+    {ENDURIUM_VARIANT, "C:\\Users\\climd\\source\\repos\\CppDarkOrbitBot\\pngs\\endurium1.png", 33, 27, TM_CCOEFF_NORMED, 0.7, true, true, 0, KERNEL_DEFAULT}
+}};
+
+constexpr bool isRegistryOrderedByIdentifier()
+{
+    for (int i = 0; i < TEMPLATE_REGISTRY.size(); i++)
+    {
+        if (TEMPLATE_REGISTRY[i].identifier != i) return false;
+    }
+    return true;
+}
+
+// the fixed size kernels are sparse kernels, a mode the sparse kernel doesnt support cant get one
+constexpr bool areFixedSizeKernelModesSupported()
+{
+    for (const TemplateDescriptor &descriptor : TEMPLATE_REGISTRY)
+    {
+        if (descriptor.kernel != KERNEL_FIXED_SIZE) continue;
+        switch (descriptor.matchingMode)
+        {
+        case TM_SQDIFF: case TM_SQDIFF_NORMED: case TM_CCORR: case TM_CCORR_NORMED: case TM_CCOEFF: case TM_CCOEFF_NORMED:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr int countTemplatesWithFlag(int flag)
+{
+    int count = 0;
+    for (const TemplateDescriptor &descriptor : TEMPLATE_REGISTRY)
+    {
+        if (descriptor.flags & flag) count++;
+    }
+    return count;
+}
+
+template<int Flag>
+constexpr array<TemplateIdentifier, countTemplatesWithFlag(Flag)> templatesWithFlag()
+{
+    array<TemplateIdentifier, countTemplatesWithFlag(Flag)> identifiers{};
+    int count = 0;
+    for (const TemplateDescriptor &descriptor : TEMPLATE_REGISTRY)
+    {
+        if (descriptor.flags & Flag) identifiers[count++] = descriptor.identifier;
+    }
+    return identifiers;
+}
+
+constexpr auto RESOURCE_TEMPLATES = templatesWithFlag<TEMPLATE_RESOURCE>();
+constexpr auto MINIMAP_TEMPLATES = templatesWithFlag<TEMPLATE_MINIMAP>();
+
+// templates[identifier] only works as long as the registry order matches the enum
+static_assert(isRegistryOrderedByIdentifier(), "TEMPLATE_REGISTRY must be ordered by TemplateIdentifier");
+static_assert(areFixedSizeKernelModesSupported(), "KERNEL_FIXED_SIZE templates must use a matching mode the sparse kernel supports");
+// the resource matches are written into matchedTemplates[0] and read back as matchedTemplates[PALLADIUM]
+static_assert(RESOURCE_TEMPLATES.size() == 1 && RESOURCE_TEMPLATES[0] == PALLADIUM, "Resource matches are read back through the PALLADIUM index");
+// the minimap rect is computed from the icon match followed by the buttons match
+static_assert(MINIMAP_TEMPLATES.size() == 2 && MINIMAP_TEMPLATES[0] == MINIMAP_ICON && MINIMAP_TEMPLATES[1] == MINIMAP_BUTTONS,
+    "Minimap detection expects the icon and the buttons templates in this order");
+
+vector<Template> createTemplatesFromRegistry();
+bool verifyTemplateSizes(vector<Template> &templates);
+
+template<size_t N>
+vector<Template> selectTemplates(const vector<Template> &templates, const array<TemplateIdentifier, N> &identifiers)
+{
+    vector<Template> selected;
+    for (TemplateIdentifier identifier : identifiers) selected.emplace_back(templates[identifier]);
+    return selected;
+}
+
+#endif
@@ -1,25 +1,95 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(size_t threads) {
+#include <chrono>
+
+static long long microsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point finish) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+}
+
+static int bucketIndex(long long micros) {
+    int bucket = 0;
+    while (bucket < THREAD_POOL_HISTOGRAM_BUCKETS - 1 && (1LL << bucket) <= micros) ++bucket;
+    return bucket;
+}
+
+ThreadPoolStats ThreadPoolStats::since(const ThreadPoolStats &previous) const {
+    ThreadPoolStats difference = *this;
+    difference.queueDepthSamples -= previous.queueDepthSamples;
+    difference.queueDepthTotal -= previous.queueDepthTotal;
+    for (size_t i = 0; i < workerTasks.size() && i < previous.workerTasks.size(); ++i) {
+        difference.workerBusyMicros[i] -= previous.workerBusyMicros[i];
+        difference.workerIdleMicros[i] -= previous.workerIdleMicros[i];
+        difference.workerTasks[i] -= previous.workerTasks[i];
+    }
+    for (size_t i = 0; i < queueWaitBuckets.size() && i < previous.queueWaitBuckets.size(); ++i) {
+        difference.queueWaitBuckets[i] -= previous.queueWaitBuckets[i];
+        difference.runTimeBuckets[i] -= previous.runTimeBuckets[i];
+    }
+    difference.contendedLocks -= previous.contendedLocks;
+    difference.callerChunks -= previous.callerChunks;
+    difference.workerChunks -= previous.workerChunks;
+    difference.missedDeadlines -= previous.missedDeadlines;
+    difference.skippedIndexes -= previous.skippedIndexes;
+    return difference;
+}
+
+double ThreadPoolStats::averageQueueDepth() const {
+    return queueDepthSamples > 0 ? double(queueDepthTotal) / queueDepthSamples : 0.0;
+}
+
+unsigned long long ThreadPoolStats::taskCount() const {
+    unsigned long long total = 0;
+    for (unsigned long long tasks : workerTasks) total += tasks;
+    return total;
+}
+
+long long ThreadPoolStats::percentileMicros(const std::vector<unsigned long long> &buckets, double p) {
+    unsigned long long total = 0;
+    for (unsigned long long count : buckets) total += count;
+    if (total == 0) return 0;
+
+    unsigned long long rank = (unsigned long long)(p * (total - 1)) + 1;
+    unsigned long long seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return 1LL << i;
+    }
+    return 1LL << (buckets.size() - 1);
+}
+
+ThreadPool::ThreadPool(size_t threads) : workerCounters(new WorkerCounters[threads]) {
     for (size_t i = 0; i < threads; ++i) {
-        workers.emplace_back([this]() {
+        workers.emplace_back([this, i]() {
+            WorkerCounters &counters = workerCounters[i];
+
             while (true) {
-                std::function<void()> task;
+                QueuedTask queued;
                 {
-                    std::unique_lock<std::mutex> lock(queueMutex);
+                    auto idleStart = std::chrono::steady_clock::now();
+                    std::unique_lock<std::mutex> lock = lockQueue();
                     condition.wait(lock, [this]() { return stop || !taskQueue.empty(); });
+                    counters.idleMicros += microsBetween(idleStart, std::chrono::steady_clock::now());
 
                     if (stop && taskQueue.empty()) return;
 
-                    task = std::move(taskQueue.front());
+                    queued = std::move(taskQueue.front());
                     taskQueue.pop();
                     ++activeThreads;
                 }
 
-                task();
+                auto taskStart = std::chrono::steady_clock::now();
+                queueWaitBuckets[bucketIndex(microsBetween(queued.enqueued, taskStart))]++;
+
+                queued.task();
+
+                long long taskMicros = microsBetween(taskStart, std::chrono::steady_clock::now());
+                busyMicros += taskMicros;
+                counters.busyMicros += taskMicros;
+                counters.tasks++;
+                runTimeBuckets[bucketIndex(taskMicros)]++;
 
                 {
-                    std::unique_lock<std::mutex> lock(queueMutex);
+                    std::unique_lock<std::mutex> lock = lockQueue();
                     --activeThreads;
                     condition.notify_all();
                 }
@@ -39,15 +109,141 @@ ThreadPool::~ThreadPool() {
     }
 }
 
+// counts the times the lock was already held, a high count means the tile tasks are too small for the pool size
+std::unique_lock<std::mutex> ThreadPool::lockQueue() {
+    std::unique_lock<std::mutex> lock(queueMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        contendedLocks++;
+        lock.lock();
+    }
+    return lock;
+}
+
 void ThreadPool::enqueue(std::function<void()> task) {
     {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        taskQueue.push(std::move(task));
+        std::unique_lock<std::mutex> lock = lockQueue();
+        taskQueue.push(QueuedTask{ std::move(task), std::chrono::steady_clock::now() });
+
+        maxQueueDepth = std::max(maxQueueDepth, taskQueue.size());
+        queueDepthSamples++;
+        queueDepthTotal += taskQueue.size();
     }
     condition.notify_one();
 }
 
 void ThreadPool::waitForCompletion() {
-    std::unique_lock<std::mutex> lock(queueMutex);
+    std::unique_lock<std::mutex> lock = lockQueue();
     condition.wait(lock, [this]() { return taskQueue.empty() && activeThreads == 0; });
 }
+
+void ThreadPool::parallelFor(int count, int chunkSize, const std::function<void(int)> &body) {
+    TaskDeadline unlimited;
+    unlimited.requiredCount = count;
+    parallelFor(count, chunkSize, body, unlimited);
+}
+
+int ThreadPool::parallelFor(int count, int chunkSize, const std::function<void(int)> &body, const TaskDeadline &deadline) {
+    if (count <= 0) return 0;
+    chunkSize = std::max(1, chunkSize);
+
+    struct Batch {
+        std::atomic<int> nextIndex{ 0 };
+        std::atomic<int> completed{ 0 };
+        std::atomic<bool> cancelled{ false };
+        int count;
+        int chunkSize;
+        int requiredCount;
+        std::chrono::steady_clock::time_point deadline;
+        const std::function<void(int)> *body;
+
+        // returns how many chunks this thread ran
+        // the indexes are handed out in order, so once an optional one is cancelled every one after it is optional too
+        int run() {
+            int chunks = 0;
+            int done = 0;
+            while (true) {
+                int first = nextIndex.fetch_add(chunkSize);
+                if (first >= count) break;
+
+                int last = std::min(count, first + chunkSize);
+                bool stopped = false;
+                for (int i = first; i < last; ++i) {
+                    if (i >= requiredCount && (cancelled.load(std::memory_order_relaxed) || std::chrono::steady_clock::now() >= deadline)) {
+                        cancelled.store(true, std::memory_order_relaxed);
+                        stopped = true;
+                        break;
+                    }
+                    (*body)(i);
+                    ++done;
+                }
+                if (stopped) break;
+                ++chunks;
+            }
+            completed += done;
+            return chunks;
+        }
+    };
+
+    Batch batch;
+    batch.count = count;
+    batch.chunkSize = chunkSize;
+    batch.requiredCount = std::min(count, std::max(0, deadline.requiredCount));
+    batch.deadline = deadline.deadline;
+    batch.body = &body;
+
+    // the tasks only capture two pointers, small enough for std::function to keep without allocating
+    int chunkCount = (count + chunkSize - 1) / chunkSize;
+    int helpers = std::min(int(workers.size()), chunkCount - 1);
+    for (int i = 0; i < helpers; ++i) {
+        Batch *shared = &batch;
+        std::atomic<unsigned long long> *chunks = &workerChunks;
+        enqueue([shared, chunks]() { *chunks += shared->run(); });
+    }
+
+    callerChunks += batch.run();
+    waitForCompletion();
+
+    int skipped = count - batch.completed.load();
+    if (skipped > 0) {
+        missedDeadlines++;
+        skippedIndexes += skipped;
+    }
+    return skipped;
+}
+
+long long ThreadPool::getBusyMicros() const {
+    return busyMicros.load();
+}
+
+size_t ThreadPool::getThreadCount() const {
+    return workers.size();
+}
+
+ThreadPoolStats ThreadPool::getStats() {
+    ThreadPoolStats stats;
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        stats.workerBusyMicros.push_back(workerCounters[i].busyMicros.load());
+        stats.workerIdleMicros.push_back(workerCounters[i].idleMicros.load());
+        stats.workerTasks.push_back(workerCounters[i].tasks.load());
+    }
+    for (int i = 0; i < THREAD_POOL_HISTOGRAM_BUCKETS; ++i) {
+        stats.queueWaitBuckets.push_back(queueWaitBuckets[i].load());
+        stats.runTimeBuckets.push_back(runTimeBuckets[i].load());
+    }
+    stats.contendedLocks = contendedLocks.load();
+    stats.callerChunks = callerChunks.load();
+    stats.workerChunks = workerChunks.load();
+    stats.missedDeadlines = missedDeadlines.load();
+    stats.skippedIndexes = skippedIndexes.load();
+
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        stats.queueDepth = taskQueue.size();
+        stats.maxQueueDepth = maxQueueDepth;
+        stats.queueDepthSamples = queueDepthSamples;
+        stats.queueDepthTotal = queueDepthTotal;
+    }
+
+    return stats;
+}
@@ -8,15 +8,85 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+// bucket i counts the tasks that took less than 2^i micros, the last one everything longer
+constexpr int THREAD_POOL_HISTOGRAM_BUCKETS = 24;
+
+// how long a parallelFor batch may take, the indexes from requiredCount on are optional
+// and only started while the deadline hasnt passed, the ones below it always run
+struct TaskDeadline {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    int requiredCount = 0;
+};
+
+// snapshot of the pool counters, everything except the queue depth is cumulative since the pool was created
+struct ThreadPoolStats {
+    size_t queueDepth = 0;                      // tasks waiting at the time of the snapshot
+    size_t maxQueueDepth = 0;
+    unsigned long long queueDepthSamples = 0;   // the depth is sampled on every enqueue
+    unsigned long long queueDepthTotal = 0;
+
+    std::vector<long long> workerBusyMicros;
+    std::vector<long long> workerIdleMicros;
+    std::vector<unsigned long long> workerTasks;
+
+    std::vector<unsigned long long> queueWaitBuckets;   // enqueue to start
+    std::vector<unsigned long long> runTimeBuckets;
+
+    unsigned long long contendedLocks = 0;      // queue lock acquisitions that had to wait for another thread
+    unsigned long long callerChunks = 0;        // parallelFor chunks run by the calling thread instead of a worker
+    unsigned long long workerChunks = 0;
+
+    unsigned long long missedDeadlines = 0;     // parallelFor batches that ran out of time
+    unsigned long long skippedIndexes = 0;      // optional parallelFor indexes never started
+
+    // counters accumulated between previous and this snapshot, the maximum depth stays the overall one
+    ThreadPoolStats since(const ThreadPoolStats &previous) const;
+
+    double averageQueueDepth() const;
+    unsigned long long taskCount() const;
+    // upper bound of the bucket the p quantile falls in
+    static long long percentileMicros(const std::vector<unsigned long long> &buckets, double p);
+};
 
 class ThreadPool {
     private:
+        struct QueuedTask {
+            std::function<void()> task;
+            std::chrono::steady_clock::time_point enqueued;
+        };
+
+        struct WorkerCounters {
+            std::atomic<long long> busyMicros{ 0 };
+            std::atomic<long long> idleMicros{ 0 };
+            std::atomic<unsigned long long> tasks{ 0 };
+        };
+
         std::vector<std::thread> workers;
-        std::queue<std::function<void()>> taskQueue;
+        std::queue<QueuedTask> taskQueue;
         std::mutex queueMutex;
         std::condition_variable condition;
         bool stop = false;
         int activeThreads = 0; // Count of threads currently processing tasks
+        std::atomic<long long> busyMicros{ 0 }; // Time all workers together spent running tasks
+
+        // instrumentation, the queue depth counters are only touched with queueMutex held
+        std::unique_ptr<WorkerCounters[]> workerCounters;
+        std::atomic<unsigned long long> queueWaitBuckets[THREAD_POOL_HISTOGRAM_BUCKETS] = {};
+        std::atomic<unsigned long long> runTimeBuckets[THREAD_POOL_HISTOGRAM_BUCKETS] = {};
+        std::atomic<unsigned long long> contendedLocks{ 0 };
+        std::atomic<unsigned long long> callerChunks{ 0 };
+        std::atomic<unsigned long long> workerChunks{ 0 };
+        std::atomic<unsigned long long> missedDeadlines{ 0 };
+        std::atomic<unsigned long long> skippedIndexes{ 0 };
+        size_t maxQueueDepth = 0;
+        unsigned long long queueDepthSamples = 0;
+        unsigned long long queueDepthTotal = 0;
+
+        std::unique_lock<std::mutex> lockQueue();
 
     public:
         explicit ThreadPool(size_t threads);
@@ -24,6 +94,18 @@ class ThreadPool {
 
         void enqueue(std::function<void()> task);
         void waitForCompletion();
+
+        // runs body(index) for every index in [0, count) and returns once all of them are done
+        // the workers and the calling thread take chunkSize indexes at a time from a shared atomic counter,
+        // so at most one task per worker is queued no matter how many indexes there are
+        void parallelFor(int count, int chunkSize, const std::function<void(int)> &body);
+        // the same with a deadline, the indexes are started in order so the required ones have to come first
+        // the optional ones are cancelled between indexes, a running body is never interrupted, returns how many were skipped
+        int parallelFor(int count, int chunkSize, const std::function<void(int)> &body, const TaskDeadline &deadline);
+
+        long long getBusyMicros() const;
+        size_t getThreadCount() const;
+        ThreadPoolStats getStats();
 };
 
 #endif
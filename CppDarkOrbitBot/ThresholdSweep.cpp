@@ -0,0 +1,354 @@
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <mutex>
+#include <map>
+#include <cctype>
+
+#include "BotUtils.h"
+#include "BotCV.h"
+#include "BoundedSearch.h"
+#include "Constants.h"
+#include "TemplateRegistry.h"
+#include "ThreadPool.h"
+#include "ThresholdSweep.h"
+
+using namespace std;
+using namespace cv;
+
+// true positives, false positives and false negatives of one threshold/nms combination
+struct SweepCounts {
+    long long truePositives = 0;
+    long long falsePositives = 0;
+    long long falseNegatives = 0;
+};
+
+// the swept combinations of one template, counts are indexed [nms][threshold]
+struct TemplateSweep {
+    bool lowerIsBetter;
+    vector<double> thresholds;
+    vector<double> nmsThresholds;
+    vector<vector<SweepCounts>> counts;
+    long long labels = 0;
+};
+
+static vector<double> buildThresholds(double minimum, double maximum, double step)
+{
+    vector<double> thresholds;
+    for (int i = 0; minimum + i * step <= maximum + step / 2; i++) thresholds.push_back(minimum + i * step);
+    return thresholds;
+}
+
+static bool isScreenshotFile(const filesystem::path &path)
+{
+    string extension = path.extension().string();
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp";
+}
+
+static bool loadLabels(const filesystem::path &labelPath, map<string, vector<Rect>> &labels)
+{
+    ifstream file(labelPath);
+    if (!file.is_open()) return false;
+
+    string line;
+    while (getline(file, line))
+    {
+        istringstream fields(line);
+        string name;
+        Rect rect;
+        if (fields >> name >> rect.x >> rect.y >> rect.width >> rect.height) labels[name].push_back(rect);
+    }
+    return true;
+}
+
+// greedy matching of the detections in score order, each label can only be matched once
+// truePositivesUpTo[k] is the number of labels matched by the first k detections,
+// that only depends on those k detections so every threshold reads its count from the same pass
+static vector<int> countTruePositives(const vector<Rect> &detections, const vector<Rect> &labels, double iouThreshold)
+{
+    vector<int> truePositivesUpTo(detections.size() + 1, 0);
+    vector<bool> matched(labels.size(), false);
+
+    for (int i = 0; i < detections.size(); i++)
+    {
+        int bestLabel = -1;
+        double bestIoU = iouThreshold;
+        for (int j = 0; j < labels.size(); j++)
+        {
+            if (matched[j]) continue;
+            double iou = calculateIoU(detections[i], labels[j]);
+            if (iou >= bestIoU)
+            {
+                bestIoU = iou;
+                bestLabel = j;
+            }
+        }
+
+        if (bestLabel >= 0) matched[bestLabel] = true;
+        truePositivesUpTo[i + 1] = truePositivesUpTo[i] + (bestLabel >= 0 ? 1 : 0);
+    }
+
+    return truePositivesUpTo;
+}
+
+// adds the counts of one template on one screenshot for every threshold, detections have to be sorted best first
+static void addCounts(vector<SweepCounts> &counts, const vector<double> &thresholds, bool lowerIsBetter,
+    const vector<Rect> &detections, const vector<double> &detectionScores, const vector<Rect> &labels, double iouThreshold)
+{
+    vector<int> truePositivesUpTo = countTruePositives(detections, labels, iouThreshold);
+
+    for (int t = 0; t < thresholds.size(); t++)
+    {
+        // same comparisons as matchSingleTemplate, strictly below for the squared difference modes
+        int kept = 0;
+        while (kept < detections.size() && (lowerIsBetter ? detectionScores[kept] < thresholds[t] : detectionScores[kept] >= thresholds[t])) kept++;
+
+        counts[t].truePositives += truePositivesUpTo[kept];
+        counts[t].falsePositives += kept - truePositivesUpTo[kept];
+        counts[t].falseNegatives += labels.size() - truePositivesUpTo[kept];
+    }
+}
+
+static void sweepScreenshot(const filesystem::path &screenshotPath, const map<string, vector<Rect>> &labels, vector<Template> &templates,
+    const ThresholdSweepSettings &settings, const vector<TemplateSweep> &emptySweeps, vector<TemplateSweep> &sweeps, mutex &sweepsMutex)
+{
+    Mat screenshot = imread(screenshotPath.string(), IMREAD_COLOR);
+    if (screenshot.empty())
+    {
+        printWithTimestamp("Could not load screenshot: " + screenshotPath.string(), RED_TEXT_BLACK_BACKGROUND);
+        return;
+    }
+
+    Mat grayscaleScreenshot;
+    cvtColor(screenshot, grayscaleScreenshot, COLOR_BGR2GRAY);
+
+    // counted locally first so the shared totals are only locked once per screenshot
+    vector<TemplateSweep> local = emptySweeps;
+
+    for (int i = 0; i < templates.size(); i++)
+    {
+        TemplateSweep &sweep = local[i];
+        if (sweep.thresholds.empty()) continue;
+
+        static const vector<Rect> noLabels;
+        auto templateLabels = labels.find(templates[i].name);
+        const vector<Rect> &expected = templateLabels != labels.end() ? templateLabels->second : noLabels;
+        sweep.labels = expected.size();
+
+        // squared difference templates only ever report their best position, which is found once for the loosest threshold
+        if (sweep.lowerIsBetter)
+        {
+            vector<Rect> detections;
+            vector<double> detectionScores;
+            double score;
+            Point location;
+            if (findBestSquaredDifference(grayscaleScreenshot, templates[i].grayscale, templates[i].matchingMode, sweep.thresholds.back(), score, location))
+            {
+                detections.emplace_back(location, templates[i].grayscale.size());
+                detectionScores.push_back(score);
+            }
+            addCounts(sweep.counts[0], sweep.thresholds, true, detections, detectionScores, expected, settings.iouThreshold);
+            continue;
+        }
+
+        // the expensive part, done once per template no matter how many combinations get evaluated
+        Mat result;
+        computeMatchResult(grayscaleScreenshot, templates[i].grayscale, templates[i].alpha, templates[i].sparse, templates[i].fixedSizeKernel, templates[i].matchingMode, result);
+
+        // every candidate above the loosest swept threshold, the live bot keeps every such position and lets nms sort them out
+        vector<Rect> boxes;
+        vector<double> scores;
+        collectCandidates(result, sweep.thresholds.front(), templates[i].grayscale.size(), boxes, scores);
+
+        // nms keeps a box only if no better one overlaps it, so the boxes it keeps above a threshold
+        // are the same as if it had only been given the candidates above that threshold
+        vector<int> order = sortByScore(scores);
+        for (int n = 0; n < sweep.nmsThresholds.size(); n++)
+        {
+            vector<int> keptIndexes;
+            applyBucketedNMS(boxes, order, templates[i].grayscale.size(), sweep.nmsThresholds[n], keptIndexes);
+
+            vector<Rect> detections;
+            vector<double> detectionScores;
+            for (int index : keptIndexes)
+            {
+                detections.push_back(boxes[index]);
+                detectionScores.push_back(scores[index]);
+            }
+            addCounts(sweep.counts[n], sweep.thresholds, false, detections, detectionScores, expected, settings.iouThreshold);
+        }
+    }
+
+    lock_guard<mutex> lock(sweepsMutex);
+    for (int i = 0; i < sweeps.size(); i++)
+    {
+        sweeps[i].labels += local[i].labels;
+        for (int n = 0; n < sweeps[i].counts.size(); n++)
+        {
+            for (int t = 0; t < sweeps[i].counts[n].size(); t++)
+            {
+                sweeps[i].counts[n][t].truePositives += local[i].counts[n][t].truePositives;
+                sweeps[i].counts[n][t].falsePositives += local[i].counts[n][t].falsePositives;
+                sweeps[i].counts[n][t].falseNegatives += local[i].counts[n][t].falseNegatives;
+            }
+        }
+    }
+}
+
+int runThresholdSweep(const ThresholdSweepSettings &settings)
+{
+    long long sweepStart = getCurrentMillis();
+
+    vector<Template> templates = createTemplatesFromRegistry();
+    loadImages(templates);
+    extractPngNames(templates);
+
+    // collecting the screenshots that have labels
+    vector<filesystem::path> screenshotPaths;
+    vector<map<string, vector<Rect>>> screenshotLabels;
+    int unlabeledScreenshots = 0;
+
+    error_code error;
+    for (const filesystem::directory_entry &entry : filesystem::directory_iterator(settings.screenshotDirectory, error))
+    {
+        if (!entry.is_regular_file() || !isScreenshotFile(entry.path())) continue;
+
+        map<string, vector<Rect>> labels;
+        if (!loadLabels(filesystem::path(entry.path()).replace_extension(".txt"), labels))
+        {
+            unlabeledScreenshots++;
+            continue;
+        }
+
+        screenshotPaths.push_back(entry.path());
+        screenshotLabels.push_back(move(labels));
+    }
+
+    if (error)
+    {
+        printWithTimestamp("Could not read screenshot directory: " + settings.screenshotDirectory, RED_TEXT_BLACK_BACKGROUND);
+        return -1;
+    }
+    if (screenshotPaths.empty())
+    {
+        printWithTimestamp("No labeled screenshots found in " + settings.screenshotDirectory, RED_TEXT_BLACK_BACKGROUND);
+        return -1;
+    }
+
+    printWithTimestamp("Sweeping " + to_string(screenshotPaths.size()) + " screenshots, skipped " + to_string(unlabeledScreenshots)
+        + " without labels", YELLOW_TEXT_BLACK_BACKGROUND);
+
+    vector<TemplateSweep> sweeps(templates.size());
+    for (int i = 0; i < templates.size(); i++)
+    {
+        TemplateSweep &sweep = sweeps[i];
+        sweep.lowerIsBetter = templates[i].matchingMode == TM_SQDIFF || templates[i].matchingMode == TM_SQDIFF_NORMED;
+
+        // TM_SQDIFF scores arent normalised so there is no range that would fit every template
+        if (templates[i].grayscale.empty() || templates[i].matchingMode == TM_SQDIFF || (sweep.lowerIsBetter && !templates[i].alpha.empty()))
+        {
+            printWithTimestamp("Skipping template " + templates[i].name + ", its matching mode cant be swept", YELLOW_TEXT_BLACK_BACKGROUND);
+            continue;
+        }
+
+        if (sweep.lowerIsBetter)
+        {
+            sweep.thresholds = buildThresholds(settings.squaredDifferenceThresholdMin, settings.squaredDifferenceThresholdMax, settings.thresholdStep);
+            sweep.nmsThresholds = { 0.0 };
+        }
+        else
+        {
+            sweep.thresholds = buildThresholds(settings.correlationThresholdMin, settings.correlationThresholdMax, settings.thresholdStep);
+            sweep.nmsThresholds = settings.nmsThresholds;
+        }
+        sweep.counts.assign(sweep.nmsThresholds.size(), vector<SweepCounts>(sweep.thresholds.size()));
+    }
+
+    // one task per screenshot, every task matches all the templates on its screenshot
+    int threadCount = settings.threadCount > 0 ? settings.threadCount : max(1u, thread::hardware_concurrency());
+    ThreadPool threadPool(threadCount);
+    const vector<TemplateSweep> emptySweeps = sweeps;
+    mutex sweepsMutex;
+    atomic<int> processedScreenshots{ 0 };
+
+    for (int i = 0; i < screenshotPaths.size(); i++)
+    {
+        threadPool.enqueue([&, i]() {
+            sweepScreenshot(screenshotPaths[i], screenshotLabels[i], templates, settings, emptySweeps, sweeps, sweepsMutex);
+
+            int processed = ++processedScreenshots;
+            if (processed % 100 == 0) printWithTimestamp("Processed " + to_string(processed) + " of " + to_string(screenshotPaths.size()) + " screenshots");
+        });
+    }
+    threadPool.waitForCompletion();
+
+    // writing the precision/recall curve of every template and nms threshold
+    ofstream output(settings.outputPath);
+    if (!output.is_open())
+    {
+        printWithTimestamp("Could not write sweep results to " + settings.outputPath, RED_TEXT_BLACK_BACKGROUND);
+        return -1;
+    }
+
+    output << fixed << setprecision(4);
+    output << "template,nms,threshold,true_positives,false_positives,false_negatives,precision,recall,f1\n";
+
+    for (int i = 0; i < templates.size(); i++)
+    {
+        const TemplateSweep &sweep = sweeps[i];
+        if (sweep.thresholds.empty()) continue;
+
+        double bestF1 = -1;
+        int bestNms = 0;
+        int bestThreshold = 0;
+
+        for (int n = 0; n < sweep.nmsThresholds.size(); n++)
+        {
+            for (int t = 0; t < sweep.thresholds.size(); t++)
+            {
+                const SweepCounts &counts = sweep.counts[n][t];
+                long long detections = counts.truePositives + counts.falsePositives;
+                long long expected = counts.truePositives + counts.falseNegatives;
+                double precision = detections > 0 ? double(counts.truePositives) / detections : 1.0;
+                double recall = expected > 0 ? double(counts.truePositives) / expected : 1.0;
+                double f1 = precision + recall > 0 ? 2 * precision * recall / (precision + recall) : 0.0;
+
+                output << templates[i].name << "," << sweep.nmsThresholds[n] << "," << sweep.thresholds[t] << ","
+                    << counts.truePositives << "," << counts.falsePositives << "," << counts.falseNegatives << ","
+                    << precision << "," << recall << "," << f1 << "\n";
+
+                // on equal f1 the stricter threshold wins, it gives the same result with fewer candidates to sort through
+                bool stricter = sweep.lowerIsBetter ? sweep.thresholds[t] < sweep.thresholds[bestThreshold] : sweep.thresholds[t] > sweep.thresholds[bestThreshold];
+                if (f1 > bestF1 || (f1 == bestF1 && stricter))
+                {
+                    bestF1 = f1;
+                    bestNms = n;
+                    bestThreshold = t;
+                }
+            }
+        }
+
+        if (sweep.labels == 0)
+        {
+            printWithTimestamp(templates[i].name + " has no labels, no threshold recommended", YELLOW_TEXT_BLACK_BACKGROUND);
+            continue;
+        }
+
+        const SweepCounts &best = sweep.counts[bestNms][bestThreshold];
+        ostringstream recommendation;
+        recommendation << fixed << setprecision(2) << templates[i].name << ": threshold " << sweep.thresholds[bestThreshold];
+        if (!sweep.lowerIsBetter) recommendation << ", nms " << sweep.nmsThresholds[bestNms];
+        recommendation << " (f1 " << bestF1 << ", " << best.truePositives << " tp, " << best.falsePositives << " fp, "
+            << best.falseNegatives << " fn), currently " << templates[i].confidenceThreshold;
+        printWithTimestamp(recommendation.str(), GREEN_TEXT_BLACK_BACKGROUND);
+    }
+
+    printWithTimestamp("Sweep results written to " + settings.outputPath + " in " + to_string(computeTimePassed(sweepStart, getCurrentMillis())) + "ms",
+        GREEN_TEXT_BLACK_BACKGROUND);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef THRESHOLD_SWEEP
+#define THRESHOLD_SWEEP
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// offline tuning of the template thresholds on saved screenshots
+// every screenshot needs a label file next to it with the same name and a .txt extension,
+// one object per line: <template name> <x> <y> <width> <height>, the template name as in Template::name (palladium1.png)
+// screenshots without a label file are skipped
+struct ThresholdSweepSettings {
+    string screenshotDirectory;
+    string outputPath = "threshold_sweep.csv";
+    double iouThreshold = 0.5;                                      // overlap needed for a detection to count as a label
+    vector<double> nmsThresholds = { 0.1, 0.2, 0.3, 0.4, 0.5 };
+    double correlationThresholdMin = 0.3;                           // swept range for the modes where higher is better
+    double correlationThresholdMax = 0.99;
+    double squaredDifferenceThresholdMin = 0.01;                    // swept range for the TM_SQDIFF_NORMED templates
+    double squaredDifferenceThresholdMax = 0.5;
+    double thresholdStep = 0.01;
+    int threadCount = 0;                                            // 0 for one per core
+};
+
+// matches every template once per screenshot and evaluates all the threshold and nms combinations on that result,
+// writes the precision/recall of every combination to outputPath and prints the best threshold per template
+// returns the process exit code
+int runThresholdSweep(const ThresholdSweepSettings &settings);
+
+#endif
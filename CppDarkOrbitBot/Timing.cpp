@@ -0,0 +1,22 @@
+#include <chrono>
+
+#include "Timing.h"
+
+long long getCurrentMillis() 
+{
+    auto now = std::chrono::system_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
+    return duration.count();
+}
+
+long long getCurrentMicros()
+{
+    auto now = std::chrono::system_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
+    return duration.count();
+}
+
+long long computeTimePassed(long long start, long long finish)
+{
+    return finish - start;
+}
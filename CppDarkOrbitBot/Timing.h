@@ -0,0 +1,10 @@
+#ifndef TIMING
+#define TIMING
+
+// wall clock time every part of the bot stamps its events with, so capture, decision and click times can be compared
+// kept out of BotUtils so the linux capture backend can use it without the windows headers
+long long getCurrentMillis();
+long long getCurrentMicros();
+long long computeTimePassed(long long start, long long finish);
+
+#endif
@@ -0,0 +1,28 @@
+#include <windows.h>
+
+#include "Win32InputBackend.h"
+
+void Win32InputBackend::moveTo(int x, int y)
+{
+    SetCursorPos(x, y);
+}
+
+void Win32InputBackend::buttonDown()
+{
+    mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0, 0);
+}
+
+void Win32InputBackend::buttonUp()
+{
+    mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0, 0);
+}
+
+void Win32InputBackend::keyDown(int key)
+{
+    keybd_event(BYTE(key), 0, 0, 0);
+}
+
+void Win32InputBackend::keyUp(int key)
+{
+    keybd_event(BYTE(key), 0, KEYEVENTF_KEYUP, 0);
+}
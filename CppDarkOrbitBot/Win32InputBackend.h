@@ -0,0 +1,16 @@
+#ifndef WIN32_INPUT_BACKEND
+#define WIN32_INPUT_BACKEND
+
+#include "InputDispatcher.h"
+
+// the real left mouse button and keyboard through the win32 api
+class Win32InputBackend : public InputBackend {
+public:
+    void moveTo(int x, int y) override;
+    void buttonDown() override;
+    void buttonUp() override;
+    void keyDown(int key) override;
+    void keyUp(int key) override;
+};
+
+#endif
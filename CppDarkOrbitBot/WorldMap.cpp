@@ -0,0 +1,143 @@
+#include <opencv2/core/types.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "WorldMap.h"
+#include "RoutePlanner.h"
+
+using namespace std;
+using namespace cv;
+
+WorldMap::WorldMap(Rect area, const WorldMapSettings &settings) : settings_(settings), area_(area), hasShip_(false)
+{
+    columns_ = max(1, (area_.width + settings_.cellSize - 1) / settings_.cellSize);
+    rows_ = max(1, (area_.height + settings_.cellSize - 1) / settings_.cellSize);
+    cells_.resize(columns_ * rows_);
+}
+
+Point2d WorldMap::toWorld(Point screenPoint, Point2d ship, Size screenSize) const
+{
+    Point2d fromCenter = Point2d(screenPoint.x - screenSize.width / 2.0, screenPoint.y - screenSize.height / 2.0);
+    return ship + fromCenter * (1.0 / settings_.screenPixelsPerMinimapPixel);
+}
+
+bool WorldMap::cellAt(Point2d world, int &column, int &row) const
+{
+    column = int(floor((world.x - area_.x) / settings_.cellSize));
+    row = int(floor((world.y - area_.y) / settings_.cellSize));
+    return column >= 0 && column < columns_ && row >= 0 && row < rows_;
+}
+
+// 0 for a cell seen just now, 1 for one not seen for staleMillis or never
+double WorldMap::staleness(const WorldCell &cell, long long nowMillis) const
+{
+    if (cell.lastSeenMillis == 0) return 1.0;
+    return min(1.0, double(nowMillis - cell.lastSeenMillis) / settings_.staleMillis);
+}
+
+void WorldMap::observe(long long nowMillis, Point2d ship, Size screenSize, const vector<TemplateMatch> &detections)
+{
+    hasShip_ = true;
+    ship_ = ship;
+
+    // only the cells fully inside the visible area are marked, a cell half on screen can still hide resources
+    Point2d topLeft = toWorld(Point(0, 0), ship, screenSize);
+    Point2d bottomRight = toWorld(Point(screenSize.width, screenSize.height), ship, screenSize);
+    int left = int(ceil((topLeft.x - area_.x) / settings_.cellSize));
+    int top = int(ceil((topLeft.y - area_.y) / settings_.cellSize));
+    int right = int(floor((bottomRight.x - area_.x) / settings_.cellSize));
+    int bottom = int(floor((bottomRight.y - area_.y) / settings_.cellSize));
+    visibleCells_ = Rect(left, top, max(0, right - left), max(0, bottom - top)) & Rect(0, 0, columns_, rows_);
+
+    for (int row = visibleCells_.y; row < visibleCells_.y + visibleCells_.height; row++)
+    {
+        for (int column = visibleCells_.x; column < visibleCells_.x + visibleCells_.width; column++)
+        {
+            WorldCell &cell = cells_[row * columns_ + column];
+            cell.lastSeenMillis = nowMillis;
+            cell.resources = 0;
+        }
+    }
+
+    for (const TemplateMatch &detection : detections)
+    {
+        int column, row;
+        if (!cellAt(toWorld(rectCenter(detection.rect), ship, screenSize), column, row)) continue;
+
+        WorldCell &cell = cells_[row * columns_ + column];
+        if (visibleCells_.contains(Point(column, row))) cell.resources++;
+        cell.sightings++;
+    }
+}
+
+void WorldMap::recordCollected(long long nowMillis)
+{
+    int column, row;
+    if (!hasShip_ || !cellAt(ship_, column, row)) return;
+
+    WorldCell &cell = cells_[row * columns_ + column];
+    cell.collected++;
+    cell.resources = max(0, cell.resources - 1);
+    cell.lastSeenMillis = nowMillis;
+}
+
+bool WorldMap::chooseDestination(long long nowMillis, Point2d &destination) const
+{
+    if (!hasShip_) return false;
+
+    double mapDiagonal = sqrt(double(columns_ * columns_ + rows_ * rows_)) * settings_.cellSize;
+    double bestScore = 0;
+    bool found = false;
+
+    for (int row = 0; row < rows_; row++)
+    {
+        for (int column = 0; column < columns_; column++)
+        {
+            if (visibleCells_.contains(Point(column, row))) continue;
+
+            const WorldCell &cell = cells_[row * columns_ + column];
+            // the last column and row can be cut off by the border, their center is kept inside the area
+            Point2d center(min(area_.x + (column + 0.5) * settings_.cellSize, area_.x + area_.width - 1.0),
+                min(area_.y + (row + 0.5) * settings_.cellSize, area_.y + area_.height - 1.0));
+
+            double score = settings_.resourceWeight * cell.resources + settings_.staleWeight * staleness(cell, nowMillis)
+                - settings_.distanceWeight * norm(center - ship_) / mapDiagonal;
+
+            if (score > bestScore)
+            {
+                bestScore = score;
+                destination = center;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+void WorldMap::renderHeatmap(long long nowMillis, Mat &heatmap) const
+{
+    heatmap.create(rows_, columns_, CV_8UC3);
+
+    for (int row = 0; row < rows_; row++)
+    {
+        Vec3b *pixels = heatmap.ptr<Vec3b>(row);
+        for (int column = 0; column < columns_; column++)
+        {
+            const WorldCell &cell = cells_[row * columns_ + column];
+            uchar stale = saturate_cast<uchar>(255 * staleness(cell, nowMillis));
+            uchar resources = saturate_cast<uchar>(cell.resources * 64);
+            pixels[column] = Vec3b(stale / 2, stale / 2, max(resources, uchar(stale / 2)));
+        }
+    }
+}
+
+bool WorldMap::hasShip() const
+{
+    return hasShip_;
+}
+
+Rect WorldMap::getArea() const
+{
+    return area_;
+}
@@ -0,0 +1,65 @@
+#ifndef WORLD_MAP
+#define WORLD_MAP
+
+#include <opencv2/core/types.hpp>
+#include <vector>
+
+#include "BotUtils.h"
+
+using namespace std;
+using namespace cv;
+
+// world coordinates are minimap pixels, detections on screen are placed relative to the ship position read from the minimap
+struct WorldMapSettings {
+    double screenPixelsPerMinimapPixel = 75.0;      // how many screen pixels one minimap pixel covers
+    int cellSize = 6;                               // minimap pixels per cell side
+    long long staleMillis = 120000;                 // an area not seen for this long is worth as much as one never seen
+    double resourceWeight = 1.0;                    // score of every resource remembered in a cell
+    double staleWeight = 0.5;                       // score of a cell that went fully stale
+    double distanceWeight = 1.0;                    // score lost when traveling across the whole map
+};
+
+struct WorldCell {
+    long long lastSeenMillis = 0;       // 0 when the area was never on screen
+    int resources = 0;                  // resources seen there the last time it was on screen and not collected since
+    int sightings = 0;                  // detections there summed over all frames
+    int collected = 0;
+};
+
+// remembers what was seen where after it scrolled off screen so traveling can pick areas that were not cleared already
+class WorldMap {
+public:
+    // area is the part of the minimap that shows the map, in minimap pixels, the header and the border get no cells
+    WorldMap(Rect area, const WorldMapSettings &settings);
+
+    // once per frame, the cells inside the visible area are marked seen and take over the resource count of this frame
+    void observe(long long nowMillis, Point2d ship, Size screenSize, const vector<TemplateMatch> &detections);
+    // a resource was collected under the ship at its last known position
+    void recordCollected(long long nowMillis);
+
+    // best cell to travel to in minimap coordinates, cells currently on screen are skipped
+    bool chooseDestination(long long nowMillis, Point2d &destination) const;
+
+    // one BGR pixel per cell, red for remembered resources and dark for areas seen recently
+    void renderHeatmap(long long nowMillis, Mat &heatmap) const;
+
+    bool hasShip() const;
+    Rect getArea() const;
+
+private:
+    WorldMapSettings settings_;
+    Rect area_;
+    int columns_;
+    int rows_;
+    vector<WorldCell> cells_;
+
+    bool hasShip_;
+    Point2d ship_;
+    Rect visibleCells_;
+
+    Point2d toWorld(Point screenPoint, Point2d ship, Size screenSize) const;
+    bool cellAt(Point2d world, int &column, int &row) const;
+    double staleness(const WorldCell &cell, long long nowMillis) const;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#ifdef __linux__
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/imgproc.hpp>
+#include <iostream>
+#include <atomic>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XShm.h>
+
+#include "Timing.h"
+#include "X11Capture.h"
+
+using namespace std;
+using namespace cv;
+
+struct X11CaptureState {
+    Display *display = nullptr;
+    Window window = 0;
+    XImage *image = nullptr;
+    XShmSegmentInfo segment = {};
+    bool attached = false;
+};
+
+// xlib exits the process on any protocol error by default, a window that was resized or closed would take the bot with it
+// the handler is process wide, it only remembers the error so the capture that caused it can fail instead
+static atomic<int> lastX11Error{ 0 };
+
+static int recordX11Error(Display *, XErrorEvent *event)
+{
+    lastX11Error = event->error_code;
+    return 0;
+}
+
+// _NET_WM_NAME first since it is the utf8 title modern window managers set, WM_NAME for older clients
+static bool windowTitleMatches(Display *display, Window window, const string &title)
+{
+    Atom netWmName = XInternAtom(display, "_NET_WM_NAME", False);
+    Atom utf8String = XInternAtom(display, "UTF8_STRING", False);
+
+    Atom type;
+    int format;
+    unsigned long count, remaining;
+    unsigned char *data = nullptr;
+    if (XGetWindowProperty(display, window, netWmName, 0, 1024, False, utf8String, &type, &format, &count, &remaining, &data) == Success && data != nullptr)
+    {
+        bool matches = title == string(reinterpret_cast<char *>(data), count);
+        XFree(data);
+        if (matches) return true;
+    }
+
+    char *name = nullptr;
+    if (XFetchName(display, window, &name) && name != nullptr)
+    {
+        bool matches = title == name;
+        XFree(name);
+        return matches;
+    }
+
+    return false;
+}
+
+// depth first through the window tree, the title usually sits on a child of the window manager frame
+static Window findWindowByTitle(Display *display, Window parent, const string &title)
+{
+    if (windowTitleMatches(display, parent, title)) return parent;
+
+    Window root, grandparent;
+    Window *children = nullptr;
+    unsigned int childCount = 0;
+    if (!XQueryTree(display, parent, &root, &grandparent, &children, &childCount)) return 0;
+
+    Window found = 0;
+    for (unsigned int i = 0; i < childCount && found == 0; i++) found = findWindowByTitle(display, children[i], title);
+
+    if (children != nullptr) XFree(children);
+    return found;
+}
+
+X11ScreenshotManager::X11ScreenshotManager(const string &windowTitle, const CaptureSettings &settings) : windowTitle_(windowTitle),
+    settings_(settings), state_(new X11CaptureState()), width_(0), height_(0), lastCaptureMicros_(0)
+{
+    if (settings_.decimation != 1 && settings_.decimation != 2)
+    {
+        std::cerr << "Capture decimation can only be 1 or 2, capturing at full resolution" << std::endl;
+        settings_.decimation = 1;
+    }
+
+    XSetErrorHandler(recordX11Error);
+
+    state_->display = XOpenDisplay(nullptr);
+    if (state_->display == nullptr)
+    {
+        std::cerr << "Could not open the X display, is DISPLAY set?" << std::endl;
+        return;
+    }
+
+    if (!XShmQueryExtension(state_->display))
+    {
+        std::cerr << "The X server does not support the MIT-SHM extension!" << std::endl;
+        return;
+    }
+
+    Window root = DefaultRootWindow(state_->display);
+    state_->window = windowTitle_.empty() ? root : findWindowByTitle(state_->display, root, windowTitle_);
+    if (state_->window == 0)
+    {
+        std::cerr << "Could not find a window titled " << windowTitle_ << std::endl;
+        return;
+    }
+
+    initialize();
+}
+
+X11ScreenshotManager::~X11ScreenshotManager()
+{
+    cleanup();
+    if (state_->display != nullptr) XCloseDisplay(state_->display);
+}
+
+bool X11ScreenshotManager::initialize()
+{
+    Display *display = state_->display;
+
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(display, state_->window, &attributes))
+    {
+        std::cerr << "Could not read the window attributes!" << std::endl;
+        return false;
+    }
+    width_ = attributes.width;
+    height_ = attributes.height;
+
+    state_->image = XShmCreateImage(display, attributes.visual, attributes.depth, ZPixmap, nullptr, &state_->segment, width_, height_);
+    if (state_->image == nullptr)
+    {
+        std::cerr << "Could not create the shared memory image!" << std::endl;
+        return false;
+    }
+
+    // the frame conversion expects 32 bit BGRA, which is what a 24 or 32 bit TrueColor visual gives on little endian servers
+    XImage *image = state_->image;
+    if (image->bits_per_pixel != 32 || image->byte_order != LSBFirst || image->red_mask != 0xff0000 || image->blue_mask != 0xff)
+    {
+        std::cerr << "Unsupported X visual, only 32 bit BGRA pixels can be captured!" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    state_->segment.shmid = shmget(IPC_PRIVATE, size_t(image->bytes_per_line) * image->height, IPC_CREAT | 0600);
+    if (state_->segment.shmid < 0)
+    {
+        std::cerr << "Could not allocate the shared memory segment!" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    void *address = shmat(state_->segment.shmid, nullptr, 0);
+    if (address == reinterpret_cast<void *>(-1))
+    {
+        std::cerr << "Could not map the shared memory segment!" << std::endl;
+        shmctl(state_->segment.shmid, IPC_RMID, nullptr);
+        cleanup();
+        return false;
+    }
+    state_->segment.shmaddr = image->data = static_cast<char *>(address);
+    state_->segment.readOnly = False;
+
+    // attach errors arrive asynchronously, the sync makes sure they were handled before checking
+    lastX11Error = 0;
+    bool attached = XShmAttach(display, &state_->segment);
+    XSync(display, False);
+    state_->attached = attached && lastX11Error == 0;
+
+    // marked for removal right away, the segment goes away with the last detach even if the bot crashes
+    shmctl(state_->segment.shmid, IPC_RMID, nullptr);
+
+    if (!state_->attached)
+    {
+        std::cerr << "The X server could not attach the shared memory segment, is it running on another machine?" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    bgra_ = cv::Mat(height_, width_, CV_8UC4, image->data, image->bytes_per_line);
+    return true;
+}
+
+void X11ScreenshotManager::cleanup()
+{
+    bgra_ = cv::Mat();
+
+    if (state_->attached)
+    {
+        XShmDetach(state_->display, &state_->segment);
+        XSync(state_->display, False);
+        state_->attached = false;
+    }
+    if (state_->segment.shmaddr != nullptr) shmdt(state_->segment.shmaddr);
+    state_->segment = {};
+
+    if (state_->image != nullptr)
+    {
+        // the pixels belong to the segment, XDestroyImage would try to free them
+        state_->image->data = nullptr;
+        XDestroyImage(state_->image);
+        state_->image = nullptr;
+    }
+}
+
+bool X11ScreenshotManager::isReady() const
+{
+    return state_->attached;
+}
+
+const Mat &X11ScreenshotManager::captureBgra()
+{
+    static const cv::Mat empty;
+    if (!state_->attached) return empty;
+
+    lastX11Error = 0;
+    bool captured = XShmGetImage(state_->display, state_->window, state_->image, 0, 0, AllPlanes) && lastX11Error == 0;
+
+    // the usual reason is the window changing size, the segment is rebuilt for the new size and the capture tried once more
+    if (!captured)
+    {
+        cleanup();
+        if (!initialize()) return empty;
+
+        lastX11Error = 0;
+        captured = XShmGetImage(state_->display, state_->window, state_->image, 0, 0, AllPlanes) && lastX11Error == 0;
+        if (!captured)
+        {
+            std::cerr << "Failed to capture the window!" << std::endl;
+            return empty;
+        }
+    }
+
+    lastCaptureMicros_ = getCurrentMicros();
+    return bgra_;
+}
+
+Mat X11ScreenshotManager::capture()
+{
+    Mat unusedColor;
+    return capture(unusedColor);
+}
+
+Mat X11ScreenshotManager::capture(Mat &color)
+{
+    const cv::Mat &bgra = captureBgra();
+    if (bgra.empty()) return cv::Mat();
+
+    // the frame gets a fresh buffer every capture since the previous one can still be referenced by the caller
+    cv::Mat frame;
+    convertCapturedFrame(bgra, settings_.format, settings_.decimation, frame);
+    if (settings_.keepColor) cv::cvtColor(bgra, color, cv::COLOR_BGRA2BGR);
+    if (colorRegion_.area() > 0) convertCapturedRegion(bgra, colorRegion_, settings_.decimation, colorRegionImage_);
+
+    return frame;
+}
+
+long long X11ScreenshotManager::getLastCaptureMicros() const
+{
+    return lastCaptureMicros_;
+}
+
+void X11ScreenshotManager::setColorRegion(Rect region)
+{
+    colorRegion_ = region;
+    colorRegionImage_.release();
+}
+
+const Mat &X11ScreenshotManager::getColorRegion() const
+{
+    return colorRegionImage_;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef X11_CAPTURE
+#define X11_CAPTURE
+
+#ifdef __linux__
+
+#include <opencv2/core/types.hpp>
+#include <memory>
+#include <string>
+
+#include "FrameConversion.h"
+
+using namespace std;
+using namespace cv;
+
+// the xlib headers define macros like None, Status and Bool that clash with other code, so they stay in the cpp
+struct X11CaptureState;
+
+// linux counterpart of ScreenshotManager, the window is read with XShmGetImage straight into a shared memory segment
+// the X server writes the pixels there and the frame is converted from that memory without any copy in between
+// an empty title captures the whole root window, which is what to point it at when testing under Xvfb
+class X11ScreenshotManager {
+public:
+    explicit X11ScreenshotManager(const string &windowTitle, const CaptureSettings &settings = CaptureSettings());
+    ~X11ScreenshotManager();
+
+    X11ScreenshotManager(const X11ScreenshotManager &) = delete;
+    X11ScreenshotManager &operator=(const X11ScreenshotManager &) = delete;
+
+    // false when the display, the window or the shared memory segment could not be set up
+    bool isReady() const;
+
+    // the frame in the configured format and size
+    cv::Mat capture();
+    // same, color is filled with the full resolution BGR frame when keepColor is set
+    cv::Mat capture(cv::Mat &color);
+    // the BGRA pixels of a new capture, a header over the shared segment that stays valid until the next capture
+    const cv::Mat &captureBgra();
+
+    long long getLastCaptureMicros() const;
+
+    void setColorRegion(Rect region);
+    const cv::Mat &getColorRegion() const;
+
+private:
+    string windowTitle_;
+    CaptureSettings settings_;
+    unique_ptr<X11CaptureState> state_;
+
+    int width_, height_;
+    long long lastCaptureMicros_;
+
+    // header over the shared segment, never owns the pixels
+    cv::Mat bgra_;
+
+    Rect colorRegion_;
+    cv::Mat colorRegionImage_;
+
+    bool initialize();
+    void cleanup();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#ifdef __linux__
+
+#include <opencv2/core/types.hpp>
+#include <iostream>
+#include <string>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "Timing.h"
+#include "X11Capture.h"
+
+using namespace std;
+using namespace cv;
+
+// checks the X11 capture against a window it draws itself, meant to run under Xvfb:
+//   xvfb-run -a -s "-screen 0 1280x720x24" ./x11_capture_check
+// the window is found by its title, the left half is red and the right half blue so the channel order shows up in the frame
+
+static const string CHECK_TITLE = "x11 capture check";
+static const int CHECK_WIDTH = 320;
+static const int CHECK_HEIGHT = 240;
+
+// same exit code ctest treats as skipped, there is nothing to check without a display
+static const int SKIPPED = 77;
+
+static int failures = 0;
+
+static void expect(bool condition, const string &message)
+{
+    if (condition) return;
+    std::cerr << "FAILED: " << message << std::endl;
+    failures++;
+}
+
+static bool bgrPixelIs(const Mat &frame, int x, int y, int blue, int green, int red)
+{
+    const uchar *pixel = frame.ptr<uchar>(y) + x * 3;
+    return pixel[0] == blue && pixel[1] == green && pixel[2] == red;
+}
+
+static void drawCheckPattern(Display *display, Window window, int width, int height)
+{
+    GC gc = XCreateGC(display, window, 0, nullptr);
+    XSetForeground(display, gc, 0xff0000);
+    XFillRectangle(display, window, gc, 0, 0, width / 2, height);
+    XSetForeground(display, gc, 0x0000ff);
+    XFillRectangle(display, window, gc, width / 2, 0, width - width / 2, height);
+    XFreeGC(display, gc);
+    XSync(display, False);
+}
+
+int main()
+{
+    Display *display = XOpenDisplay(nullptr);
+    if (display == nullptr)
+    {
+        std::cerr << "No X display to check against, run it under xvfb-run" << std::endl;
+        return SKIPPED;
+    }
+
+    Window window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, CHECK_WIDTH, CHECK_HEIGHT, 0, 0, 0);
+    XStoreName(display, window, CHECK_TITLE.c_str());
+    XSelectInput(display, window, ExposureMask);
+    XMapWindow(display, window);
+
+    // nothing drawn before the first expose would stay on screen
+    XEvent event;
+    XWindowEvent(display, window, ExposureMask, &event);
+    drawCheckPattern(display, window, CHECK_WIDTH, CHECK_HEIGHT);
+
+    // full resolution BGR, found by title
+    CaptureSettings bgrSettings;
+    bgrSettings.format = CAPTURE_BGR;
+    X11ScreenshotManager bgrCapture(CHECK_TITLE, bgrSettings);
+    expect(bgrCapture.isReady(), "capture by title was not set up");
+
+    long long before = getCurrentMicros();
+    Mat frame = bgrCapture.capture();
+    long long after = getCurrentMicros();
+
+    expect(!frame.empty(), "BGR frame is empty");
+    if (!frame.empty())
+    {
+        expect(frame.cols == CHECK_WIDTH && frame.rows == CHECK_HEIGHT, "BGR frame is " + to_string(frame.cols) + "x" + to_string(frame.rows));
+        expect(frame.type() == CV_8UC3, "BGR frame does not have 3 channels");
+        expect(bgrPixelIs(frame, CHECK_WIDTH / 4, CHECK_HEIGHT / 2, 0, 0, 255), "left half is not red");
+        expect(bgrPixelIs(frame, CHECK_WIDTH * 3 / 4, CHECK_HEIGHT / 2, 255, 0, 0), "right half is not blue");
+    }
+    expect(bgrCapture.getLastCaptureMicros() >= before && bgrCapture.getLastCaptureMicros() <= after, "capture time is outside the capture call");
+
+    // the BGRA frame is a header over the shared segment, the next capture writes into the same memory
+    const uchar *firstPixels = bgrCapture.captureBgra().data;
+    const uchar *secondPixels = bgrCapture.captureBgra().data;
+    expect(firstPixels != nullptr && firstPixels == secondPixels, "BGRA frames do not share the segment");
+
+    // decimated grayscale, red is (255 * 4899 + 2^13) >> 14 like cv::cvtColor
+    CaptureSettings graySettings;
+    graySettings.format = CAPTURE_GRAYSCALE;
+    graySettings.decimation = 2;
+    X11ScreenshotManager grayCapture(CHECK_TITLE, graySettings);
+    Mat gray = grayCapture.capture();
+    expect(!gray.empty(), "grayscale frame is empty");
+    if (!gray.empty())
+    {
+        expect(gray.cols == CHECK_WIDTH / 2 && gray.rows == CHECK_HEIGHT / 2, "decimated frame is " + to_string(gray.cols) + "x" + to_string(gray.rows));
+        expect(gray.ptr<uchar>(gray.rows / 2)[gray.cols / 4] == 76, "grayscale red is " + to_string(gray.ptr<uchar>(gray.rows / 2)[gray.cols / 4]));
+    }
+
+    // a smaller window makes the next XShmGetImage fail, the segment has to be rebuilt for the new size
+    int smallerWidth = CHECK_WIDTH / 2;
+    int smallerHeight = CHECK_HEIGHT / 2;
+    XResizeWindow(display, window, smallerWidth, smallerHeight);
+    XSync(display, False);
+    drawCheckPattern(display, window, smallerWidth, smallerHeight);
+
+    Mat resized = bgrCapture.capture();
+    expect(!resized.empty(), "frame after the resize is empty");
+    if (!resized.empty())
+    {
+        expect(resized.cols == smallerWidth && resized.rows == smallerHeight, "frame after the resize is " + to_string(resized.cols) + "x" + to_string(resized.rows));
+        expect(bgrPixelIs(resized, smallerWidth * 3 / 4, smallerHeight / 2, 255, 0, 0), "right half is not blue after the resize");
+    }
+
+    // the colored minimap region the bot reads next to the grayscale frame
+    bgrCapture.setColorRegion(Rect(0, 0, 8, 8));
+    bgrCapture.capture();
+    const Mat &region = bgrCapture.getColorRegion();
+    expect(region.cols == 8 && region.rows == 8 && bgrPixelIs(region, 4, 4, 0, 0, 255), "color region is not the red corner");
+
+    XDestroyWindow(display, window);
+    XCloseDisplay(display);
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " X11 capture checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "X11 capture checks passed" << std::endl;
+    return 0;
+}
+
+#endif